@@ -95,6 +95,8 @@ INCLUDE(CheckFunctionExists)
 check_symbol_exists(__GLIBC__ stdio.h LLVM_USING_GLIBC)
 if( LLVM_USING_GLIBC )
   add_definitions( -D_GNU_SOURCE )
+  # 64-bit file offsets on 32-bit hosts (the spill file may exceed 2GB)
+  add_definitions( -D_FILE_OFFSET_BITS=64 )
 endif( LLVM_USING_GLIBC )
 
 check_symbol_exists(abort stdlib.h HAVE_ABORT)
@@ -26,7 +26,13 @@
 //
 #include "config.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
+#include <vector>
 
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/STLExtras.h"
@@ -42,10 +48,13 @@
 #include "yasmx/Parse/HeaderSearch.h"
 #include "yasmx/Parse/Parser.h"
 #include "yasmx/Parse/Preprocessor.h"
+#include "yasmx/Support/MD5.h"
 #include "yasmx/Support/registry.h"
 #include "yasmx/System/plugin.h"
 #include "yasmx/Arch.h"
+#include "yasmx/ArchiveWriter.h"
 #include "yasmx/Assembler.h"
+#include "yasmx/CodeProfile.h"
 #include "yasmx/DebugFormat.h"
 #include "yasmx/ListFormat.h"
 #include "yasmx/Module.h"
@@ -92,9 +101,15 @@ static cl::extrahelp help_tail(
     "\n"
     "Report bugs to support@pathscale.com\n");
 
-static cl::opt<std::string> in_filename(cl::Positional,
+static cl::list<std::string> in_filenames(cl::Positional,
     cl::desc("file"));
 
+// --analyze
+static cl::opt<std::string> analysis_model("analyze",
+    cl::desc("Report estimated loop throughput and latency for a "
+             "microarchitecture model"),
+    cl::value_desc("model"));
+
 // -a, --arch
 static cl::opt<std::string> arch_keyword("a",
     cl::desc("Select architecture (list with -a help)"),
@@ -106,6 +121,11 @@ static cl::alias arch_keyword_long("arch",
     cl::value_desc("arch"),
     cl::aliasopt(arch_keyword));
 
+// --archive
+static cl::opt<std::string> archive_filename("archive",
+    cl::desc("Write objects as members of a static archive"),
+    cl::value_desc("filename"));
+
 // -D, -d
 static cl::list<std::string> predefine_macros("D",
     cl::desc("Pre-define a macro, optionally to value"),
@@ -116,6 +136,10 @@ static cl::alias predefine_macros_alias("d",
     cl::value_desc("macro[=value]"),
     cl::aliasopt(predefine_macros));
 
+// --deterministic
+static cl::opt<bool> deterministic("deterministic",
+    cl::desc("Produce identical output for identical input"));
+
 #ifdef WITH_XML
 // -dump-object
 static llvm::cl::opt<yasm::Assembler::ObjectDumpTime> dump_object("dump-object",
@@ -178,10 +202,28 @@ static cl::alias dbgfmt_keyword_long("dformat",
     cl::value_desc("debug"),
     cl::aliasopt(dbgfmt_keyword));
 
+// --feature-report
+static cl::opt<std::string> feature_report_filename("feature-report",
+    cl::desc("Write ISA extensions used by each section and function"),
+    cl::value_desc("filename"));
+
+// --file-prefix-map
+static cl::list<std::string> file_prefix_maps("file-prefix-map",
+    cl::desc("Replace path prefix <old> with <new> in output filenames"),
+    cl::value_desc("old=new"));
+
 // --force-strict
 static cl::opt<bool> force_strict("force-strict",
     cl::desc("treat all sized operands as if `strict' was used"));
 
+// --function-sizes
+static cl::opt<bool> function_sizes("function-sizes",
+    cl::desc("Give global code labels function type and size in ELF output"));
+
+// --gnu-property
+static cl::opt<bool> gnu_property("gnu-property",
+    cl::desc("Record ISA level and features used in .note.gnu.property"));
+
 // -h
 static cl::opt<bool> show_help("h",
     cl::desc("Alias for --help"),
@@ -197,6 +239,14 @@ static cl::alias include_paths_alias("i",
     cl::aliasopt(include_paths),
     cl::Prefix);
 
+// --keep-pcrel-relocs
+static cl::opt<bool> keep_pcrel_relocs("keep-pcrel-relocs",
+    cl::desc("Keep relocations for PC-relative references to hidden symbols"));
+
+// --layout-report
+static cl::opt<bool> layout_report("layout-report",
+    cl::desc("Report cache line and fetch block placement of hot regions"));
+
 // -L, --lformat
 static cl::opt<std::string> listfmt_keyword("L",
     cl::desc("Select list format (list with -L help)"),
@@ -226,6 +276,12 @@ static cl::alias list_filename_long("list",
 static cl::opt<bool> generate_make_dependencies("M",
     cl::desc("generate Makefile dependencies on stdout"));
 
+// --manifest
+static cl::opt<std::string> manifest_filename("manifest",
+    cl::desc("Write input file manifest (includes, incbin files, and "
+             "content hashes)"),
+    cl::value_desc("filename"));
+
 // -m, --machine
 static cl::opt<std::string> machine_name("m",
     cl::desc("Select machine (list with -m help)"),
@@ -290,6 +346,22 @@ static cl::opt<bool> error_stdout("s",
     cl::desc("redirect error messages to stdout"),
     cl::ZeroOrMore);
 
+// --profile
+static cl::opt<std::string> profile_filename("profile",
+    cl::desc("Align hot code labels listed in execution profile <file>"),
+    cl::value_desc("file"));
+
+// --spill-threshold
+static cl::opt<unsigned> spill_threshold("spill-threshold",
+    cl::desc("Spill constant data of at least <bytes> to disk"),
+    cl::value_desc("bytes"),
+    cl::init(0));
+
+// --synthesize-cfi
+static cl::opt<bool> synthesize_cfi("synthesize-cfi",
+    cl::desc("Derive call frame information from function prologues and "
+             "epilogues"));
+
 // -U, -u
 static cl::list<std::string> undefine_macros("U",
     cl::desc("Undefine a macro"),
@@ -503,6 +575,44 @@ ConfigureObject(yasm::Object& object)
         else
             break; // we're done with the list
     }
+
+    config.CodeProperties = gnu_property;
+    config.SpillThreshold = spill_threshold;
+    config.Deterministic = deterministic;
+    config.FunctionSizes = function_sizes;
+    config.KeepPCRelRelocs = keep_pcrel_relocs;
+
+    for (std::vector<std::string>::const_iterator i=file_prefix_maps.begin(),
+         end=file_prefix_maps.end(); i != end; ++i)
+    {
+        std::pair<llvm::StringRef, llvm::StringRef> map =
+            llvm::StringRef(*i).split('=');
+        object.AddPathMap(map.first, map.second);
+    }
+}
+
+static bool
+LoadProfile(yasm::Object& object, yasm::Diagnostic& diags)
+{
+    std::auto_ptr<llvm::MemoryBuffer>
+        buf(llvm::MemoryBuffer::getFile(profile_filename.c_str()));
+    if (!buf.get())
+    {
+        diags.Report(yasm::SourceLocation(), yasm::diag::fatal_file_open)
+            << profile_filename;
+        return false;
+    }
+
+    std::auto_ptr<yasm::CodeProfile> profile(new yasm::CodeProfile);
+    unsigned long line;
+    if (!profile->Parse(buf->getBuffer(), &line))
+    {
+        diags.Report(yasm::SourceLocation(), yasm::diag::fatal_bad_profile)
+            << profile_filename << static_cast<unsigned int>(line);
+        return false;
+    }
+    object.setProfile(profile);
+    return true;
 }
 
 static void
@@ -565,6 +675,182 @@ ApplyPreprocessorSavedOptions(yasm::Preprocessor& preproc)
     }
 }
 
+namespace {
+/// An input file the assembled output depends on.
+struct Dependency
+{
+    const char* kind;               ///< "source", "include", or "incbin"
+    std::string filename;           ///< resolved filename
+
+    /// File contents if already loaded by the source manager, otherwise
+    /// NULL (the file is read again when hashing).
+    const llvm::MemoryBuffer* buf;
+};
+} // anonymous namespace
+
+static bool
+DependencyFilenameLess(const Dependency& lhs, const Dependency& rhs)
+{
+    return lhs.filename < rhs.filename;
+}
+
+static void
+CollectDependencies(const yasm::SourceManager& source_mgr,
+                    const yasm::FileEntry* main_file,
+                    const yasm::Object& object,
+                    std::vector<Dependency>& deps)
+{
+    // Source files.  Parsers may replace the main buffer after
+    // preprocessing, so use the file contents cache rather than the
+    // file ID table; buffers without a file entry (stdin, builtin macros)
+    // are not dependencies.  Sort for stable output.
+    std::vector<Dependency> includes;
+    for (yasm::SourceManager::fileinfo_iterator i=source_mgr.fileinfo_begin(),
+         end=source_mgr.fileinfo_end(); i != end; ++i)
+    {
+        const yasm::SrcMgr::ContentCache* content = i->second;
+        if (!content->Entry)
+            continue;
+        Dependency dep;
+        dep.kind = "include";
+        dep.filename = content->Entry->getName();
+        dep.buf = content->getRawBuffer();
+        if (content->Entry == main_file)
+        {
+            dep.kind = "source";
+            deps.push_back(dep);
+        }
+        else
+            includes.push_back(dep);
+    }
+    std::sort(includes.begin(), includes.end(), DependencyFilenameLess);
+    deps.insert(deps.end(), includes.begin(), includes.end());
+
+    // Binary data files (e.g. incbin).
+    for (yasm::Object::Dependencies::const_iterator
+         i=object.getDependencies().begin(),
+         end=object.getDependencies().end(); i != end; ++i)
+    {
+        Dependency dep;
+        dep.kind = "incbin";
+        dep.filename = *i;
+        dep.buf = 0;
+        deps.push_back(dep);
+    }
+}
+
+static void
+WriteMakeDependencies(llvm::raw_ostream& os,
+                      llvm::StringRef target,
+                      const std::vector<Dependency>& deps)
+{
+    os << target << ':';
+    std::size_t totlen = target.size()+1;
+    for (std::vector<Dependency>::const_iterator i=deps.begin(),
+         end=deps.end(); i != end; ++i)
+    {
+        totlen += i->filename.size()+1;
+        if (totlen > 72)
+        {
+            os << " \\\n ";
+            totlen = i->filename.size()+2;
+        }
+        os << ' ' << i->filename;
+    }
+    os << '\n';
+}
+
+/// Output an assembled object as a new archive member, named after the
+/// object filename.  Object formats seek within their output, so the
+/// object is written to an anonymous temporary file and read back.
+/// @return False if an error occurred.
+static bool
+ArchiveObject(yasm::Assembler& assembler,
+              yasm::Diagnostic& diags,
+              yasm::ArchiveWriter& archive)
+{
+    std::FILE* tmp = std::tmpfile();
+    if (!tmp)
+    {
+        diags.Report(yasm::SourceLocation(), yasm::diag::err_cannot_open_file)
+            << "temporary file" << strerror(errno);
+        return false;
+    }
+
+    bool ok;
+    {
+        llvm::raw_fd_ostream out(fileno(tmp), false);
+        ok = assembler.Output(out, diags);
+    }
+
+    std::string data;
+    if (ok)
+    {
+        std::rewind(tmp);
+        char buf[4096];
+        std::size_t n;
+        while ((n = std::fread(buf, 1, sizeof(buf), tmp)) > 0)
+            data.append(buf, n);
+    }
+    std::fclose(tmp);
+    if (!ok)
+        return false;
+
+    archive.AddMember(assembler.getObjectFilename(), data,
+                      *assembler.getObject());
+    return true;
+}
+
+/// Write a line-oriented manifest of every input file and the MD5 of its
+/// contents.  Each line is "kind hash filename"; the filename is last so
+/// it may contain spaces.  A hash of "-" means the file could not be read.
+static bool
+WriteManifest(llvm::StringRef filename,
+              llvm::StringRef target,
+              const std::vector<Dependency>& deps,
+              yasm::Diagnostic& diags)
+{
+    std::string err;
+    llvm::raw_fd_ostream os(filename.str().c_str(), err);
+    if (!err.empty())
+    {
+        diags.Report(yasm::SourceLocation(), yasm::diag::err_cannot_open_file)
+            << filename << err;
+        return false;
+    }
+
+    os << "object - " << target << '\n';
+    for (std::vector<Dependency>::const_iterator i=deps.begin(),
+         end=deps.end(); i != end; ++i)
+    {
+        os << i->kind << ' ';
+
+        const llvm::MemoryBuffer* buf = i->buf;
+        std::auto_ptr<llvm::MemoryBuffer> owned;
+        if (!buf)
+        {
+            owned.reset(llvm::MemoryBuffer::getFile(i->filename.c_str()));
+            buf = owned.get();
+        }
+
+        if (buf)
+        {
+            yasm::MD5 md5;
+            md5.Update(reinterpret_cast<const unsigned char*>
+                       (buf->getBufferStart()), buf->getBufferSize());
+            unsigned char digest[16];
+            md5.Final(digest);
+            for (int j=0; j<16; ++j)
+                os << llvm::format("%02x", digest[j]);
+        }
+        else
+            os << '-';
+
+        os << ' ' << i->filename << '\n';
+    }
+    return true;
+}
+
 #if 0
 static int
 do_preproc_only(void)
@@ -675,8 +961,14 @@ do_preproc_only(void)
     return EXIT_SUCCESS;
 }
 #endif
+/// Assemble one input file.
+/// @param archive      if non-NULL, add the object to this archive rather
+///                     than writing it to the object file
 static int
-do_assemble(yasm::SourceManager& source_mgr, yasm::Diagnostic& diags)
+do_assemble(yasm::SourceManager& source_mgr,
+            yasm::Diagnostic& diags,
+            const std::string& in_filename,
+            yasm::ArchiveWriter* archive)
 {
     // Apply warning settings
     ApplyWarningSettings(diags);
@@ -720,14 +1012,38 @@ do_assemble(yasm::SourceManager& source_mgr, yasm::Diagnostic& diags)
 
     assembler.getArch()->setVar("force_strict", force_strict);
 
+    if (!analysis_model.empty() &&
+        !assembler.getArch()->setAnalysisModel(analysis_model))
+    {
+        diags.Report(yasm::diag::fatal_unrecognized_module)
+            << "analysis model" << analysis_model;
+        return EXIT_FAILURE;
+    }
+
+    if (!feature_report_filename.empty() &&
+        !assembler.getArch()->EnableFeatureReport())
+    {
+        diags.Report(yasm::diag::fatal_feature_report_unsupported)
+            << arch_keyword;
+        return EXIT_FAILURE;
+    }
+
+    if (synthesize_cfi && !assembler.getArch()->EnableFrameEffects())
+    {
+        diags.Report(yasm::diag::fatal_cfi_synthesis_unsupported)
+            << arch_keyword;
+        return EXIT_FAILURE;
+    }
+
     // open the input file or STDIN (for filename of "-")
+    const yasm::FileEntry* in = 0;
     if (in_filename == "-")
     {
         source_mgr.createMainFileIDForMemBuffer(llvm::MemoryBuffer::getSTDIN());
     }
     else
     {
-        const yasm::FileEntry* in = file_mgr.getFile(in_filename);
+        in = file_mgr.getFile(in_filename);
         if (!in)
         {
             diags.Report(yasm::SourceLocation(), yasm::diag::fatal_file_open)
@@ -744,6 +1060,19 @@ do_assemble(yasm::SourceManager& source_mgr, yasm::Diagnostic& diags)
     // Configure object per command line parameters.
     ConfigureObject(*assembler.getObject());
 
+    // Frame effects are only turned into call frame information by debug
+    // formats that generate it.
+    if (synthesize_cfi && !assembler.getDebugFormat()->hasCallFrameInfo())
+    {
+        diags.Report(yasm::diag::warn_cfi_synthesis_ignored)
+            << assembler.getDebugFormat()->getModule().getKeyword();
+    }
+
+    // Load execution profile if specified.
+    if (!profile_filename.empty() &&
+        !LoadProfile(*assembler.getObject(), diags))
+        return EXIT_FAILURE;
+
     // initialize the parser.
     yasm::Parser& parser = assembler.InitParser(source_mgr, diags, headers);
     ApplyPreprocessorBuiltins(parser.getPreprocessor());
@@ -758,29 +1087,82 @@ do_assemble(yasm::SourceManager& source_mgr, yasm::Diagnostic& diags)
         return EXIT_FAILURE;
     }
 
-    // open the object file for output
-    std::string err;
-    llvm::raw_fd_ostream out(assembler.getObjectFilename().str().c_str(),
-                             err, llvm::raw_fd_ostream::F_Binary);
-    if (!err.empty())
+    std::vector<Dependency> deps;
+    if (generate_make_dependencies || !manifest_filename.empty())
+        CollectDependencies(source_mgr, in, *assembler.getObject(), deps);
+
+    // Only dependencies were requested; don't write the object file.
+    if (generate_make_dependencies)
     {
-        diags.Report(yasm::SourceLocation(), yasm::diag::err_cannot_open_file)
-            << obj_filename << err;
-        return EXIT_FAILURE;
+        WriteMakeDependencies(llvm::outs(), assembler.getObjectFilename(),
+                              deps);
+        if (!manifest_filename.empty() &&
+            !WriteManifest(manifest_filename, assembler.getObjectFilename(),
+                           deps, diags))
+            return EXIT_FAILURE;
+        return EXIT_SUCCESS;
     }
 
-    if (!assembler.Output(out, diags))
+    if (!analysis_model.empty())
+        assembler.getArch()->WriteAnalysis(source_mgr, llvm::outs());
+    if (layout_report)
+        assembler.getArch()->WriteLayout(*assembler.getObject(), source_mgr,
+                                         llvm::outs());
+
+    if (archive)
     {
-        // An error occurred during output.
-        // If we had an error at this point, we also need to delete the output
-        // object file (to make sure it's not left newer than the source).
+        if (!ArchiveObject(assembler, diags, *archive))
+            return EXIT_FAILURE;
+    }
+    else
+    {
+        // open the object file for output
+        std::string err;
+        llvm::raw_fd_ostream out(assembler.getObjectFilename().str().c_str(),
+                                 err, llvm::raw_fd_ostream::F_Binary);
+        if (!err.empty())
+        {
+            diags.Report(yasm::SourceLocation(),
+                         yasm::diag::err_cannot_open_file)
+                << obj_filename << err;
+            return EXIT_FAILURE;
+        }
+
+        if (!assembler.Output(out, diags))
+        {
+            // An error occurred during output.
+            // If we had an error at this point, we also need to delete the
+            // output object file (to make sure it's not left newer than the
+            // source).
+            out.close();
+            remove(assembler.getObjectFilename().str().c_str());
+            return EXIT_FAILURE;
+        }
+
+        // close object file
         out.close();
-        remove(assembler.getObjectFilename().str().c_str());
-        return EXIT_FAILURE;
     }
 
-    // close object file
-    out.close();
+    // Write the manifest only once the object it describes is complete.
+    if (!manifest_filename.empty() &&
+        !WriteManifest(manifest_filename, assembler.getObjectFilename(),
+                       deps, diags))
+        return EXIT_FAILURE;
+
+    if (!feature_report_filename.empty())
+    {
+        std::string err;
+        llvm::raw_fd_ostream os(feature_report_filename.c_str(), err);
+        if (!err.empty())
+        {
+            diags.Report(yasm::SourceLocation(),
+                         yasm::diag::err_cannot_open_file)
+                << feature_report_filename << err;
+            return EXIT_FAILURE;
+        }
+        assembler.getArch()->WriteFeatureReport(*assembler.getObject(),
+                                                source_mgr, os);
+    }
 #if 0
     // Open and write the list file
     if (list_filename)
@@ -918,12 +1300,66 @@ main(int argc, char* argv[])
 
     // Require an input filename.  We don't use llvm::cl facilities for this
     // as we want to allow e.g. "yasm --license".
-    if (in_filename.empty())
+    if (in_filenames.empty())
     {
         diags.Report(yasm::diag::fatal_no_input_files);
         return EXIT_FAILURE;
     }
 
+    // Several objects can only go into an archive.
+    if (in_filenames.size() > 1)
+    {
+        if (archive_filename.empty())
+        {
+            diags.Report(yasm::diag::fatal_archive_required);
+            return EXIT_FAILURE;
+        }
+        if (!obj_filename.empty())
+        {
+            diags.Report(yasm::diag::fatal_option_conflict)
+                << "-o" << "multiple input files";
+            return EXIT_FAILURE;
+        }
+        if (!manifest_filename.empty())
+        {
+            diags.Report(yasm::diag::fatal_option_conflict)
+                << "--manifest" << "multiple input files";
+            return EXIT_FAILURE;
+        }
+        if (!feature_report_filename.empty())
+        {
+            diags.Report(yasm::diag::fatal_option_conflict)
+                << "--feature-report" << "multiple input files";
+            return EXIT_FAILURE;
+        }
+    }
+    if (!archive_filename.empty() && generate_make_dependencies)
+    {
+        diags.Report(yasm::diag::fatal_option_conflict) << "-M" << "--archive";
+        return EXIT_FAILURE;
+    }
+
+    for (std::vector<std::string>::const_iterator i=file_prefix_maps.begin(),
+         end=file_prefix_maps.end(); i != end; ++i)
+    {
+        size_t eq = i->find('=');
+        if (eq == std::string::npos || eq == 0)
+        {
+            diags.Report(yasm::diag::fatal_bad_prefix_map) << *i;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (const char* epoch = std::getenv("SOURCE_DATE_EPOCH"))
+    {
+        unsigned long long val;
+        if (llvm::StringRef(epoch).getAsInteger(10, val))
+        {
+            diags.Report(yasm::diag::fatal_bad_source_date_epoch) << epoch;
+            return EXIT_FAILURE;
+        }
+    }
+
     // If not already specified, default to bin as the object format.
     if (objfmt_keyword.empty())
         objfmt_keyword = "bin";
@@ -945,6 +1381,34 @@ main(int argc, char* argv[])
             listfmt_keyword = "nasm";
     }
 
-    return do_assemble(source_mgr, diags);
+    if (archive_filename.empty())
+        return do_assemble(source_mgr, diags, in_filenames.front(), 0);
+
+    yasm::ArchiveWriter archive;
+    for (std::vector<std::string>::const_iterator i=in_filenames.begin(),
+         end=in_filenames.end(); i != end; ++i)
+    {
+        // Give each input a fresh source manager so file contents and
+        // line tables don't accumulate across inputs.
+        yasm::SourceManager input_mgr(diags);
+        diags.setSourceManager(&input_mgr);
+        int status = do_assemble(input_mgr, diags, *i, &archive);
+        diags.setSourceManager(&source_mgr);
+        if (status != EXIT_SUCCESS)
+            return status;
+    }
+
+    // Only write the archive once every member has been assembled.
+    std::string err;
+    llvm::raw_fd_ostream out(archive_filename.c_str(), err,
+                             llvm::raw_fd_ostream::F_Binary);
+    if (!err.empty())
+    {
+        diags.Report(yasm::SourceLocation(), yasm::diag::err_cannot_open_file)
+            << archive_filename << err;
+        return EXIT_FAILURE;
+    }
+    archive.Write(out);
+    return EXIT_SUCCESS;
 }
 
@@ -104,6 +104,10 @@ static cl::list<bool> bits_32("32",
 static cl::list<bool> bits_64("64",
     cl::desc("set 64-bit output"));
 
+// --x32
+static cl::list<bool> bits_x32("x32",
+    cl::desc("set x32 ABI output (64-bit code in 32-bit ELF)"));
+
 // -defsym
 static cl::list<std::string> defsym("defsym",
     cl::desc("define symbol"));
@@ -156,6 +160,11 @@ static cl::list<std::string> plugin_names("plugin",
     cl::value_desc("plugin"));
 #endif
 
+// -mx86-used-note
+static cl::opt<std::string> x86_used_note("mx86-used-note",
+    cl::desc("Record x86 ISA level and features used in .note.gnu.property"),
+    cl::value_desc("yes|no"));
+
 // -o
 static cl::opt<std::string> obj_filename("o",
     cl::desc("Name of object-file output"),
@@ -282,42 +291,32 @@ ApplyWarningSettings(yasm::Diagnostic& diags)
     }
 }
 
+static void
+UpdateBitsSetting(const cl::list<bool>& opt,
+                  const char* value,
+                  unsigned int* pos,
+                  std::string* bits)
+{
+    if (opt.empty())
+        return;
+    unsigned int last = opt.getPosition(opt.size()-1);
+    if (last > *pos)
+    {
+        *pos = last;
+        *bits = value;
+    }
+}
+
 static std::string
 GetBitsSetting()
 {
     std::string bits = YGAS_OBJFMT_BITS;
 
-    // Walk through bits_32 and bits_64 in parallel, ordering by command line
-    // argument position.
-    unsigned int bits32_pos = 0, bits32_num = 0;
-    unsigned int bits64_pos = 0, bits64_num = 0;
-    for (;;)
-    {
-        if (bits32_num < bits_32.size())
-            bits32_pos = bits_32.getPosition(bits32_num);
-        else
-            bits32_pos = 0;
-        if (bits64_num < bits_64.size())
-            bits64_pos = bits_64.getPosition(bits64_num);
-        else
-            bits64_pos = 0;
-
-        if (bits32_pos != 0 && (bits64_pos == 0 || bits32_pos < bits64_pos))
-        {
-            // Handle bits32 option
-            ++bits32_num;
-            bits = "32";
-        }
-        else if (bits64_pos != 0 &&
-                 (bits32_pos == 0 || bits64_pos < bits32_pos))
-        {
-            // Handle bits64 option
-            ++bits64_num;
-            bits = "64";
-        }
-        else
-            break; // we're done with the list
-    }
+    // The last of -32, -64, and --x32 on the command line wins.
+    unsigned int pos = 0;
+    UpdateBitsSetting(bits_32, "32", &pos, &bits);
+    UpdateBitsSetting(bits_64, "64", &pos, &bits);
+    UpdateBitsSetting(bits_x32, "x32", &pos, &bits);
     return bits;
 }
 
@@ -358,6 +357,8 @@ ConfigureObject(yasm::Object& object)
         else
             break; // we're done with the list
     }
+
+    config.CodeProperties = (x86_used_note == "yes");
 }
 
 static int
@@ -366,7 +367,7 @@ do_assemble(yasm::SourceManager& source_mgr, yasm::Diagnostic& diags)
     // Apply warning settings
     ApplyWarningSettings(diags);
 
-    // Determine objfmt_bits based on -32 and -64 options
+    // Determine objfmt_bits based on -32, -64, and --x32 options
     std::string objfmt_bits = GetBitsSetting();
 
     yasm::FileManager file_mgr;
@@ -36,6 +36,7 @@
 
 #include "llvm/ADT/StringRef.h"
 #include "yasmx/Config/export.h"
+#include "yasmx/Basic/SourceLocation.h"
 #include "yasmx/DebugDumper.h"
 #include "yasmx/Location.h"
 #include "yasmx/Module.h"
@@ -55,10 +56,12 @@ class EffAddr;
 class Expr;
 class IntNum;
 class Insn;
+class Object;
 class ParserImpl;
 class Prefix;
 class Preprocessor;
 class SourceLocation;
+class SourceManager;
 class TargetModifier;
 class Token;
 
@@ -327,6 +330,98 @@ public:
     virtual bool ParseInsn(BytecodeContainer& container,
                            ParserImpl& parser) const;
 
+    /// Enable static performance analysis of appended instructions using
+    /// a microarchitecture model.  Must be called before any instructions
+    /// are appended.  The default implementation returns false.
+    /// @param model        model name
+    /// @return False if analysis is unsupported or model is unrecognized.
+    virtual bool setAnalysisModel(llvm::StringRef model);
+
+    /// Check the final code layout.  Called after the object has been
+    /// optimized and all offsets are final.  The default implementation
+    /// does nothing.
+    /// @param object       object
+    /// @param diags        diagnostic reporting
+    virtual void CheckLayout(const Object& object, Diagnostic& diags) const;
+
+    /// Write a report of the final code layout.  Call only after the
+    /// object has been optimized.  The default implementation does
+    /// nothing.
+    /// @param object       object
+    /// @param smgr         source manager
+    /// @param os           output stream
+    virtual void WriteLayout(const Object& object,
+                             const SourceManager& smgr,
+                             llvm::raw_ostream& os) const;
+
+    /// Write the performance analysis report.  Call only after the object
+    /// has been optimized.  The default implementation does nothing.
+    /// @param smgr         source manager
+    /// @param os           output stream
+    virtual void WriteAnalysis(const SourceManager& smgr,
+                               llvm::raw_ostream& os) const;
+
+    /// Processor-specific property of the assembled code: a property
+    /// type and its value.
+    typedef std::pair<unsigned long, unsigned long> CodeProperty;
+
+    /// Get processor-specific properties describing the instructions
+    /// appended so far, as ELF GNU program properties sorted by type.
+    /// The default implementation returns none.
+    /// @param props        properties (output)
+    virtual void getCodeProperties(std::vector<CodeProperty>& props) const;
+
+    /// Enable recording of the processor features used by each appended
+    /// instruction.  Must be called before any instructions are appended.
+    /// The default implementation returns false.
+    /// @return False if feature reports are unsupported.
+    virtual bool EnableFeatureReport();
+
+    /// Write the processor features used by each code section and each
+    /// function in it.  Call only after the object has been optimized.
+    /// The default implementation does nothing.
+    /// @param object       object
+    /// @param smgr         source manager
+    /// @param os           output stream
+    virtual void WriteFeatureReport(const Object& object,
+                                    const SourceManager& smgr,
+                                    llvm::raw_ostream& os) const;
+
+    /// Effect of an instruction on the stack frame, used to synthesize
+    /// call frame information.  Registers are DWARF register numbers.
+    struct FrameEffect
+    {
+        enum Kind
+        {
+            PUSH,       ///< push of size bytes from reg (-1 if not a reg)
+            POP,        ///< pop of size bytes into reg (-1 if not a reg)
+            ADJUST,     ///< stack pointer lowered by size bytes
+            SET_FP,     ///< frame pointer set from stack pointer
+            SET_SP,     ///< stack pointer set from frame pointer
+            LEAVE,      ///< SET_SP, then pop of size bytes into reg
+            RETURN,     ///< return to caller
+            UNKNOWN     ///< stack pointer changed by an unknown amount
+        };
+
+        Kind kind;
+        int reg;
+        long size;
+        Location loc;           ///< location following the instruction
+        SourceLocation source;  ///< source of the instruction
+    };
+
+    /// Enable recording of the stack frame effects of each appended
+    /// instruction.  Must be called before any instructions are appended.
+    /// The default implementation returns false.
+    /// @return False if frame effects are unsupported.
+    virtual bool EnableFrameEffects();
+
+    /// Get the stack frame effects of the instructions appended so far,
+    /// in the order appended.  Instructions that don't affect the stack
+    /// frame are omitted.  The default implementation returns none.
+    /// @param effects      frame effects (output)
+    virtual void getFrameEffects(std::vector<FrameEffect>& effects) const;
+
     /// Check an generic identifier to see if it matches architecture
     /// specific names for instructions or instruction prefixes.
     /// Unrecognized identifiers should return empty so they can be
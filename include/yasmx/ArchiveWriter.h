@@ -0,0 +1,92 @@
+#ifndef YASM_ARCHIVEWRITER_H
+#define YASM_ARCHIVEWRITER_H
+///
+/// @file
+/// @brief Static archive writer interface.
+///
+/// @license
+///  Copyright (C) 2011  PathScale Inc.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+/// @endlicense
+///
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+#include "yasmx/Config/export.h"
+
+
+namespace llvm { class raw_ostream; }
+
+namespace yasm
+{
+
+class Object;
+
+/// Collects object files in memory and writes them out as a single
+/// static library archive in the common System V / GNU "ar" format,
+/// including the symbol index used by linkers.  Header dates, owners,
+/// and modes are fixed, so output depends only on the members.
+class YASM_LIB_EXPORT ArchiveWriter
+{
+public:
+    /// Constructor.  The archive initially has no members.
+    ArchiveWriter();
+
+    /// Destructor.
+    ~ArchiveWriter();
+
+    /// Add an object file member.
+    /// @param name         member name; any directory part is removed
+    /// @param data         object file contents
+    /// @param object       object the file was generated from; its
+    ///                     defined global and common symbols are added
+    ///                     to the symbol index
+    void AddMember(llvm::StringRef name,
+                   llvm::StringRef data,
+                   const Object& object);
+
+    /// Get the number of members added so far.
+    /// @return Number of members.
+    std::size_t getNumMembers() const { return m_members.size(); }
+
+    /// Write the archive.
+    /// @param os           output stream
+    void Write(llvm::raw_ostream& os) const;
+
+private:
+    ArchiveWriter(const ArchiveWriter&);                    // not implemented
+    const ArchiveWriter& operator=(const ArchiveWriter&);   // not implemented
+
+    struct Member
+    {
+        std::string name;
+        std::string data;
+        std::vector<std::string> symbols;
+    };
+    std::vector<Member> m_members;
+};
+
+} // namespace yasm
+
+#endif
@@ -159,6 +159,10 @@ public:
     /// @return Architecture.
     Arch* getArch() { return m_arch.get(); }
 
+    /// Get the debug format.  Returns 0 until after InitObject() is called.
+    /// @return Debug format.
+    DebugFormat* getDebugFormat() { return m_dbgfmt.get(); }
+
     /// Get the object filename.  May return empty string if called prior
     /// to assemble() being called.
     llvm::StringRef getObjectFilename() const { return m_obj_filename; }
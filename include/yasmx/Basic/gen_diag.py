@@ -133,7 +133,7 @@ def output_groups(f):
                 lprint("diag::%s," % member, file=f, end='')
             lprint("-1 };", file=f)
         if group.subgroups:
-            lprint("static const char DiagSubGroup%d[] = { " % group.index,
+            lprint("static const short DiagSubGroup%d[] = { " % group.index,
                    file=f, end='')
             for subgroup in group.subgroups:
                 lprint("%d, " % groups[subgroup].index, file=f, end='')
@@ -174,6 +174,11 @@ add_group("init-nobits")
 add_group("uninit-contents")
 add_group("size-override")
 add_group("signed-overflow")
+add_group("avx-sse-transition")
+add_group("false-dependency")
+add_group("code-placement")
+add_group("performance",
+          ["avx-sse-transition", "false-dependency", "code-placement"])
 
 #####################################################################
 # Diagnostics
@@ -196,6 +201,21 @@ add_warning("warn_unknown_command_line_option",
             "unknown command line argument '%0'; try '-help'")
 add_fatal("fatal_bad_defsym",
           "bad defsym '%0'; format is --defsym name=value")
+add_fatal("fatal_bad_profile",
+          "malformed profile entry at '%0' line %1; format is <label> <count>")
+add_fatal("fatal_bad_prefix_map",
+          "bad prefix map '%0'; format is --file-prefix-map old=new")
+add_fatal("fatal_bad_source_date_epoch",
+          "SOURCE_DATE_EPOCH value '%0' is not a non-negative integer")
+add_fatal("fatal_archive_required", "multiple input files require --archive")
+add_fatal("fatal_option_conflict", "'%0' cannot be used with %1")
+add_fatal("fatal_feature_report_unsupported",
+          "architecture '%0' does not support feature reports")
+add_fatal("fatal_cfi_synthesis_unsupported",
+          "architecture '%0' does not support call frame synthesis")
+add_warning("warn_cfi_synthesis_ignored",
+            "--synthesize-cfi ignored; debug format '%0' has no call frame "
+            "information")
 
 # Source manager
 add_fatal("err_cannot_open_file", "cannot open file '%0': %1")
@@ -204,6 +224,9 @@ add_fatal("err_file_modified",
 add_fatal("err_unsupported_bom", "%0 byte order mark detected in '%1', but "
           "encoding is not supported")
 
+# Spill file
+add_fatal("fatal_spill_read", "could not read back spilled data")
+
 # yobjdump
 add_error("err_file_open", "could not open file '%0'")
 add_error("err_unrecognized_object_format", "unrecognized object format '%0'")
@@ -434,6 +457,31 @@ add_warning("warn_multiple_rex", "multiple REX prefixes, using leftmost")
 add_error("err_high8_rex_conflict",
           "cannot use A/B/C/DH with instruction needing REX")
 add_warning("warn_address_size_ignored", "address size override ignored")
+add_warning("warn_avx_sse_transition",
+            "legacy SSE instruction after 256-bit AVX code without vzeroupper",
+            group="avx-sse-transition",
+            mapping="IGNORE")
+add_warning("warn_avx_dirty_upper_branch",
+            "%select{call|return}0 with dirty upper YMM state; "
+            "use vzeroupper first",
+            group="avx-sse-transition",
+            mapping="IGNORE")
+add_note("note_avx256_here", "last 256-bit AVX instruction is here")
+add_warning("warn_hot_region_split",
+            "hot region '%0' (%1 bytes) spans %2 cache lines and %3 fetch "
+            "blocks; aligned, it would span %4 and %5",
+            group="code-placement",
+            mapping="IGNORE")
+add_warning("warn_hot_label_misaligned",
+            "branch target '%0' in hot region is %1 bytes into a 32-byte "
+            "fetch block",
+            group="code-placement",
+            mapping="IGNORE")
+add_warning("warn_false_dependency",
+            "instruction has a false dependency on the previous value of its "
+            "destination register; clear it with a dependency-breaking idiom",
+            group="false-dependency",
+            mapping="IGNORE")
 
 # Immediate
 add_error("err_imm_too_complex", "immediate expression too complex")
@@ -693,6 +741,9 @@ add_error("err_expected_merge_entity_size",
           "entity size for SHF_MERGE not specified")
 add_error("err_expected_group_name",
           "group name for SHF_GROUP not specified")
+add_warning("warn_gnu_property_exists",
+            "section '.note.gnu.property' already exists; not generating "
+            "ISA level note")
 
 # ELF/DWARF CFI
 add_error("err_nested_cfi",
@@ -708,6 +759,9 @@ add_error("err_cfi_state_stack_empty",
 add_warning("warn_cfi_routine_ignored", "personality routine ignored")
 add_error("err_cfi_invalid_encoding", "invalid or unsupported encoding")
 add_error("err_cfi_routine_required", "personality routine symbol required")
+add_warning("warn_cfi_synthesis_untracked",
+            "no call frame information synthesized for '%0'; stack pointer "
+            "changed by an unknown amount")
 
 # COFF object format
 add_warning("warn_coff_section_name_length",
@@ -0,0 +1,112 @@
+#ifndef YASM_CODEPROFILE_H
+#define YASM_CODEPROFILE_H
+///
+/// @file
+/// @brief Execution profile interface.
+///
+/// @license
+///  Copyright (C) 2011  PathScale Inc.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+/// @endlicense
+///
+#include <map>
+#include <string>
+
+#include "llvm/ADT/StringRef.h"
+#include "yasmx/Config/export.h"
+#include "yasmx/Basic/SourceLocation.h"
+
+
+namespace yasm
+{
+
+class BytecodeContainer;
+class Object;
+
+/// Execution counts of code labels, used to align only the labels that
+/// are hot enough to pay for the padding.
+class YASM_LIB_EXPORT CodeProfile
+{
+public:
+    /// Constructor.  The profile is initially empty.
+    CodeProfile();
+
+    /// Destructor.
+    ~CodeProfile();
+
+    /// Add entries from profile text.  Each line contains a label name
+    /// and its execution count, separated by whitespace; blank lines and
+    /// anything following '#' are ignored.  Counts of labels listed more
+    /// than once are summed.  If any entry is malformed, the profile is
+    /// left empty.
+    /// @param text         profile text
+    /// @param line         line number of first malformed entry (output)
+    /// @return False if a malformed entry was found.
+    bool Parse(llvm::StringRef text, /*@out@*/ unsigned long* line);
+
+    /// Determine if the profile has no entries.
+    /// @return True if empty.
+    bool empty() const { return m_counts.empty(); }
+
+    /// Remove all entries.
+    void Clear();
+
+    /// Decide how to align a label.  Labels executed less than 1/64th as
+    /// often as the hottest label are not aligned.  Labels at least 1/4th
+    /// as hot are aligned to a 32-byte fetch block, others to 16 bytes.
+    /// The padding allowed grows with the relative count, up to a full
+    /// boundary.
+    /// @param label        label name
+    /// @param boundary     alignment boundary (output)
+    /// @param maxskip      maximum padding in bytes (output)
+    /// @return False if the label should not be aligned.
+    bool getAlignment(llvm::StringRef label,
+                      /*@out@*/ unsigned long* boundary,
+                      /*@out@*/ unsigned long* maxskip) const;
+
+private:
+    CodeProfile(const CodeProfile&);                    // not implemented
+    const CodeProfile& operator=(const CodeProfile&);   // not implemented
+
+    typedef std::map<std::string, unsigned long long> Counts;
+    Counts m_counts;                ///< Execution count of each label
+    unsigned long long m_max;       ///< Largest execution count
+};
+
+/// Append code alignment ahead of a label about to be defined if the
+/// object's profile marks it as hot.  Nothing is appended outside code
+/// sections or if the object has no profile.  The alignment is an
+/// ordinary align bytecode, so its size is settled by the optimizer.
+/// @param object       object
+/// @param container    container the label will be defined in
+/// @param label        label name
+/// @param source       source location of label
+YASM_LIB_EXPORT
+void AppendProfileAlign(Object& object,
+                        BytecodeContainer& container,
+                        llvm::StringRef label,
+                        SourceLocation source);
+
+} // namespace yasm
+
+#endif
@@ -64,6 +64,11 @@ public:
     /// Add directive handlers.
     virtual void AddDirectives(Directives& dirs, llvm::StringRef parser);
 
+    /// Determine if the debug format generates call frame information,
+    /// and so can synthesize it from the architecture's frame effects.
+    /// @return True if call frame information is generated.
+    virtual bool hasCallFrameInfo() const;
+
     /// Generate debugging information bytecodes.
     /// @param objfmt   object format
     /// @param smgr     source manager
@@ -29,6 +29,8 @@
 /// POSSIBILITY OF SUCH DAMAGE.
 /// @endlicense
 ///
+#include <vector>
+
 #include "yasmx/Config/export.h"
 #include "yasmx/Config/functional.h"
 
@@ -103,6 +105,25 @@ Evaluate(const Expr& e,
     return Evaluate(e, diags, result, 0, 0, valueloc, zeroreg);
 }
 
+/// Try to reduce an expression to a linear combination of its
+/// substitution terms, constant + sum(coefs[i]*subst[i]), so it can be
+/// re-evaluated for new substitution values without Evaluate().  Only
+/// integer constants, substitutions, addition, subtraction, negation,
+/// and multiplication by a constant are handled.  The constant and each
+/// coefficient are limited to 32-bit signed values, so evaluating the
+/// linear form with 64-bit arithmetic cannot overflow for 32-bit
+/// substitution values.
+/// @param e            expression
+/// @param nsubst       number of substitution terms
+/// @param constant     constant term (output)
+/// @param coefs        coefficient of each substitution term (output)
+/// @return False if the expression is not linear or a value is too large.
+YASM_LIB_EXPORT
+bool Linearize(const Expr& e,
+               unsigned int nsubst,
+               /*@out@*/ long* constant,
+               /*@out@*/ std::vector<long>* coefs);
+
 } // namespace yasm
 
 #endif
@@ -31,11 +31,13 @@
 ///
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "llvm/ADT/StringRef.h"
 #include "yasmx/Config/export.h"
 #include "yasmx/Support/ptr_vector.h"
 #include "yasmx/Support/scoped_ptr.h"
+#include "yasmx/Basic/SourceLocation.h"
 #include "yasmx/DebugDumper.h"
 #include "yasmx/Location.h"
 #include "yasmx/SymbolRef.h"
@@ -47,8 +49,10 @@ namespace yasm
 {
 
 class Arch;
+class CodeProfile;
 class Diagnostic;
 class Section;
+class SpillFile;
 class Symbol;
 
 /// An object.  This is the internal representation of an object file.
@@ -64,6 +68,12 @@ public:
         /// to be generated even if the symbol is in the same section as
         /// the value.  Defaults to false.
         bool DisableGlobalSubRelative;
+
+        /// Size of a target address, in bits, when the object format
+        /// narrows it from the architecture's (e.g. the ELF x32 ABI uses
+        /// 32-bit addresses for 64-bit code).  Defaults to 0 (use
+        /// Arch::getAddressSize()).
+        unsigned int AddressSize;
     };
 
     /// Generic object configuration.
@@ -76,6 +86,34 @@ public:
         /// Advise linker that stack should be non-executable.
         /// Defaults to false.
         bool NoExecStack;
+
+        /// Record the processor features used by the code, for object
+        /// formats that support it (e.g. ELF .note.gnu.property).
+        /// Defaults to false.
+        bool CodeProperties;
+
+        /// Move constant bytecode data of at least this many bytes out of
+        /// memory into a temporary spill file until output time.
+        /// Defaults to 0 (never spill).
+        unsigned long SpillThreshold;
+
+        /// Produce identical output for identical input: timestamps come
+        /// from SOURCE_DATE_EPOCH, or are zero if it is unset.
+        /// Defaults to false.
+        bool Deterministic;
+
+        /// Give global code labels without an explicit symbol type or
+        /// size a function type, sized up to the next global label in
+        /// the section (or the section end), for object formats that
+        /// support it (e.g. ELF).
+        /// Defaults to false.
+        bool FunctionSizes;
+
+        /// Keep relocations for PC-relative references to global symbols
+        /// that can't be preempted (e.g. ELF hidden symbols) in the same
+        /// section, rather than resolving them at assembly time.
+        /// Defaults to false.
+        bool KeepPCRelRelocs;
     };
 
     /// Constructor.  A default section is created as the first
@@ -114,6 +152,89 @@ public:
     Options& getOptions() { return m_options; }
     Config& getConfig() { return m_config; }
 
+    typedef std::vector<std::string> Dependencies;
+
+    /// Record an external (non-source) file the object contents depend on,
+    /// such as data pulled in with incbin.  Duplicates are ignored.
+    /// @param filename     filename as opened
+    void AddDependency(llvm::StringRef filename);
+
+    /// Get the external file dependencies, in the order first recorded.
+    /// @return Dependency filenames.
+    const Dependencies& getDependencies() const { return m_dependencies; }
+
+    /// Get the size from which constant bytecode data is moved to the
+    /// spill file.  Only data created while parsing is spilled: once the
+    /// object is finalized this returns 0, as debug information and other
+    /// generated sections may still patch their bytes after writing them.
+    /// @return Spill threshold in bytes (0 if no spilling).
+    unsigned long getSpillThreshold() const
+    { return m_finalized ? 0 : m_config.SpillThreshold; }
+
+    /// Get the spill file used to hold bytecode data out of memory.
+    /// The spill file is created on first use.
+    /// @return Spill file.
+    SpillFile& getSpillFile();
+
+    /// Set the execution profile used to align hot code labels.
+    /// @param profile      profile
+    void setProfile(std::auto_ptr<CodeProfile> profile);
+
+    /// Get the execution profile.
+    /// @return Profile, or NULL if none has been set.
+    /*@null@*/ const CodeProfile* getProfile() const
+    { return m_profile.get(); }
+
+    /// Add a path prefix mapping applied to filenames and directories
+    /// recorded in the output (e.g. debug information).  Mappings added
+    /// later take precedence over earlier ones.
+    /// @param from         prefix to replace
+    /// @param to           replacement prefix
+    void AddPathMap(llvm::StringRef from, llvm::StringRef to);
+
+    /// Apply the path prefix mappings to a path.
+    /// @param path         path
+    /// @return Path with the most recently added matching prefix replaced,
+    ///         or the path unchanged if no mapping matches.
+    std::string RemapPath(llvm::StringRef path) const;
+
+    /// Get the timestamp to record in the output.  SOURCE_DATE_EPOCH is
+    /// used if set to a valid value; otherwise the timestamp is zero in
+    /// deterministic mode (or under the test suite) and the current time
+    /// if not.
+    /// @return Timestamp, in seconds since the epoch.
+    unsigned long getTimestamp() const;
+
+    /// Determine if getTimestamp() is fixed rather than the current time.
+    /// Other times that vary between builds, such as source modification
+    /// times, should then be left out of the output.
+    /// @return True if SOURCE_DATE_EPOCH is set to a valid value, or in
+    ///         deterministic mode (or under the test suite).
+    bool hasFixedTimestamp() const;
+
+    /// Get the assembler version to record in the object file (e.g. in
+    /// debug information).  This is fixed under the test suite so that
+    /// test output doesn't change from one release to the next.
+    /// @return Version, as "major.minor.subminor".
+    llvm::StringRef getVersion() const;
+
+    /// Start and source of an appended instruction.
+    struct InsnLine
+    {
+        Location loc;               ///< Start of the instruction
+        SourceLocation source;      ///< Source of the instruction
+    };
+    typedef std::vector<InsnLine> InsnLines;
+
+    /// Start recording the start and source of each instruction as it is
+    /// appended, for debug formats that need finer line information than
+    /// bytecode sources give (several instructions may share a bytecode).
+    void EnableInsnLines();
+
+    /// Get the recorded instruction lines, in the order appended.
+    /// @return Instruction lines, or NULL if recording is not enabled.
+    /*@null@*/ InsnLines* getInsnLines() { return m_insn_lines.get(); }
+
     /// Optimize an object.  Takes the unoptimized object and optimizes it.
     /// If successful, the object is ready for output to an object file.
     /// @param diags    diagnostic reporting
@@ -261,6 +382,23 @@ private:
     Options m_options;                  ///< Object options
     Config m_config;                    ///< Object configuration
 
+    Dependencies m_dependencies;        ///< External file dependencies
+
+    /// Path prefix mappings, in the order added.
+    std::vector<std::pair<std::string, std::string> > m_path_map;
+
+    /// True once Finalize() has been called.
+    bool m_finalized;
+
+    /// Spill file for bytecode data (NULL until first used).
+    util::scoped_ptr<SpillFile> m_spill;
+
+    /// Execution profile (NULL if none).
+    util::scoped_ptr<CodeProfile> m_profile;
+
+    /// Recorded instruction lines (NULL if not enabled).
+    util::scoped_ptr<InsnLines> m_insn_lines;
+
     Arch* m_arch;                       ///< Target architecture
 
     /// Currently active section.  Used by some directives.  NULL if no
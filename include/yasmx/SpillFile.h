@@ -0,0 +1,86 @@
+#ifndef YASM_SPILLFILE_H
+#define YASM_SPILLFILE_H
+///
+/// @file
+/// @brief Spill file interface.
+///
+/// @license
+///  Copyright (C) 2011  PathScale Inc.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+/// @endlicense
+///
+#include <cstdio>
+
+#include "llvm/System/DataTypes.h"
+#include "yasmx/Config/export.h"
+
+
+namespace yasm
+{
+
+class Bytes;
+
+/// Anonymous temporary file used to hold bytecode data out of memory
+/// until output time.  Data is only ever appended; each write returns
+/// the offset it can later be read back from.  Offsets are 64-bit, so the
+/// file may grow past 4GB even where long is 32 bits.  The file is removed
+/// automatically when closed.
+class YASM_LIB_EXPORT SpillFile
+{
+public:
+    /// Constructor.  The underlying file is not created until the first
+    /// write.
+    SpillFile();
+
+    /// Destructor.  Closes (and thereby removes) the underlying file.
+    ~SpillFile();
+
+    /// Append bytes to the end of the spill file.
+    /// @param bytes        bytes to write
+    /// @param offset       offset of the written data in the file (output)
+    /// @return False if the file could not be created or written.
+    bool Write(const Bytes& bytes, /*@out@*/ uint64_t* offset);
+
+    /// Read previously written bytes back from the spill file.
+    /// The data is appended to the end of bytes.
+    /// @param offset       offset returned by Write()
+    /// @param size         number of bytes to read
+    /// @param bytes        bytes to read into
+    /// @return False if the data could not be read.
+    bool Read(uint64_t offset, unsigned long size, Bytes& bytes);
+
+    /// Get the total number of bytes spilled so far.
+    /// @return Spill file size.
+    uint64_t getSize() const { return m_size; }
+
+private:
+    SpillFile(const SpillFile&);                    // not implemented
+    const SpillFile& operator=(const SpillFile&);   // not implemented
+
+    /*@null@*/ std::FILE* m_file;   ///< Underlying file (NULL if none yet)
+    uint64_t m_size;                ///< Current file size
+};
+
+} // namespace yasm
+
+#endif
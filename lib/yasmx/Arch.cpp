@@ -66,6 +66,58 @@ Arch::ParseInsn(BytecodeContainer& container, ParserImpl& parser) const
     return false;
 }
 
+bool
+Arch::setAnalysisModel(llvm::StringRef model)
+{
+    return false;
+}
+
+void
+Arch::CheckLayout(const Object& object, Diagnostic& diags) const
+{
+}
+
+void
+Arch::WriteLayout(const Object& object,
+                  const SourceManager& smgr,
+                  llvm::raw_ostream& os) const
+{
+}
+
+void
+Arch::WriteAnalysis(const SourceManager& smgr, llvm::raw_ostream& os) const
+{
+}
+
+void
+Arch::getCodeProperties(std::vector<CodeProperty>& props) const
+{
+}
+
+bool
+Arch::EnableFeatureReport()
+{
+    return false;
+}
+
+void
+Arch::WriteFeatureReport(const Object& object,
+                         const SourceManager& smgr,
+                         llvm::raw_ostream& os) const
+{
+}
+
+bool
+Arch::EnableFrameEffects()
+{
+    return false;
+}
+
+void
+Arch::getFrameEffects(std::vector<FrameEffect>& effects) const
+{
+}
+
 ArchModule::~ArchModule()
 {
 }
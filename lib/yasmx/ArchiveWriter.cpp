@@ -0,0 +1,199 @@
+//
+// Static archive writer implementation.
+//
+//  Copyright (C) 2011  PathScale Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "yasmx/ArchiveWriter.h"
+
+#include "llvm/Support/raw_ostream.h"
+#include "yasmx/Object.h"
+#include "yasmx/Symbol.h"
+
+
+using namespace yasm;
+
+// Member names longer than this go in the long name table.
+static const std::size_t MAX_SHORT_NAME = 15;
+
+ArchiveWriter::ArchiveWriter()
+{
+}
+
+ArchiveWriter::~ArchiveWriter()
+{
+}
+
+void
+ArchiveWriter::AddMember(llvm::StringRef name,
+                         llvm::StringRef data,
+                         const Object& object)
+{
+    size_t slash = name.rfind('/');
+    if (slash != llvm::StringRef::npos)
+        name = name.substr(slash+1);
+
+    m_members.push_back(Member());
+    Member& member = m_members.back();
+    member.name = name;
+    member.data = data;
+
+    for (Object::const_symbol_iterator i = object.symbols_begin(),
+         end = object.symbols_end(); i != end; ++i)
+    {
+        int vis = i->getVisibility();
+        if ((vis & Symbol::COMMON) ||
+            ((vis & Symbol::GLOBAL) && i->isDefined()))
+            member.symbols.push_back(i->getName());
+    }
+}
+
+// Write a header field, left-justified and space padded.
+static void
+WriteField(llvm::raw_ostream& os, llvm::StringRef str, unsigned int width)
+{
+    os << str;
+    os.indent(width - str.size());
+}
+
+static void
+WriteField(llvm::raw_ostream& os, unsigned long val, unsigned int width)
+{
+    std::string str;
+    llvm::raw_string_ostream ss(str);
+    ss << val;
+    WriteField(os, ss.str(), width);
+}
+
+static void
+WriteHeader(llvm::raw_ostream& os, llvm::StringRef name, unsigned long size,
+            bool object)
+{
+    WriteField(os, name, 16);
+    WriteField(os, 0UL, 12);                // date
+    WriteField(os, 0UL, 6);                 // uid
+    WriteField(os, 0UL, 6);                 // gid
+    WriteField(os, object ? "644" : "0", 8);// mode (octal)
+    WriteField(os, size, 10);
+    os << "`\n";
+}
+
+static void
+WriteBE32(llvm::raw_ostream& os, unsigned long val)
+{
+    os << static_cast<char>((val >> 24) & 0xff)
+       << static_cast<char>((val >> 16) & 0xff)
+       << static_cast<char>((val >> 8) & 0xff)
+       << static_cast<char>(val & 0xff);
+}
+
+void
+ArchiveWriter::Write(llvm::raw_ostream& os) const
+{
+    static const unsigned long HEADER_SIZE = 60;
+
+    // Long name table, and the name each member header gets.
+    std::string longnames;
+    std::vector<std::string> hdrnames;
+    for (std::vector<Member>::const_iterator i=m_members.begin(),
+         end=m_members.end(); i != end; ++i)
+    {
+        if (i->name.size() <= MAX_SHORT_NAME)
+            hdrnames.push_back(i->name + '/');
+        else
+        {
+            std::string str;
+            llvm::raw_string_ostream ss(str);
+            ss << '/' << longnames.size();
+            hdrnames.push_back(ss.str());
+            longnames += i->name;
+            longnames += "/\n";
+        }
+    }
+
+    // Symbol index size.
+    unsigned long nsyms = 0, symnames_size = 0;
+    for (std::vector<Member>::const_iterator i=m_members.begin(),
+         end=m_members.end(); i != end; ++i)
+    {
+        nsyms += i->symbols.size();
+        for (std::vector<std::string>::const_iterator j=i->symbols.begin(),
+             jend=i->symbols.end(); j != jend; ++j)
+            symnames_size += j->size() + 1;
+    }
+    unsigned long symtab_size = 4 + 4*nsyms + symnames_size;
+
+    // Member offsets.
+    unsigned long offset = 8;
+    if (nsyms > 0)
+        offset += HEADER_SIZE + symtab_size + (symtab_size & 1);
+    if (!longnames.empty())
+        offset += HEADER_SIZE + longnames.size() + (longnames.size() & 1);
+    std::vector<unsigned long> offsets;
+    for (std::vector<Member>::const_iterator i=m_members.begin(),
+         end=m_members.end(); i != end; ++i)
+    {
+        offsets.push_back(offset);
+        offset += HEADER_SIZE + i->data.size() + (i->data.size() & 1);
+    }
+
+    os << "!<arch>\n";
+
+    // Symbol index: count, member offset of each symbol, then names.
+    if (nsyms > 0)
+    {
+        WriteHeader(os, "/", symtab_size, false);
+        WriteBE32(os, nsyms);
+        for (std::size_t i=0; i<m_members.size(); ++i)
+        {
+            for (std::size_t j=0; j<m_members[i].symbols.size(); ++j)
+                WriteBE32(os, offsets[i]);
+        }
+        for (std::vector<Member>::const_iterator i=m_members.begin(),
+             end=m_members.end(); i != end; ++i)
+        {
+            for (std::vector<std::string>::const_iterator
+                 j=i->symbols.begin(), jend=i->symbols.end(); j != jend; ++j)
+                os << *j << '\0';
+        }
+        if (symtab_size & 1)
+            os << '\n';
+    }
+
+    if (!longnames.empty())
+    {
+        WriteHeader(os, "//", longnames.size(), false);
+        os << longnames;
+        if (longnames.size() & 1)
+            os << '\n';
+    }
+
+    for (std::size_t i=0; i<m_members.size(); ++i)
+    {
+        const std::string& data = m_members[i].data;
+        WriteHeader(os, hdrnames[i], data.size(), true);
+        os << data;
+        if (data.size() & 1)
+            os << '\n';
+    }
+}
@@ -335,6 +335,8 @@ Assembler::Assemble(SourceManager& source_mgr, Diagnostic& diags)
     if (diags.hasErrorOccurred())
         return false;
 
+    m_arch->CheckLayout(*m_object, diags);
+
     // generate any debugging information
     m_dbgfmt->Generate(*m_objfmt, source_mgr, diags);
 
@@ -24,14 +24,23 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 //
+#define DEBUG_TYPE "BytecodeContainer"
+
 #include "yasmx/BytecodeContainer.h"
 
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringExtras.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/BytecodeOutput.h"
 #include "yasmx/Bytecode.h"
 #include "yasmx/Expr.h"
+#include "yasmx/Object.h"
 #include "yasmx/Optimizer.h"
+#include "yasmx/Section.h"
+#include "yasmx/SpillFile.h"
+
 
+STATISTIC(num_spilled, "Number of bytecodes spilled to disk");
 
 using namespace yasm;
 
@@ -70,6 +79,39 @@ public:
 private:
     unsigned long m_size;       ///< size of gap (in bytes)
 };
+
+class SpillBytecode : public Bytecode::Contents
+{
+public:
+    SpillBytecode(SpillFile& spill, uint64_t offset, unsigned long size);
+    ~SpillBytecode();
+
+    /// Finalizes the bytecode after parsing.
+    bool Finalize(Bytecode& bc, Diagnostic& diags);
+
+    /// Calculates the minimum size of a bytecode.
+    bool CalcLen(Bytecode& bc,
+                 /*@out@*/ unsigned long* len,
+                 const Bytecode::AddSpanFunc& add_span,
+                 Diagnostic& diags);
+
+    /// Output a bytecode.
+    bool Output(Bytecode& bc, BytecodeOutput& bc_out);
+
+    llvm::StringRef getType() const;
+
+    SpillBytecode* clone() const;
+
+#ifdef WITH_XML
+    /// Write an XML representation.  For debugging purposes.
+    pugi::xml_node Write(pugi::xml_node out) const;
+#endif // WITH_XML
+
+private:
+    SpillFile& m_spill;         ///< spill file holding the data
+    uint64_t m_offset;          ///< offset of data in spill file
+    unsigned long m_size;       ///< size of data (in bytes)
+};
 } // anonymous namespace
 
 GapBytecode::GapBytecode(unsigned long size)
@@ -132,6 +174,71 @@ GapBytecode::Write(pugi::xml_node out) const
 }
 #endif // WITH_XML
 
+SpillBytecode::SpillBytecode(SpillFile& spill,
+                             uint64_t offset,
+                             unsigned long size)
+    : m_spill(spill),
+      m_offset(offset),
+      m_size(size)
+{
+}
+
+SpillBytecode::~SpillBytecode()
+{
+}
+
+bool
+SpillBytecode::Finalize(Bytecode& bc, Diagnostic& diags)
+{
+    return true;
+}
+
+bool
+SpillBytecode::CalcLen(Bytecode& bc,
+                       /*@out@*/ unsigned long* len,
+                       const Bytecode::AddSpanFunc& add_span,
+                       Diagnostic& diags)
+{
+    *len = m_size;
+    return true;
+}
+
+bool
+SpillBytecode::Output(Bytecode& bc, BytecodeOutput& bc_out)
+{
+    Bytes& bytes = bc_out.getScratch();
+    if (!m_spill.Read(m_offset, m_size, bytes))
+    {
+        bc_out.Diag(bc.getSource(), diag::fatal_spill_read);
+        return false;
+    }
+    bc_out.OutputBytes(bytes, bc.getSource());
+    return true;
+}
+
+llvm::StringRef
+SpillBytecode::getType() const
+{
+    return "yasm::SpillBytecode";
+}
+
+SpillBytecode*
+SpillBytecode::clone() const
+{
+    return new SpillBytecode(m_spill, m_offset, m_size);
+}
+
+#ifdef WITH_XML
+pugi::xml_node
+SpillBytecode::Write(pugi::xml_node out) const
+{
+    pugi::xml_node root = out.append_child("Spill");
+    append_child(root, "Offset", llvm::utostr(m_offset));
+    append_child(root, "Size", m_size);
+    return root;
+}
+#endif // WITH_XML
+
 BytecodeContainer::BytecodeContainer(Section* sect)
     : m_sect(sect),
       m_bcs_owner(m_bcs),
@@ -187,6 +294,24 @@ BytecodeContainer::FreshBytecode()
     Bytecode& bc = bytecodes_back();
     if (bc.hasContents())
         return StartBytecode();
+    if (m_sect && !bc.m_fixed.empty() && bc.m_fixed_fixups.empty())
+    {
+        // Move large constant data out of memory.  The bytecode keeps its
+        // total length, so locations pointing into it remain valid.
+        Object* object = m_sect->getObject();
+        unsigned long thres = object ? object->getSpillThreshold() : 0;
+        unsigned long size = static_cast<unsigned long>(bc.m_fixed.size());
+        uint64_t offset;
+        if (thres != 0 && size >= thres &&
+            object->getSpillFile().Write(bc.m_fixed, &offset))
+        {
+            Bytes().swap(bc.m_fixed);
+            bc.Transform(Bytecode::Contents::Ptr(
+                new SpillBytecode(object->getSpillFile(), offset, size)));
+            ++num_spilled;
+            return StartBytecode();
+        }
+    }
     return bc;
 }
 
@@ -0,0 +1,162 @@
+//
+// Execution profile implementation.
+//
+//  Copyright (C) 2011  PathScale Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "yasmx/CodeProfile.h"
+
+#include "yasmx/Arch.h"
+#include "yasmx/BytecodeContainer.h"
+#include "yasmx/Expr.h"
+#include "yasmx/Object.h"
+#include "yasmx/Section.h"
+
+
+using namespace yasm;
+
+static const char* whitespace = " \t\r\f\v";
+
+CodeProfile::CodeProfile()
+    : m_max(0)
+{
+}
+
+CodeProfile::~CodeProfile()
+{
+}
+
+bool
+CodeProfile::Parse(llvm::StringRef text, unsigned long* line)
+{
+    unsigned long linenum = 0;
+    while (!text.empty())
+    {
+        std::pair<llvm::StringRef, llvm::StringRef> split = text.split('\n');
+        llvm::StringRef str = split.first;
+        text = split.second;
+        ++linenum;
+
+        // Strip comment
+        size_t comment = str.find('#');
+        if (comment != llvm::StringRef::npos)
+            str = str.substr(0, comment);
+
+        // Label
+        size_t start = str.find_first_not_of(whitespace);
+        if (start == llvm::StringRef::npos)
+            continue;   // blank line
+        str = str.substr(start);
+        size_t end = str.find_first_of(whitespace);
+        llvm::StringRef label = str.substr(0, end);
+
+        // Count; must be the last thing on the line
+        str = str.substr(end);
+        start = str.find_first_not_of(whitespace);
+        if (start == llvm::StringRef::npos)
+        {
+            *line = linenum;
+            Clear();
+            return false;
+        }
+        str = str.substr(start);
+        end = str.find_first_of(whitespace);
+        llvm::StringRef countstr = str.substr(0, end);
+        unsigned long long count;
+        if (countstr.getAsInteger(10, count) ||
+            str.substr(end).find_first_not_of(whitespace)
+                != llvm::StringRef::npos)
+        {
+            *line = linenum;
+            Clear();
+            return false;
+        }
+
+        unsigned long long& total = m_counts[label];
+        total += count;
+        if (total < count)
+            total = ~0ULL;      // saturate
+        if (total > m_max)
+            m_max = total;
+    }
+    return true;
+}
+
+void
+CodeProfile::Clear()
+{
+    m_counts.clear();
+    m_max = 0;
+}
+
+bool
+CodeProfile::getAlignment(llvm::StringRef label,
+                          unsigned long* boundary,
+                          unsigned long* maxskip) const
+{
+    Counts::const_iterator i = m_counts.find(label);
+    if (i == m_counts.end() || i->second == 0)
+        return false;
+
+    // Padding in front of a label is executed at most once per entry by
+    // fallthrough, while a misaligned label costs a partial fetch block
+    // every time it's reached; the cold fraction of the code isn't worth
+    // growing at all.
+    double heat = static_cast<double>(i->second) / m_max;
+    if (heat < 1.0/64)
+        return false;
+
+    *boundary = heat >= 0.25 ? 32 : 16;
+    double skip = *boundary * 4 * heat;
+    if (skip >= *boundary - 1)
+        *maxskip = *boundary - 1;
+    else if (skip < 1)
+        *maxskip = 1;
+    else
+        *maxskip = static_cast<unsigned long>(skip);
+    return true;
+}
+
+void
+yasm::AppendProfileAlign(Object& object,
+                         BytecodeContainer& container,
+                         llvm::StringRef label,
+                         SourceLocation source)
+{
+    const CodeProfile* profile = object.getProfile();
+    if (!profile)
+        return;
+
+    Section* sect = container.getSection();
+    if (!sect || !sect->isCode())
+        return;
+
+    unsigned long boundary, maxskip;
+    if (!profile->getAlignment(label, &boundary, &maxskip))
+        return;
+
+    if (boundary > sect->getAlign())
+        sect->setAlign(boundary);
+    AppendAlign(container, Expr(boundary), Expr(), Expr(maxskip),
+                object.getArch()->getFill(), source);
+}
@@ -41,6 +41,12 @@ DebugFormat::AddDirectives(Directives& dirs, llvm::StringRef parser)
 {
 }
 
+bool
+DebugFormat::hasCallFrameInfo() const
+{
+    return false;
+}
+
 DebugFormatModule::~DebugFormatModule()
 {
 }
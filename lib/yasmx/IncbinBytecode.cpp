@@ -34,6 +34,8 @@
 #include "yasmx/Bytes.h"
 #include "yasmx/Expr.h"
 #include "yasmx/IntNum.h"
+#include "yasmx/Object.h"
+#include "yasmx/Section.h"
 #include "yasmx/Value.h"
 
 
@@ -108,6 +110,13 @@ IncbinBytecode::Finalize(Bytecode& bc, Diagnostic& diags)
         return false;
     }
 
+    // Record the file so dependency output can list it.
+    if (BytecodeContainer* container = bc.getContainer())
+    {
+        if (Section* sect = container->getSection())
+            sect->getObject()->AddDependency(m_filename);
+    }
+
     if (m_start)
     {
         Value val(0, Expr::Ptr(m_start->clone()));
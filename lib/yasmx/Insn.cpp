@@ -34,6 +34,8 @@
 #include "yasmx/EffAddr.h"
 #include "yasmx/Expr.h"
 #include "yasmx/Expr_util.h"
+#include "yasmx/Object.h"
+#include "yasmx/Section.h"
 
 
 using namespace yasm;
@@ -304,7 +306,18 @@ Insn::Append(BytecodeContainer& container,
     }
     if (!ok)
         return false;
-    return DoAppend(container, source, diags);
+
+    Section* sect = container.getSection();
+    Object* object = sect ? sect->getObject() : 0;
+    Object::InsnLines* lines = object ? object->getInsnLines() : 0;
+    if (!lines)
+        return DoAppend(container, source, diags);
+
+    Object::InsnLine line = {container.getEndLoc(), source};
+    if (!DoAppend(container, source, diags))
+        return false;
+    lines->push_back(line);
+    return true;
 }
 
 #ifdef WITH_XML
@@ -26,8 +26,11 @@
 //
 #include "yasmx/Location_util.h"
 
+#include <algorithm>
+
 #include "llvm/ADT/APFloat.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/System/DataTypes.h"
 #include "yasmx/Bytecode.h"
 #include "yasmx/Expr.h"
 #include "yasmx/IntNum.h"
@@ -215,12 +218,15 @@ struct SubstDistFunctor
     const TR1::function<void (unsigned int subst,
                               Location loc,
                               Location loc2)>& m_func;
-    unsigned int m_subst;
+    // The functor is copied for each subexpression, so the count is kept
+    // outside of it.
+    unsigned int& m_subst;
 
     SubstDistFunctor(const TR1::function<void (unsigned int subst,
                                                Location loc,
-                                               Location loc2)>& func)
-        : m_func(func), m_subst(0)
+                                               Location loc2)>& func,
+                     unsigned int& subst)
+        : m_func(func), m_subst(subst)
     {}
 
     bool operator() (ExprTerm& term, Location loc, Location loc2)
@@ -242,9 +248,10 @@ yasm::SubstDist(Expr& e, Diagnostic& diags,
                                           Location loc,
                                           Location loc2)>& func)
 {
-    SubstDistFunctor functor(func);
+    unsigned int subst = 0;
+    SubstDistFunctor functor(func, subst);
     e.Simplify(diags, TR1::bind(&TransformDistBase, _1, _2, functor));
-    return functor.m_subst;
+    return subst;
 }
 
 bool
@@ -393,3 +400,158 @@ yasm::Evaluate(const Expr& e,
     result->swap(stack.back());
     return true;
 }
+
+namespace {
+// Linear combination of substitution terms, used by Linearize().
+struct LinearTerm
+{
+    LinearTerm(int64_t c, unsigned int nsubst) : constant(c), coefs(nsubst) {}
+
+    bool isConstant() const
+    {
+        for (std::vector<int64_t>::const_iterator i=coefs.begin(),
+             end=coefs.end(); i != end; ++i)
+        {
+            if (*i != 0)
+                return false;
+        }
+        return true;
+    }
+
+    void Scale(int64_t factor)
+    {
+        constant *= factor;
+        for (std::vector<int64_t>::iterator i=coefs.begin(), end=coefs.end();
+             i != end; ++i)
+            *i *= factor;
+    }
+
+    void Add(const LinearTerm& other, int64_t sign)
+    {
+        constant += sign*other.constant;
+        for (std::size_t i=0; i<coefs.size(); ++i)
+            coefs[i] += sign*other.coefs[i];
+    }
+
+    // Keep every value within 32 bits so the next operation can't
+    // overflow 64 bits.
+    bool isInRange() const
+    {
+        static const int64_t limit = 0x7fffffff;
+        if (constant > limit || constant < -limit)
+            return false;
+        for (std::vector<int64_t>::const_iterator i=coefs.begin(),
+             end=coefs.end(); i != end; ++i)
+        {
+            if (*i > limit || *i < -limit)
+                return false;
+        }
+        return true;
+    }
+
+    int64_t constant;
+    std::vector<int64_t> coefs;
+};
+} // anonymous namespace
+
+bool
+yasm::Linearize(const Expr& e,
+                unsigned int nsubst,
+                long* constant,
+                std::vector<long>* coefs)
+{
+    if (e.isEmpty())
+        return false;
+
+    const ExprTerms& terms = e.getTerms();
+    std::vector<LinearTerm> stack;
+
+    for (ExprTerms::const_iterator i=terms.begin(), end=terms.end();
+         i != end; ++i)
+    {
+        const ExprTerm& term = *i;
+        if (term.isOp())
+        {
+            size_t nchild = term.getNumChild();
+            assert(stack.size() >= nchild && "not enough terms to evaluate op");
+            size_t resultindex = stack.size()-nchild;
+            LinearTerm& result = stack[resultindex];
+
+            switch (term.getOp())
+            {
+                case Op::IDENT:
+                    break;
+                case Op::ADD:
+                    for (size_t j = resultindex+1; j<stack.size(); ++j)
+                    {
+                        result.Add(stack[j], 1);
+                        if (!result.isInRange())
+                            return false;
+                    }
+                    break;
+                case Op::SUB:
+                    for (size_t j = resultindex+1; j<stack.size(); ++j)
+                    {
+                        result.Add(stack[j], -1);
+                        if (!result.isInRange())
+                            return false;
+                    }
+                    break;
+                case Op::NEG:
+                    result.Scale(-1);
+                    break;
+                case Op::MUL:
+                    for (size_t j = resultindex+1; j<stack.size(); ++j)
+                    {
+                        LinearTerm& child = stack[j];
+                        if (child.isConstant())
+                            result.Scale(child.constant);
+                        else if (result.isConstant())
+                        {
+                            child.Scale(result.constant);
+                            std::swap(result.constant, child.constant);
+                            result.coefs.swap(child.coefs);
+                        }
+                        else
+                            return false;   // quadratic
+                        if (!result.isInRange())
+                            return false;
+                    }
+                    break;
+                default:
+                    return false;
+            }
+            stack.erase(stack.begin()+resultindex+1, stack.end());
+        }
+        else if (!term.isEmpty())
+        {
+            switch (term.getType())
+            {
+                case ExprTerm::SUBST:
+                {
+                    unsigned int substindex = *term.getSubst();
+                    if (substindex >= nsubst)
+                        return false;
+                    stack.push_back(LinearTerm(0, nsubst));
+                    stack.back().coefs[substindex] = 1;
+                    break;
+                }
+                case ExprTerm::INT:
+                {
+                    const IntNum* intn = term.getIntNum();
+                    if (!intn->isInRange(-0x7fffffffL, 0x7fffffffL))
+                        return false;
+                    stack.push_back(LinearTerm(intn->getInt(), nsubst));
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+    }
+
+    assert(stack.size() == 1 && "did not fully evaluate expression");
+    *constant = static_cast<long>(stack.back().constant);
+    coefs->assign(stack.back().coefs.begin(), stack.back().coefs.end());
+    return true;
+}
@@ -29,10 +29,13 @@
 #include "yasmx/Object.h"
 
 #include <algorithm>
+#include <cstdlib>
+#include <ctime>
 #include <memory>
 
 #include <boost/pool/pool.hpp>
 
+#include "config.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/Twine.h"
@@ -40,8 +43,10 @@
 #include "yasmx/Config/functional.h"
 #include "yasmx/Arch.h"
 #include "yasmx/Bytecode.h"
+#include "yasmx/CodeProfile.h"
 #include "yasmx/Optimizer.h"
 #include "yasmx/Section.h"
+#include "yasmx/SpillFile.h"
 #include "yasmx/Symbol.h"
 
 #include "hamt.h"
@@ -110,6 +115,8 @@ Object::Object(llvm::StringRef src_filename,
                llvm::StringRef obj_filename,
                Arch* arch)
     : m_src_filename(src_filename),
+      m_obj_filename(obj_filename),
+      m_finalized(false),
       m_arch(arch),
       m_cur_section(0),
       m_sections_owner(m_sections),
@@ -117,8 +124,14 @@ Object::Object(llvm::StringRef src_filename,
       m_impl(new Impl(false))
 {
     m_options.DisableGlobalSubRelative = false;
+    m_options.AddressSize = 0;
     m_config.ExecStack = false;
     m_config.NoExecStack = false;
+    m_config.CodeProperties = false;
+    m_config.SpillThreshold = 0;
+    m_config.Deterministic = false;
+    m_config.FunctionSizes = false;
+    m_config.KeepPCRelRelocs = false;
 }
 
 void
@@ -133,6 +146,89 @@ Object::setObjectFilename(llvm::StringRef obj_filename)
     m_obj_filename = obj_filename;
 }
 
+void
+Object::AddDependency(llvm::StringRef filename)
+{
+    if (std::find(m_dependencies.begin(), m_dependencies.end(), filename)
+        != m_dependencies.end())
+        return;
+    m_dependencies.push_back(filename);
+}
+
+SpillFile&
+Object::getSpillFile()
+{
+    if (!m_spill)
+        m_spill.reset(new SpillFile);
+    return *m_spill;
+}
+
+void
+Object::setProfile(std::auto_ptr<CodeProfile> profile)
+{
+    m_profile.reset(profile.release());
+}
+
+void
+Object::AddPathMap(llvm::StringRef from, llvm::StringRef to)
+{
+    m_path_map.push_back(std::make_pair(from.str(), to.str()));
+}
+
+std::string
+Object::RemapPath(llvm::StringRef path) const
+{
+    for (std::vector<std::pair<std::string, std::string> >::const_reverse_iterator
+         i=m_path_map.rbegin(), end=m_path_map.rend(); i != end; ++i)
+    {
+        if (path.startswith(i->first))
+            return i->second + path.substr(i->first.size()).str();
+    }
+    return path;
+}
+
+// Get SOURCE_DATE_EPOCH, if set to a valid value.
+static bool
+getSourceDateEpoch(unsigned long long* epoch)
+{
+    const char* env = std::getenv("SOURCE_DATE_EPOCH");
+    return env && !llvm::StringRef(env).getAsInteger(10, *epoch);
+}
+
+bool
+Object::hasFixedTimestamp() const
+{
+    unsigned long long epoch;
+    return m_config.Deterministic || std::getenv("YASM_TEST_SUITE") ||
+        getSourceDateEpoch(&epoch);
+}
+
+llvm::StringRef
+Object::getVersion() const
+{
+    if (std::getenv("YASM_TEST_SUITE"))
+        return "1.0.0";
+    return PACKAGE_VERSION;
+}
+
+unsigned long
+Object::getTimestamp() const
+{
+    unsigned long long epoch;
+    if (getSourceDateEpoch(&epoch))
+        return static_cast<unsigned long>(epoch);
+    if (m_config.Deterministic || std::getenv("YASM_TEST_SUITE"))
+        return 0;
+    return static_cast<unsigned long>(std::time(NULL));
+}
+
+void
+Object::EnableInsnLines()
+{
+    if (!m_insn_lines)
+        m_insn_lines.reset(new InsnLines);
+}
+
 Object::~Object()
 {
 }
@@ -140,6 +236,7 @@ Object::~Object()
 void
 Object::Finalize(Diagnostic& diags)
 {
+    m_finalized = true;
     std::for_each(m_sections.begin(), m_sections.end(),
                   TR1::bind(&Section::Finalize, _1, TR1::ref(diags)));
 }
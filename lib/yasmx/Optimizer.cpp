@@ -31,6 +31,7 @@
 #include <algorithm>
 #include <deque>
 #include <list>
+#include <map>
 #include <memory>
 #include <vector>
 
@@ -54,12 +55,15 @@
 
 STATISTIC(num_span_terms, "Number of span terms created");
 STATISTIC(num_spans, "Number of spans created");
+STATISTIC(num_linear, "Number of spans evaluated in linear form");
 STATISTIC(num_step1d, "Number of spans after step 1b");
 STATISTIC(num_itree, "Number of span terms added to interval tree");
+STATISTIC(num_bucketed, "Number of span terms added to bucket index");
 STATISTIC(num_offset_setters, "Number of offset setters");
 STATISTIC(num_recalc, "Number of span recalculations performed");
 STATISTIC(num_expansions, "Number of expansions performed");
 STATISTIC(num_initial_qb, "Number of spans on initial QB");
+STATISTIC(num_components, "Number of independent span components");
 
 using namespace yasm;
 
@@ -238,6 +242,7 @@ public:
 
     bool CreateTerms(Optimizer::Impl* optimize, Diagnostic& diags);
     bool RecalcNormal(Diagnostic& diags);
+    bool EvalLinear(long* val) const;
 
     std::string getName() const;
 #ifdef WITH_XML
@@ -260,6 +265,13 @@ private:
     Terms m_span_terms;
     ExprTerms m_expr_terms;
 
+    // Linear form of the absolute portion: m_lin_const plus the sum of
+    // m_lin_coefs[subst] times each term's value.  Used instead of
+    // m_expr_terms when m_linear is set.
+    bool m_linear;
+    long m_lin_const;
+    std::vector<long> m_lin_coefs;
+
     long m_cur_val;
     long m_new_val;
 
@@ -296,10 +308,22 @@ public:
     pugi::xml_node Write(pugi::xml_node out) const;
 #endif // WITH_XML
 
-    void ITreeAdd(Span& span, Span::Term& term);
-    void CheckCycle(IntervalTreeNode<Span::Term*> * node,
-                    Span& span);
-    void ExpandTerm(IntervalTreeNode<Span::Term*> * node, long len_diff);
+    struct Component;
+
+    static bool getTermRange(const Span::Term& term, long* low, long* high);
+    void Partition();
+    void BuildTermIndex(Component& comp);
+    void CheckCycles(Component& comp, Span& span);
+    void CheckCycle(Span::Term& term, Span& span);
+    void ITreeCheckCycle(IntervalTreeNode<Span::Term*> * node, Span& span)
+    { CheckCycle(*node->getData(), span); }
+    void ExpandTerms(Component& comp, long index, long len_diff);
+    void ExpandTerm(Component& comp, Span::Term& term, long len_diff);
+    void ITreeExpandTerm(Component* comp,
+                         IntervalTreeNode<Span::Term*> * node,
+                         long len_diff)
+    { ExpandTerm(*comp, *node->getData(), len_diff); }
+    void Solve(Component& comp);
 
     Diagnostic& m_diags;
 
@@ -307,9 +331,49 @@ public:
     Spans m_spans;      // ownership list
 
     typedef std::deque<Span*> SpanQueue;
-    SpanQueue m_QA, m_QB;
+    SpanQueue m_QB;     // spans exceeding thresholds in step 1d
+
+    // Span terms indexed by the range of bytecode indices they depend on.
+    // Most terms (e.g. short jumps) only cover a few bytecodes; these are
+    // kept in flat arrays of buckets of BUCKET_SIZE consecutive bytecode
+    // indices, stored contiguously with bucket_start[i] giving the start
+    // of bucket i.  Terms covering more than MAX_TERM_BUCKETS buckets go
+    // into the interval tree instead.
+    enum
+    {
+        BUCKET_SHIFT = 4,
+        BUCKET_SIZE = 1<<BUCKET_SHIFT,
+        MAX_TERM_BUCKETS = 4
+    };
+    struct TermRange
+    {
+        long low, high;
+        Span::Term* term;
+    };
+
+    // Spans that only depend on each other's bytecodes.  A span depends
+    // on the sections of its distance terms as well as its own section,
+    // so a component is the spans of a group of sections linked by such
+    // references; usually just one section.  Each component is solved
+    // with its own queues and term index, so a section with many
+    // expansions or long-range terms doesn't slow down the others.
+    struct Component
+    {
+        Component() : itree_size(0) {}
+
+        std::vector<Span*> spans;
+        SpanQueue QA, QB;
+        std::vector<size_t> bucket_start;
+        std::vector<TermRange> bucket_terms;
+        IntervalTree<Span::Term*> itree;
+        unsigned long itree_size;
+
+    private:
+        Component(const Component&);                    // not implemented
+        const Component& operator=(const Component&);   // not implemented
+    };
+    std::vector<Component*> m_components;   // owned
 
-    IntervalTree<Span::Term*> m_itree;
     std::vector<OffsetSetter> m_offset_setters;
 };
 } // namespace yasm
@@ -359,6 +423,8 @@ Span::Span(Bytecode& bc,
            size_t os_index)
     : m_bc(bc),
       m_depval(value),
+      m_linear(false),
+      m_lin_const(0),
       m_cur_val(0),
       m_new_val(0),
       m_neg_thres(neg_thres),
@@ -423,10 +489,42 @@ Span::CreateTerms(Optimizer::Impl* optimize, Diagnostic& diags)
                 }
             }
         }
+
+        // Most spans are a constant plus or minus a few distances; skip
+        // the general evaluator for those when recalculating.
+        if (!m_depval.isRelative() &&
+            Linearize(*m_depval.getAbs(), m_span_terms.size(), &m_lin_const,
+                      &m_lin_coefs))
+        {
+            m_linear = true;
+            ++num_linear;
+        }
     }
     return true;
 }
 
+// Evaluate the linear form with the current term values.  Returns false
+// if a value is too large to be sure of no overflow; the general evaluator
+// must be used instead.
+bool
+Span::EvalLinear(long* val) const
+{
+    static const int64_t limit = 0x7fffffff;
+    int64_t sum = m_lin_const;
+    for (Terms::const_iterator i=m_span_terms.begin(),
+         end=m_span_terms.end(); i != end; ++i)
+    {
+        if (i->m_new_val > limit || i->m_new_val < -limit ||
+            sum > limit*limit || sum < -limit*limit)
+            return false;
+        sum += static_cast<int64_t>(m_lin_coefs[i->m_subst]) * i->m_new_val;
+    }
+    if (sum >= LONG_MAX || sum < LONG_MIN)
+        return false;
+    *val = static_cast<long>(sum);
+    return true;
+}
+
 // Recalculate span value based on current span replacement values.
 // Returns True if span needs expansion (e.g. exceeded thresholds).
 bool
@@ -437,7 +535,7 @@ Span::RecalcNormal(Diagnostic& diags)
 
     if (m_depval.isRelative())
         m_new_val = LONG_MAX;       // too complex; force to longest form
-    else if (m_depval.hasAbs())
+    else if (m_depval.hasAbs() && !(m_linear && EvalLinear(&m_new_val)))
     {
         ExprTerm result;
 
@@ -548,6 +646,9 @@ Optimizer::Impl::~Impl()
         delete m_spans.back();
         m_spans.pop_back();
     }
+    for (std::vector<Component*>::iterator i=m_components.begin(),
+         end=m_components.end(); i != end; ++i)
+        delete *i;
 }
 
 #ifdef WITH_XML
@@ -562,17 +663,30 @@ Optimizer::Impl::Write(pugi::xml_node out) const
          i != end; ++i)
         append_data(spans, **i);
 
-    // queue A
-    pugi::xml_node qa = root.append_child("QueueA");
-    for (SpanQueue::const_iterator j=m_QA.begin(), end=m_QA.end();
-         j != end; ++j)
-        (*j)->WriteRef(qa);
-
-    // queue B
+    // initial queue B
     pugi::xml_node qb = root.append_child("QueueB");
     for (SpanQueue::const_iterator k=m_QB.begin(), end=m_QB.end();
          k != end; ++k)
-        (*k)->WriteRef(qa);
+        (*k)->WriteRef(qb);
+
+    // components and their queues
+    for (std::vector<Component*>::const_iterator c=m_components.begin(),
+         end=m_components.end(); c != end; ++c)
+    {
+        pugi::xml_node comp = root.append_child("Component");
+        pugi::xml_node cspans = comp.append_child("Spans");
+        for (std::vector<Span*>::const_iterator i=(*c)->spans.begin(),
+             iend=(*c)->spans.end(); i != iend; ++i)
+            (*i)->WriteRef(cspans);
+        pugi::xml_node cqa = comp.append_child("QueueA");
+        for (SpanQueue::const_iterator j=(*c)->QA.begin(),
+             jend=(*c)->QA.end(); j != jend; ++j)
+            (*j)->WriteRef(cqa);
+        pugi::xml_node cqb = comp.append_child("QueueB");
+        for (SpanQueue::const_iterator k=(*c)->QB.begin(),
+             kend=(*c)->QB.end(); k != kend; ++k)
+            (*k)->WriteRef(cqb);
+    }
 
     // offset setters
     pugi::xml_node osetters = root.append_child("OffsetSetters");
@@ -596,45 +710,202 @@ Optimizer::AddOffsetSetter(Bytecode& bc)
     m_impl->m_offset_setters.push_back(OffsetSetter());
 }
 
-void
-Optimizer::Impl::ITreeAdd(Span& span, Span::Term& term)
+// Get the range of bytecode indices a span term depends on.
+// Returns false if the term is always 0 (both ends in the same bytecode).
+bool
+Optimizer::Impl::getTermRange(const Span::Term& term, long* low, long* high)
 {
     long precbc_index, precbc2_index;
-    unsigned long low, high;
 
-    // Update term length
     if (term.m_loc.bc)
         precbc_index = term.m_loc.bc->getIndex();
     else
-        precbc_index = span.m_bc.getIndex()-1;
+        precbc_index = term.m_span->m_bc.getIndex()-1;
 
     if (term.m_loc2.bc)
         precbc2_index = term.m_loc2.bc->getIndex();
     else
-        precbc2_index = span.m_bc.getIndex()-1;
+        precbc2_index = term.m_span->m_bc.getIndex()-1;
 
     if (precbc_index < precbc2_index)
     {
-        low = precbc_index;
-        high = precbc2_index-1;
+        *low = precbc_index;
+        *high = precbc2_index-1;
     }
     else if (precbc_index > precbc2_index)
     {
-        low = precbc2_index;
-        high = precbc_index-1;
+        *low = precbc2_index;
+        *high = precbc_index-1;
     }
     else
-        return;     // difference is same bc - always 0!
+        return false;   // difference is same bc - always 0!
+    return true;
+}
 
-    m_itree.Insert(static_cast<long>(low), static_cast<long>(high), &term);
-    ++num_itree;
+// Find the representative of a set in a union-find forest.
+static size_t
+FindRoot(std::vector<size_t>& parent, size_t i)
+{
+    while (parent[i] != i)
+    {
+        parent[i] = parent[parent[i]];  // path halving
+        i = parent[i];
+    }
+    return i;
+}
+
+// Get the union-find set index of a container, adding a new set if needed.
+static size_t
+getSetIndex(std::map<const BytecodeContainer*, size_t>& sets,
+            std::vector<size_t>& parent,
+            const BytecodeContainer* container)
+{
+    std::map<const BytecodeContainer*, size_t>::iterator i =
+        sets.lower_bound(container);
+    if (i != sets.end() && i->first == container)
+        return i->second;
+    size_t index = parent.size();
+    parent.push_back(index);
+    sets.insert(i, std::make_pair(container, index));
+    return index;
+}
+
+void
+Optimizer::Impl::Partition()
+{
+    // Union the section of each span with the sections of its terms.
+    std::map<const BytecodeContainer*, size_t> sets;
+    std::vector<size_t> parent;
+    for (Spans::iterator spani=m_spans.begin(), endspan=m_spans.end();
+         spani != endspan; ++spani)
+    {
+        Span* span = *spani;
+        size_t set = getSetIndex(sets, parent, span->m_bc.getContainer());
+        for (Span::Terms::iterator term=span->m_span_terms.begin(),
+             endterm=span->m_span_terms.end(); term != endterm; ++term)
+        {
+            // A missing location is the span's own bytecode.
+            const Bytecode* bcs[2] = {term->m_loc.bc, term->m_loc2.bc};
+            for (int i=0; i<2; ++i)
+            {
+                if (!bcs[i])
+                    continue;
+                size_t termset =
+                    getSetIndex(sets, parent, bcs[i]->getContainer());
+                parent[FindRoot(parent, termset)] = FindRoot(parent, set);
+            }
+        }
+    }
+
+    // Create components in order of their first span, so spans are
+    // processed in the same relative order as before partitioning.
+    std::vector<Component*> roots(parent.size(), 0);
+    std::map<const Span*, Component*> span_comp;
+    for (Spans::iterator spani=m_spans.begin(), endspan=m_spans.end();
+         spani != endspan; ++spani)
+    {
+        Span* span = *spani;
+        size_t root = FindRoot(parent,
+            getSetIndex(sets, parent, span->m_bc.getContainer()));
+        Component*& comp = roots[root];
+        if (!comp)
+        {
+            comp = new Component;
+            m_components.push_back(comp);
+        }
+        comp->spans.push_back(span);
+        span_comp[span] = comp;
+    }
+
+    // Distribute the spans queued by step 1d.
+    for (SpanQueue::iterator i=m_QB.begin(), end=m_QB.end(); i != end; ++i)
+        span_comp[*i]->QB.push_back(*i);
+    m_QB.clear();
+    num_components += m_components.size();
 }
 
 void
-Optimizer::Impl::CheckCycle(IntervalTreeNode<Span::Term*> * node, Span& span)
+Optimizer::Impl::BuildTermIndex(Component& comp)
 {
-    Span::Term* term = node->getData();
-    Span* depspan = term->m_span;
+    std::vector<TermRange> ranges;
+    long max_bucket = -1;
+
+    for (std::vector<Span*>::iterator spani=comp.spans.begin(),
+         endspan=comp.spans.end(); spani != endspan; ++spani)
+    {
+        Span* span = *spani;
+        for (Span::Terms::iterator term=span->m_span_terms.begin(),
+             endterm=span->m_span_terms.end(); term != endterm; ++term)
+        {
+            TermRange range;
+            if (!getTermRange(*term, &range.low, &range.high))
+                continue;
+            range.term = &(*term);
+
+            if (range.low < 0 ||
+                (range.high>>BUCKET_SHIFT) - (range.low>>BUCKET_SHIFT)
+                >= MAX_TERM_BUCKETS)
+            {
+                comp.itree.Insert(range.low, range.high, range.term);
+                ++comp.itree_size;
+                ++num_itree;
+                continue;
+            }
+
+            ranges.push_back(range);
+            max_bucket = std::max(max_bucket, range.high>>BUCKET_SHIFT);
+        }
+    }
+
+    // Count terms per bucket, then place them.
+    comp.bucket_start.assign(max_bucket+2, 0);
+    for (std::vector<TermRange>::const_iterator i=ranges.begin(),
+         end=ranges.end(); i != end; ++i)
+    {
+        for (long b=i->low>>BUCKET_SHIFT; b<=(i->high>>BUCKET_SHIFT); ++b)
+            ++comp.bucket_start[b+1];
+    }
+    for (size_t b=1; b<comp.bucket_start.size(); ++b)
+        comp.bucket_start[b] += comp.bucket_start[b-1];
+
+    comp.bucket_terms.resize(comp.bucket_start.back());
+    std::vector<size_t> fill(comp.bucket_start.begin(),
+                             comp.bucket_start.end());
+    for (std::vector<TermRange>::const_iterator i=ranges.begin(),
+         end=ranges.end(); i != end; ++i)
+    {
+        for (long b=i->low>>BUCKET_SHIFT; b<=(i->high>>BUCKET_SHIFT); ++b)
+            comp.bucket_terms[fill[b]++] = *i;
+        ++num_bucketed;
+    }
+}
+
+void
+Optimizer::Impl::CheckCycles(Component& comp, Span& span)
+{
+    long index = static_cast<long>(span.m_bc.getIndex());
+    size_t bucket = static_cast<size_t>(index>>BUCKET_SHIFT);
+    if (bucket+1 < comp.bucket_start.size())
+    {
+        for (size_t i=comp.bucket_start[bucket],
+             end=comp.bucket_start[bucket+1]; i != end; ++i)
+        {
+            const TermRange& range = comp.bucket_terms[i];
+            if (range.low <= index && index <= range.high)
+                CheckCycle(*range.term, span);
+        }
+    }
+
+    if (comp.itree_size != 0)
+        comp.itree.Enumerate(index, index,
+                          TR1::bind(&Optimizer::Impl::ITreeCheckCycle, this,
+                                    _1, TR1::ref(span)));
+}
+
+void
+Optimizer::Impl::CheckCycle(Span::Term& term, Span& span)
+{
+    Span* depspan = term.m_span;
 
     // Only check for cycles in id=0 spans
     if (depspan->m_id > 0)
@@ -657,10 +928,30 @@ Optimizer::Impl::CheckCycle(IntervalTreeNode<Span::Term*> * node, Span& span)
 }
 
 void
-Optimizer::Impl::ExpandTerm(IntervalTreeNode<Span::Term*> * node, long len_diff)
+Optimizer::Impl::ExpandTerms(Component& comp, long index, long len_diff)
+{
+    size_t bucket = static_cast<size_t>(index>>BUCKET_SHIFT);
+    if (bucket+1 < comp.bucket_start.size())
+    {
+        for (size_t i=comp.bucket_start[bucket],
+             end=comp.bucket_start[bucket+1]; i != end; ++i)
+        {
+            const TermRange& range = comp.bucket_terms[i];
+            if (range.low <= index && index <= range.high)
+                ExpandTerm(comp, *range.term, len_diff);
+        }
+    }
+
+    if (comp.itree_size != 0)
+        comp.itree.Enumerate(index, index,
+                             TR1::bind(&Optimizer::Impl::ITreeExpandTerm,
+                                       this, &comp, _1, len_diff));
+}
+
+void
+Optimizer::Impl::ExpandTerm(Component& comp, Span::Term& term, long len_diff)
 {
-    Span::Term* term = node->getData();
-    Span* span = term->m_span;
+    Span* span = term.m_span;
     long precbc_index, precbc2_index;
 
     // Don't expand inactive spans
@@ -671,23 +962,23 @@ Optimizer::Impl::ExpandTerm(IntervalTreeNode<Span::Term*> * node, long len_diff)
           << '\n');
 
     // Update term length
-    if (term->m_loc.bc)
-        precbc_index = term->m_loc.bc->getIndex();
+    if (term.m_loc.bc)
+        precbc_index = term.m_loc.bc->getIndex();
     else
         precbc_index = span->m_bc.getIndex()-1;
 
-    if (term->m_loc2.bc)
-        precbc2_index = term->m_loc2.bc->getIndex();
+    if (term.m_loc2.bc)
+        precbc2_index = term.m_loc2.bc->getIndex();
     else
         precbc2_index = span->m_bc.getIndex()-1;
 
     if (precbc_index < precbc2_index)
-        term->m_new_val += len_diff;
+        term.m_new_val += len_diff;
     else
-        term->m_new_val -= len_diff;
+        term.m_new_val -= len_diff;
     DEBUG(llvm::errs() << "updated " << span->getName() << " term "
-          << (term-&span->m_span_terms.front())
-          << " newval to " << term->m_new_val << '\n');
+          << (&term-&span->m_span_terms.front())
+          << " newval to " << term.m_new_val << '\n');
 
     // If already on Q, don't re-add
     if (span->m_active == Span::ON_Q)
@@ -707,9 +998,9 @@ Optimizer::Impl::ExpandTerm(IntervalTreeNode<Span::Term*> * node, long len_diff)
     // Exceeded thresholds, need to add to Q for expansion
     DEBUG(llvm::errs() << span->getName() << " added back on queue\n");
     if (span->m_id <= 0)
-        m_QA.push_back(span);
+        comp.QA.push_back(span);
     else
-        m_QB.push_back(span);
+        comp.QB.push_back(span);
     span->m_active = Span::ON_Q;    // Mark as being in Q
 }
 
@@ -803,27 +1094,23 @@ Optimizer::Impl::Step1e()
         ++num_offset_setters;
     }
 
-    // Build up interval tree
-    for (Spans::iterator spani=m_spans.begin(), endspan=m_spans.end();
-         spani != endspan; ++spani)
-    {
-        Span* span = *spani;
-        for (Span::Terms::iterator term=span->m_span_terms.begin(),
-             endterm=span->m_span_terms.end(); term != endterm; ++term)
-            ITreeAdd(*span, *term);
-    }
+    Partition();
 
-    // Look for cycles in times expansion (span.id==0)
-    for (Spans::iterator spani=m_spans.begin(), endspan=m_spans.end();
-         spani != endspan; ++spani)
+    for (std::vector<Component*>::iterator comp=m_components.begin(),
+         endcomp=m_components.end(); comp != endcomp; ++comp)
     {
-        Span* span = *spani;
-        if (span->m_id > 0)
-            continue;
-        m_itree.Enumerate(static_cast<long>(span->m_bc.getIndex()),
-                          static_cast<long>(span->m_bc.getIndex()),
-                          TR1::bind(&Optimizer::Impl::CheckCycle, this, _1,
-                                    TR1::ref(*span)));
+        // Build up span term index
+        BuildTermIndex(**comp);
+
+        // Look for cycles in times expansion (span.id==0)
+        for (std::vector<Span*>::iterator spani=(*comp)->spans.begin(),
+             endspan=(*comp)->spans.end(); spani != endspan; ++spani)
+        {
+            Span* span = *spani;
+            if (span->m_id > 0)
+                continue;
+            CheckCycles(**comp, *span);
+        }
     }
 }
 
@@ -832,22 +1119,30 @@ Optimizer::Impl::Step2()
 {
     DEBUG(Dump());
 
-    while (!m_QA.empty() || !m_QB.empty())
+    for (std::vector<Component*>::iterator comp=m_components.begin(),
+         endcomp=m_components.end(); comp != endcomp; ++comp)
+        Solve(**comp);
+}
+
+void
+Optimizer::Impl::Solve(Component& comp)
+{
+    while (!comp.QA.empty() || !comp.QB.empty())
     {
         Span* span;
 
         // QA is for TIMES, update those first, then update non-TIMES.
         // This is so that TIMES can absorb increases before we look at
         // expanding non-TIMES BCs.
-        if (!m_QA.empty())
+        if (!comp.QA.empty())
         {
-            span = m_QA.front();
-            m_QA.pop_front();
+            span = comp.QA.front();
+            comp.QA.pop_front();
         }
         else
         {
-            span = m_QB.front();
-            m_QB.pop_front();
+            span = comp.QB.front();
+            comp.QB.pop_front();
         }
 
         if (span->m_active == Span::INACTIVE)
@@ -894,10 +1189,7 @@ Optimizer::Impl::Step2()
               << span->m_bc.getIndex() << ") expansion by "
               << len_diff << ":\n");
         // Iterate over all spans dependent across the bc just expanded
-        m_itree.Enumerate(static_cast<long>(span->m_bc.getIndex()),
-                          static_cast<long>(span->m_bc.getIndex()),
-                          TR1::bind(&Optimizer::Impl::ExpandTerm, this, _1,
-                                    len_diff));
+        ExpandTerms(comp, static_cast<long>(span->m_bc.getIndex()), len_diff);
 
         // Iterate over offset-setters that follow the bc just expanded.
         // Stop iteration if:
@@ -936,10 +1228,8 @@ Optimizer::Impl::Step2()
                 DEBUG(llvm::errs() << "BC@" << os->m_bc << " ("
                       << os->m_bc->getIndex() << ") offset setter change by "
                       << len_diff << ":\n");
-                m_itree.Enumerate(static_cast<long>(os->m_bc->getIndex()),
-                                  static_cast<long>(os->m_bc->getIndex()),
-                                  TR1::bind(&Optimizer::Impl::ExpandTerm, this,
-                                            _1, len_diff));
+                ExpandTerms(comp, static_cast<long>(os->m_bc->getIndex()),
+                            len_diff);
             }
 
             os->m_cur_val = os->m_new_val;
@@ -0,0 +1,98 @@
+//
+// Spill file implementation.
+//
+//  Copyright (C) 2011  PathScale Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "yasmx/SpillFile.h"
+
+#include "yasmx/Bytes.h"
+
+
+using namespace yasm;
+
+// Seek with a 64-bit offset; fseek() takes a long, which is only 32 bits
+// on Win64.
+static int
+Seek(std::FILE* f, uint64_t offset)
+{
+#if defined(_WIN32)
+    return _fseeki64(f, static_cast<__int64>(offset), SEEK_SET);
+#else
+    return fseeko(f, static_cast<off_t>(offset), SEEK_SET);
+#endif
+}
+
+SpillFile::SpillFile()
+    : m_file(0),
+      m_size(0)
+{
+}
+
+SpillFile::~SpillFile()
+{
+    if (m_file)
+        std::fclose(m_file);
+}
+
+bool
+SpillFile::Write(const Bytes& bytes, uint64_t* offset)
+{
+    if (!m_file)
+    {
+        m_file = std::tmpfile();
+        if (!m_file)
+            return false;
+    }
+
+    // Reads may have moved the file position; always append at the end.
+    if (Seek(m_file, m_size) != 0)
+        return false;
+    if (!bytes.empty() &&
+        std::fwrite(&bytes[0], 1, bytes.size(), m_file) != bytes.size())
+        return false;
+
+    *offset = m_size;
+    m_size += bytes.size();
+    return true;
+}
+
+bool
+SpillFile::Read(uint64_t offset, unsigned long size, Bytes& bytes)
+{
+    if (!m_file || offset+size > m_size)
+        return false;
+    if (size == 0)
+        return true;
+    if (Seek(m_file, offset) != 0)
+        return false;
+
+    Bytes::size_type start = bytes.size();
+    bytes.resize(start + size);
+    if (std::fread(&bytes[start], 1, size, m_file) != size)
+    {
+        bytes.resize(start);
+        return false;
+    }
+    return true;
+}
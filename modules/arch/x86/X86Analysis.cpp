@@ -0,0 +1,1586 @@
+//
+// x86 static performance analysis
+//
+//  Copyright (C) 2011  PathScale Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "X86Analysis.h"
+
+#include <algorithm>
+
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Basic/SourceManager.h"
+#include "yasmx/Bytecode.h"
+#include "yasmx/EffAddr.h"
+#include "yasmx/Expr.h"
+#include "yasmx/Insn.h"
+#include "yasmx/Object.h"
+#include "yasmx/Symbol.h"
+
+#include "X86Opcode.h"
+#include "X86Register.h"
+
+
+using namespace yasm;
+using namespace yasm::arch;
+
+namespace {
+// How an instruction uses its destination (first Intel-order) operand.
+enum DestUse
+{
+    DEST_WRITE = 0,     // only written
+    DEST_RMW,           // read and written
+    DEST_READ           // only read (compare, push, branch)
+};
+
+// Implicit dependencies of an instruction.
+enum ImplicitDeps
+{
+    RD_FLAGS = 1<<0,    // reads arithmetic flags
+    WR_FLAGS = 1<<1,    // writes arithmetic flags
+    IDIOM = 1<<2,       // independent of its inputs if all sources match
+    ACC = 1<<3,         // reads and writes rAX and rDX
+    STACK = 1<<4        // reads and writes rSP
+};
+
+// Which operands are memory.
+enum MemOperand
+{
+    MEM_SRC = 1<<0,
+    MEM_DEST = 1<<1
+};
+} // anonymous namespace
+
+namespace yasm { namespace arch {
+// Execution resources of one scheduling class on a model.
+struct X86SchedEntry
+{
+    unsigned char latency;      // cycles until results are available
+    unsigned char uops;         // fused-domain micro-ops dispatched
+    unsigned char pressure;     // execution port cycles consumed
+    unsigned short ports;       // mask of ports that can execute it
+};
+
+// A microarchitecture port/latency model.
+struct X86Model
+{
+    const char* name;
+    unsigned int width;             // micro-ops dispatched per cycle
+    unsigned int nports;
+    const char* const* port_names;
+    unsigned short load_ports;      // ports executing loads
+    unsigned short store_ports;     // ports computing store addresses
+    unsigned short store_data;      // ports writing store data
+    unsigned int load_latency;      // additional latency of a load
+    bool split256;                  // 256-bit vector ops take two uops
+    X86SchedEntry sched[X86_SCHED_COUNT];
+};
+}} // namespace yasm::arch
+
+#define P(n)    (1U<<(n))
+
+static const char* const intel_ports[] =
+{
+    "p0", "p1", "p2", "p3", "p4", "p5", "p6", "p7"
+};
+
+// Intel Haswell.
+static const X86Model haswell =
+{
+    "haswell", 4, 8, intel_ports,
+    P(2)|P(3), P(2)|P(3)|P(7), P(4), 5, false,
+    {
+        { 0, 1, 0, 0 },                         // NOP
+        { 1, 1, 1, P(0)|P(1)|P(5)|P(6) },       // ALU
+        { 1, 1, 1, P(0)|P(6) },                 // SHIFT
+        { 1, 1, 1, P(0)|P(1)|P(5)|P(6) },       // MOV
+        { 1, 1, 1, P(1)|P(5) },                 // LEA
+        { 3, 1, 1, P(1) },                      // IMUL
+        { 4, 2, 2, P(1)|P(5) },                 // MUL
+        { 26, 9, 8, P(0) },                     // DIV
+        { 1, 1, 1, P(6) },                      // BRANCH
+        { 1, 1, 0, 0 },                         // PUSH
+        { 1, 1, 0, 0 },                         // POP
+        { 1, 1, 1, P(0)|P(1)|P(5) },            // VEC_MOV
+        { 1, 1, 1, P(0)|P(1)|P(5) },            // VEC_LOGIC
+        { 1, 1, 1, P(1)|P(5) },                 // VEC_ALU
+        { 1, 1, 1, P(5) },                      // VEC_SHUF
+        { 5, 1, 1, P(0) },                      // VEC_IMUL
+        { 3, 1, 1, P(1) },                      // FP_ADD
+        { 5, 1, 1, P(0)|P(1) },                 // FP_MUL
+        { 5, 1, 1, P(0)|P(1) },                 // FMA
+        { 13, 1, 7, P(0) },                     // FP_DIV
+        { 16, 1, 8, P(0) },                     // FP_SQRT
+        { 4, 2, 2, P(1)|P(5) },                 // CVT
+        { 4, 1, 1, P(0)|P(5) },                 // X87
+        { 4, 4, 4, P(0)|P(1)|P(5)|P(6) }        // MISC
+    }
+};
+
+// Intel Skylake.
+static const X86Model skylake =
+{
+    "skylake", 4, 8, intel_ports,
+    P(2)|P(3), P(2)|P(3)|P(7), P(4), 5, false,
+    {
+        { 0, 1, 0, 0 },                         // NOP
+        { 1, 1, 1, P(0)|P(1)|P(5)|P(6) },       // ALU
+        { 1, 1, 1, P(0)|P(6) },                 // SHIFT
+        { 1, 1, 1, P(0)|P(1)|P(5)|P(6) },       // MOV
+        { 1, 1, 1, P(1)|P(5) },                 // LEA
+        { 3, 1, 1, P(1) },                      // IMUL
+        { 4, 2, 2, P(1)|P(5) },                 // MUL
+        { 26, 10, 6, P(0) },                    // DIV
+        { 1, 1, 1, P(6) },                      // BRANCH
+        { 1, 1, 0, 0 },                         // PUSH
+        { 1, 1, 0, 0 },                         // POP
+        { 1, 1, 1, P(0)|P(1)|P(5) },            // VEC_MOV
+        { 1, 1, 1, P(0)|P(1)|P(5) },            // VEC_LOGIC
+        { 1, 1, 1, P(0)|P(1)|P(5) },            // VEC_ALU
+        { 1, 1, 1, P(5) },                      // VEC_SHUF
+        { 5, 1, 1, P(0)|P(1) },                 // VEC_IMUL
+        { 4, 1, 1, P(0)|P(1) },                 // FP_ADD
+        { 4, 1, 1, P(0)|P(1) },                 // FP_MUL
+        { 4, 1, 1, P(0)|P(1) },                 // FMA
+        { 11, 1, 4, P(0) },                     // FP_DIV
+        { 15, 1, 6, P(0) },                     // FP_SQRT
+        { 5, 2, 2, P(0)|P(1)|P(5) },            // CVT
+        { 4, 1, 1, P(0)|P(5) },                 // X87
+        { 4, 4, 4, P(0)|P(1)|P(5)|P(6) }        // MISC
+    }
+};
+
+static const char* const zen_ports[] =
+{
+    "alu0", "alu1", "alu2", "alu3", "agu0", "agu1",
+    "fp0", "fp1", "fp2", "fp3"
+};
+
+// AMD Zen.  256-bit vector operations execute as two 128-bit halves.
+static const X86Model zen =
+{
+    "zen", 5, 10, zen_ports,
+    P(4)|P(5), P(4)|P(5), 0, 4, true,
+    {
+        { 0, 1, 0, 0 },                         // NOP
+        { 1, 1, 1, P(0)|P(1)|P(2)|P(3) },       // ALU
+        { 1, 1, 1, P(1)|P(2) },                 // SHIFT
+        { 1, 1, 1, P(0)|P(1)|P(2)|P(3) },       // MOV
+        { 1, 1, 1, P(0)|P(1)|P(2)|P(3) },       // LEA
+        { 3, 1, 1, P(1) },                      // IMUL
+        { 3, 2, 2, P(1) },                      // MUL
+        { 25, 2, 20, P(2) },                    // DIV
+        { 1, 1, 1, P(0)|P(3) },                 // BRANCH
+        { 1, 1, 0, 0 },                         // PUSH
+        { 1, 1, 0, 0 },                         // POP
+        { 1, 1, 1, P(6)|P(7)|P(8)|P(9) },       // VEC_MOV
+        { 1, 1, 1, P(6)|P(7)|P(8)|P(9) },       // VEC_LOGIC
+        { 1, 1, 1, P(6)|P(7)|P(9) },            // VEC_ALU
+        { 1, 1, 1, P(7)|P(8) },                 // VEC_SHUF
+        { 4, 1, 1, P(6) },                      // VEC_IMUL
+        { 3, 1, 1, P(8)|P(9) },                 // FP_ADD
+        { 3, 1, 1, P(6)|P(7) },                 // FP_MUL
+        { 5, 1, 1, P(6)|P(7) },                 // FMA
+        { 10, 1, 4, P(9) },                     // FP_DIV
+        { 14, 1, 6, P(9) },                     // FP_SQRT
+        { 4, 1, 1, P(9) },                      // CVT
+        { 5, 1, 1, P(6)|P(7) },                 // X87
+        { 4, 4, 4, P(0)|P(1)|P(2)|P(3) }        // MISC
+    }
+};
+
+#undef P
+
+static const X86Model* const models[] = { &haswell, &skylake, &zen };
+
+static const char* const sched_names[X86_SCHED_COUNT] =
+{
+    "nop", "alu", "shift", "mov", "lea", "imul", "mul", "div", "branch",
+    "push", "pop", "vec-mov", "vec-logic", "vec-alu", "vec-shuf",
+    "vec-imul", "fp-add", "fp-mul", "fma", "fp-div", "fp-sqrt", "cvt",
+    "x87", "misc"
+};
+
+static inline uint64_t
+DepBit(int index)
+{
+    return static_cast<uint64_t>(1) << index;
+}
+
+X86InsnRecord::X86InsnRecord()
+    : reads(0),
+      writes(0),
+      sclass(X86_SCHED_MISC),
+      flags(0),
+      m_src(0),
+      m_dst(0),
+      m_addr(0),
+      m_dest(DEST_RMW),
+      m_deps(0),
+      m_mem(0)
+{
+    loc.bc = 0;
+    loc.off = 0;
+}
+
+int
+X86InsnRecord::getDepIndex(const X86Register& reg)
+{
+    unsigned int num = reg.getNum();
+    switch (reg.getType())
+    {
+        case X86Register::REG8:
+            // ah, ch, dh, bh are the high bytes of the first four registers
+            return X86_DEP_GPR + (num & 3);
+        case X86Register::REG8X:
+        case X86Register::REG16:
+        case X86Register::REG32:
+        case X86Register::REG64:
+            return X86_DEP_GPR + (num & 15);
+        case X86Register::XMMREG:
+        case X86Register::YMMREG:
+            return X86_DEP_VEC + (num & 15);
+        case X86Register::MMXREG:
+            return X86_DEP_MMX + (num & 7);
+        case X86Register::FPUREG:
+            return X86_DEP_FPU;
+        default:
+            return -1;
+    }
+}
+
+void
+X86InsnRecord::setClass(unsigned char sclass_, unsigned char dest,
+                        unsigned char deps)
+{
+    sclass = sclass_;
+    m_dest = dest;
+    m_deps = deps;
+}
+
+void
+X86InsnRecord::ClassifyOneByte(unsigned char op, unsigned char spare)
+{
+    // The eight classic ALU operations: add, or, adc, sbb, and, sub, xor, cmp
+    int alu = -1;
+    if (op < 0x40 && (op & 7) < 6)
+        alu = op >> 3;
+    else if (op >= 0x80 && op <= 0x83)
+        alu = spare;
+
+    if (alu >= 0)
+    {
+        unsigned char deps = WR_FLAGS;
+        if (alu == 2 || alu == 3)
+            deps |= RD_FLAGS;
+        if (alu == 5 || alu == 6)
+            deps |= IDIOM;
+        setClass(X86_SCHED_ALU, alu == 7 ? DEST_READ : DEST_RMW, deps);
+        return;
+    }
+
+    switch (op)
+    {
+        case 0x40: case 0x41: case 0x42: case 0x43:
+        case 0x44: case 0x45: case 0x46: case 0x47:
+        case 0x48: case 0x49: case 0x4A: case 0x4B:
+        case 0x4C: case 0x4D: case 0x4E: case 0x4F:
+            setClass(X86_SCHED_ALU, DEST_RMW, WR_FLAGS);
+            break;
+        case 0x50: case 0x51: case 0x52: case 0x53:
+        case 0x54: case 0x55: case 0x56: case 0x57:
+        case 0x68: case 0x6A:
+            setClass(X86_SCHED_PUSH, DEST_READ, STACK);
+            break;
+        case 0x58: case 0x59: case 0x5A: case 0x5B:
+        case 0x5C: case 0x5D: case 0x5E: case 0x5F:
+        case 0x8F:
+            setClass(X86_SCHED_POP, DEST_WRITE, STACK);
+            break;
+        case 0x69: case 0x6B:
+            setClass(X86_SCHED_IMUL, DEST_WRITE, WR_FLAGS);
+            break;
+        case 0x84: case 0x85: case 0xA8: case 0xA9:
+            setClass(X86_SCHED_ALU, DEST_READ, WR_FLAGS);
+            break;
+        case 0x88: case 0x89: case 0x8A: case 0x8B:
+        case 0xA0: case 0xA1: case 0xA2: case 0xA3:
+        case 0xB0: case 0xB1: case 0xB2: case 0xB3:
+        case 0xB4: case 0xB5: case 0xB6: case 0xB7:
+        case 0xB8: case 0xB9: case 0xBA: case 0xBB:
+        case 0xBC: case 0xBD: case 0xBE: case 0xBF:
+        case 0xC6: case 0xC7:
+            setClass(X86_SCHED_MOV, DEST_WRITE, 0);
+            break;
+        case 0x8D:
+            setClass(X86_SCHED_LEA, DEST_WRITE, 0);
+            break;
+        case 0x90:
+            setClass(X86_SCHED_NOP, DEST_READ, 0);
+            break;
+        case 0x98: case 0x99:
+            setClass(X86_SCHED_ALU, DEST_WRITE, ACC);
+            break;
+        case 0x9C:
+            setClass(X86_SCHED_PUSH, DEST_READ, STACK|RD_FLAGS);
+            break;
+        case 0x9D:
+            setClass(X86_SCHED_POP, DEST_WRITE, STACK|WR_FLAGS);
+            break;
+        case 0xC0: case 0xC1: case 0xD0: case 0xD1: case 0xD2: case 0xD3:
+            if (spare == 2 || spare == 3)
+                setClass(X86_SCHED_MISC, DEST_RMW, RD_FLAGS|WR_FLAGS);
+            else
+                setClass(X86_SCHED_SHIFT, DEST_RMW, WR_FLAGS);
+            break;
+        case 0xC2: case 0xC3:
+            setClass(X86_SCHED_BRANCH, DEST_READ, STACK);
+            flags |= LOAD;
+            break;
+        case 0xD8: case 0xD9: case 0xDA: case 0xDB:
+        case 0xDC: case 0xDD: case 0xDE: case 0xDF:
+            setClass(X86_SCHED_X87, DEST_RMW, 0);
+            break;
+        case 0xE8:
+            setClass(X86_SCHED_BRANCH, DEST_READ, STACK);
+            flags |= STORE;
+            break;
+        case 0xE9: case 0xEB:
+            setClass(X86_SCHED_BRANCH, DEST_READ, 0);
+            break;
+        case 0xF5: case 0xF8: case 0xF9:
+            setClass(X86_SCHED_ALU, DEST_READ, RD_FLAGS|WR_FLAGS);
+            break;
+        case 0xF6: case 0xF7:
+            switch (spare)
+            {
+                case 0: case 1:     // test
+                    setClass(X86_SCHED_ALU, DEST_READ, WR_FLAGS);
+                    break;
+                case 2:             // not
+                    setClass(X86_SCHED_ALU, DEST_RMW, 0);
+                    break;
+                case 3:             // neg
+                    setClass(X86_SCHED_ALU, DEST_RMW, WR_FLAGS);
+                    break;
+                case 4: case 5:     // mul, imul
+                    setClass(X86_SCHED_MUL, DEST_READ, ACC|WR_FLAGS);
+                    break;
+                default:            // div, idiv
+                    setClass(X86_SCHED_DIV, DEST_READ, ACC|WR_FLAGS);
+                    break;
+            }
+            break;
+        case 0xFE: case 0xFF:
+            switch (spare)
+            {
+                case 0: case 1:     // inc, dec
+                    setClass(X86_SCHED_ALU, DEST_RMW, WR_FLAGS);
+                    break;
+                case 2: case 3:     // call
+                    setClass(X86_SCHED_BRANCH, DEST_READ, STACK);
+                    flags |= STORE;
+                    break;
+                case 4: case 5:     // jmp
+                    setClass(X86_SCHED_BRANCH, DEST_READ, 0);
+                    break;
+                default:            // push
+                    setClass(X86_SCHED_PUSH, DEST_READ, STACK);
+                    break;
+            }
+            break;
+        default:
+            setClass(X86_SCHED_MISC, DEST_RMW, 0);
+            break;
+    }
+}
+
+void
+X86InsnRecord::Classify0F(unsigned char op, unsigned char spare, bool scalar)
+{
+    // Scalar SSE operations merge into the destination register.
+    unsigned char merge = scalar ? DEST_RMW : DEST_WRITE;
+
+    switch (op)
+    {
+        case 0x10: case 0x11:
+            setClass(X86_SCHED_VEC_MOV, merge, 0);
+            break;
+        case 0x12: case 0x14: case 0x15: case 0x16:
+            setClass(X86_SCHED_VEC_SHUF, DEST_RMW, 0);
+            break;
+        case 0x13: case 0x17:
+            setClass(X86_SCHED_VEC_SHUF, DEST_WRITE, 0);
+            break;
+        case 0x18: case 0x19: case 0x1A: case 0x1B:
+        case 0x1C: case 0x1D: case 0x1E: case 0x1F:
+            setClass(X86_SCHED_NOP, DEST_READ, 0);
+            break;
+        case 0x28: case 0x29: case 0x2B:
+        case 0x6E: case 0x6F: case 0x7E: case 0x7F:
+        case 0xD6: case 0xE7: case 0xF0:
+            setClass(X86_SCHED_VEC_MOV, DEST_WRITE, 0);
+            break;
+        case 0x2A:
+            setClass(X86_SCHED_CVT, DEST_RMW, 0);
+            break;
+        case 0x2C: case 0x2D: case 0x5B: case 0xE6:
+            setClass(X86_SCHED_CVT, DEST_WRITE, 0);
+            break;
+        case 0x2E: case 0x2F:
+            setClass(X86_SCHED_FP_ADD, DEST_READ, WR_FLAGS);
+            break;
+        case 0x40: case 0x41: case 0x42: case 0x43:
+        case 0x44: case 0x45: case 0x46: case 0x47:
+        case 0x48: case 0x49: case 0x4A: case 0x4B:
+        case 0x4C: case 0x4D: case 0x4E: case 0x4F:
+            setClass(X86_SCHED_SHIFT, DEST_RMW, RD_FLAGS);
+            break;
+        case 0x50: case 0xD7:
+            setClass(X86_SCHED_VEC_ALU, DEST_WRITE, 0);
+            break;
+        case 0x51:
+            setClass(X86_SCHED_FP_SQRT, merge, 0);
+            break;
+        case 0x52: case 0x53:
+            setClass(X86_SCHED_FP_MUL, merge, 0);
+            break;
+        case 0x54: case 0x55: case 0x56:
+        case 0xDB: case 0xDF: case 0xEB:
+            setClass(X86_SCHED_VEC_LOGIC, DEST_RMW, 0);
+            break;
+        case 0x57: case 0xEF:
+            setClass(X86_SCHED_VEC_LOGIC, DEST_RMW, IDIOM);
+            break;
+        case 0x58: case 0x5C: case 0x5D: case 0x5F:
+        case 0x7C: case 0x7D: case 0xC2: case 0xD0:
+            setClass(X86_SCHED_FP_ADD, DEST_RMW, 0);
+            break;
+        case 0x59:
+            setClass(X86_SCHED_FP_MUL, DEST_RMW, 0);
+            break;
+        case 0x5A:
+            setClass(X86_SCHED_CVT, merge, 0);
+            break;
+        case 0x5E:
+            setClass(X86_SCHED_FP_DIV, DEST_RMW, 0);
+            break;
+        case 0x60: case 0x61: case 0x62: case 0x63:
+        case 0x67: case 0x68: case 0x69: case 0x6A:
+        case 0x6B: case 0x6C: case 0x6D:
+        case 0xC4: case 0xC6:
+            setClass(X86_SCHED_VEC_SHUF, DEST_RMW, 0);
+            break;
+        case 0x64: case 0x65: case 0x66:
+        case 0x74: case 0x75: case 0x76:
+        case 0xF8: case 0xF9: case 0xFA: case 0xFB:
+            setClass(X86_SCHED_VEC_ALU, DEST_RMW, IDIOM);
+            break;
+        case 0x70: case 0xC5:
+            setClass(X86_SCHED_VEC_SHUF, DEST_WRITE, 0);
+            break;
+        case 0x71: case 0x72: case 0x73:
+            // psrldq and pslldq shift whole bytes
+            if (op == 0x73 && (spare == 3 || spare == 7))
+                setClass(X86_SCHED_VEC_SHUF, DEST_RMW, 0);
+            else
+                setClass(X86_SCHED_VEC_ALU, DEST_RMW, 0);
+            break;
+        case 0x90: case 0x91: case 0x92: case 0x93:
+        case 0x94: case 0x95: case 0x96: case 0x97:
+        case 0x98: case 0x99: case 0x9A: case 0x9B:
+        case 0x9C: case 0x9D: case 0x9E: case 0x9F:
+            setClass(X86_SCHED_ALU, DEST_WRITE, RD_FLAGS);
+            break;
+        case 0xA3:
+            setClass(X86_SCHED_ALU, DEST_READ, WR_FLAGS);
+            break;
+        case 0xAB: case 0xB3: case 0xBB:
+            setClass(X86_SCHED_ALU, DEST_RMW, WR_FLAGS);
+            break;
+        case 0xBA:
+            setClass(X86_SCHED_ALU, spare == 4 ? DEST_READ : DEST_RMW,
+                     WR_FLAGS);
+            break;
+        case 0xA4: case 0xA5: case 0xAC: case 0xAD:
+            setClass(X86_SCHED_SHIFT, DEST_RMW, WR_FLAGS);
+            break;
+        case 0xAF:
+            setClass(X86_SCHED_IMUL, DEST_RMW, WR_FLAGS);
+            break;
+        case 0xB6: case 0xB7: case 0xBE: case 0xBF:
+            setClass(X86_SCHED_MOV, DEST_WRITE, 0);
+            break;
+        case 0xB8: case 0xBC: case 0xBD:
+            setClass(X86_SCHED_IMUL, DEST_WRITE, WR_FLAGS);
+            break;
+        case 0xC8: case 0xC9: case 0xCA: case 0xCB:
+        case 0xCC: case 0xCD: case 0xCE: case 0xCF:
+            setClass(X86_SCHED_ALU, DEST_RMW, 0);
+            break;
+        case 0xD1: case 0xD2: case 0xD3: case 0xD4:
+        case 0xD8: case 0xD9: case 0xDA: case 0xDC:
+        case 0xDD: case 0xDE: case 0xE0: case 0xE1:
+        case 0xE2: case 0xE3: case 0xE8: case 0xE9:
+        case 0xEA: case 0xEC: case 0xED: case 0xEE:
+        case 0xF1: case 0xF2: case 0xF3: case 0xFC:
+        case 0xFD: case 0xFE:
+            setClass(X86_SCHED_VEC_ALU, DEST_RMW, 0);
+            break;
+        case 0xD5: case 0xE4: case 0xE5: case 0xF4:
+        case 0xF5: case 0xF6:
+            setClass(X86_SCHED_VEC_IMUL, DEST_RMW, 0);
+            break;
+        default:
+            setClass(X86_SCHED_MISC, DEST_RMW, 0);
+            break;
+    }
+}
+
+void
+X86InsnRecord::Classify0F38(unsigned char op, unsigned char prefix)
+{
+    if (op >= 0x96 && op <= 0xBF)
+    {
+        // FMA forms all accumulate into the destination
+        setClass(X86_SCHED_FMA, DEST_RMW, 0);
+        return;
+    }
+
+    switch (op)
+    {
+        case 0x00: case 0x0C: case 0x0D: case 0x2B:
+            setClass(X86_SCHED_VEC_SHUF, DEST_RMW, 0);
+            break;
+        case 0x01: case 0x02: case 0x03: case 0x05:
+        case 0x06: case 0x07: case 0x08: case 0x09:
+        case 0x0A: case 0x29: case 0x37: case 0x38:
+        case 0x39: case 0x3A: case 0x3B: case 0x3C:
+        case 0x3D: case 0x3E: case 0x3F: case 0x45:
+        case 0x46: case 0x47:
+            setClass(X86_SCHED_VEC_ALU, DEST_RMW, 0);
+            break;
+        case 0x04: case 0x0B: case 0x28: case 0x40:
+        case 0xDC: case 0xDD: case 0xDE: case 0xDF:
+            setClass(X86_SCHED_VEC_IMUL, DEST_RMW, 0);
+            break;
+        case 0x0E: case 0x0F: case 0x17:
+            setClass(X86_SCHED_VEC_ALU, DEST_READ, WR_FLAGS);
+            break;
+        case 0x10: case 0x14: case 0x15:
+            setClass(X86_SCHED_VEC_LOGIC, DEST_RMW, 0);
+            break;
+        case 0x13:
+            setClass(X86_SCHED_CVT, DEST_WRITE, 0);
+            break;
+        case 0x16: case 0x18: case 0x19: case 0x1A:
+        case 0x20: case 0x21: case 0x22: case 0x23:
+        case 0x24: case 0x25: case 0x30: case 0x31:
+        case 0x32: case 0x33: case 0x34: case 0x35:
+        case 0x36: case 0x58: case 0x59: case 0x5A:
+        case 0x78: case 0x79:
+            setClass(X86_SCHED_VEC_SHUF, DEST_WRITE, 0);
+            break;
+        case 0x1C: case 0x1D: case 0x1E:
+            setClass(X86_SCHED_VEC_ALU, DEST_WRITE, 0);
+            break;
+        case 0x2A:
+            setClass(X86_SCHED_VEC_MOV, DEST_WRITE, 0);
+            break;
+        case 0x41: case 0xDB:
+            setClass(X86_SCHED_VEC_IMUL, DEST_WRITE, 0);
+            break;
+        case 0xF0: case 0xF1:
+            // crc32 with F2 prefix, otherwise movbe
+            if (prefix == 0xF2)
+                setClass(X86_SCHED_IMUL, DEST_RMW, 0);
+            else
+                setClass(X86_SCHED_MOV, DEST_WRITE, 0);
+            break;
+        default:
+            setClass(X86_SCHED_MISC, DEST_RMW, 0);
+            break;
+    }
+}
+
+void
+X86InsnRecord::Classify0F3A(unsigned char op)
+{
+    switch (op)
+    {
+        case 0x04: case 0x05: case 0x06: case 0x14:
+        case 0x15: case 0x16: case 0x17: case 0x19:
+        case 0x39:
+            setClass(X86_SCHED_VEC_SHUF, DEST_WRITE, 0);
+            break;
+        case 0x08: case 0x09: case 0x1D:
+            setClass(X86_SCHED_CVT, DEST_WRITE, 0);
+            break;
+        case 0x0A: case 0x0B:
+            setClass(X86_SCHED_CVT, DEST_RMW, 0);
+            break;
+        case 0x0C: case 0x0D: case 0x0E:
+        case 0x4A: case 0x4B: case 0x4C:
+            setClass(X86_SCHED_VEC_LOGIC, DEST_RMW, 0);
+            break;
+        case 0x0F: case 0x18: case 0x20: case 0x21:
+        case 0x22: case 0x38:
+            setClass(X86_SCHED_VEC_SHUF, DEST_RMW, 0);
+            break;
+        case 0x42: case 0x44:
+            setClass(X86_SCHED_VEC_IMUL, DEST_RMW, 0);
+            break;
+        case 0x60: case 0x61: case 0x62: case 0x63:
+            setClass(X86_SCHED_MISC, DEST_READ, WR_FLAGS);
+            break;
+        default:
+            setClass(X86_SCHED_MISC, DEST_RMW, 0);
+            break;
+    }
+}
+
+void
+X86InsnRecord::Classify(X86Opcode opcode,
+                        unsigned char spare,
+                        unsigned char prefix,
+                        unsigned char vexdata)
+{
+    unsigned int len = opcode.getLen();
+    unsigned char op0 = opcode.get(0);
+    unsigned char op1 = len > 1 ? opcode.get(1) : 0;
+    unsigned char op2 = len > 2 ? opcode.get(2) : 0;
+
+    bool scalar = (prefix == 0xF2 || prefix == 0xF3);
+    if (vexdata != 0)
+    {
+        flags |= VEX;
+        if ((vexdata & 0x04) != 0)
+            flags |= VEX256;
+        // prefix modifiers override the VEX pp field
+        if (prefix == 0)
+            scalar = ((vexdata & 0x03) >= 2);
+    }
+
+    // Legacy scalar conversions, square roots, reciprocals and rounding
+    // only replace the low element of the destination, and popcnt, lzcnt
+    // and tzcnt have an output dependency on some processors.
+    if (vexdata == 0 && len > 1 && op0 == 0x0F)
+    {
+        if (op1 == 0x3A)
+        {
+            if (len > 2 && (op2 == 0x0A || op2 == 0x0B))
+                flags |= MERGE;
+        }
+        else if (scalar && (op1 == 0x2A || op1 == 0x51 || op1 == 0x52 ||
+                            op1 == 0x53 || op1 == 0x5A))
+            flags |= MERGE;
+        else if (prefix == 0xF3 &&
+                 (op1 == 0xB8 || op1 == 0xBC || op1 == 0xBD))
+            flags |= MERGE;
+    }
+    else if (vexdata != 0 && op0 == 0x0F && op1 == 0x77)
+        flags |= ZERO_UPPER;
+
+    if ((vexdata & 0xF0) == 0x80)
+        setClass(X86_SCHED_VEC_ALU, DEST_WRITE, 0);     // XOP
+    else if (len == 1 || op0 != 0x0F)
+        ClassifyOneByte(op0, spare);
+    else if (op1 == 0x38)
+        Classify0F38(op2, prefix);
+    else if (op1 == 0x3A)
+        Classify0F3A(op2);
+    else
+        Classify0F(op1, spare, scalar);
+
+    // VEX forms other than FMA have a separate write-only destination.
+    if (vexdata != 0 && m_dest == DEST_RMW && sclass != X86_SCHED_FMA)
+        m_dest = DEST_WRITE;
+}
+
+void
+X86InsnRecord::ClassifyJump(X86Opcode opcode)
+{
+    unsigned char op0 = opcode.get(0);
+    unsigned char op1 = opcode.getLen() > 1 ? opcode.get(1) : 0;
+
+    sclass = X86_SCHED_BRANCH;
+    m_dest = DEST_READ;
+    if ((op0 >= 0x70 && op0 <= 0x7F) ||
+        (op0 == 0x0F && op1 >= 0x80 && op1 <= 0x8F))
+    {
+        flags |= COND;
+        m_deps = RD_FLAGS;
+    }
+    else if (op0 >= 0xE0 && op0 <= 0xE3)
+    {
+        // loop, loope, loopne decrement rCX; jcxz only tests it
+        flags |= COND;
+        reads |= DepBit(X86_DEP_GPR + 1);
+        if (op0 != 0xE3)
+            writes |= DepBit(X86_DEP_GPR + 1);
+        if (op0 == 0xE0 || op0 == 0xE1)
+            m_deps = RD_FLAGS;
+    }
+    else if (op0 == 0xE8)
+    {
+        m_deps = STACK;
+        flags |= STORE;
+    }
+}
+
+void
+X86InsnRecord::AddOperand(const Operand& op, bool dest)
+{
+    if (const X86Register* reg = static_cast<const X86Register*>(op.getReg()))
+    {
+        int index = getDepIndex(*reg);
+        if (index < 0)
+            return;
+        if (dest)
+            m_dst |= DepBit(index);
+        else
+            m_src |= DepBit(index);
+    }
+    else if (EffAddr* ea = op.getMemory())
+    {
+        m_mem |= dest ? MEM_DEST : MEM_SRC;
+        const Expr* e = ea->m_disp.getAbs();
+        if (!e)
+            return;
+        const ExprTerms& terms = e->getTerms();
+        for (ExprTerms::const_iterator i=terms.begin(), end=terms.end();
+             i != end; ++i)
+        {
+            const X86Register* reg =
+                static_cast<const X86Register*>(i->getRegister());
+            if (!reg)
+                continue;
+            int index = getDepIndex(*reg);
+            if (index >= 0)
+                m_addr |= DepBit(index);
+        }
+    }
+}
+
+void
+X86InsnRecord::Finish()
+{
+    // A load into a merging vector move zeroes the rest of the register.
+    if (sclass == X86_SCHED_VEC_MOV && (m_mem & MEM_SRC) != 0)
+        m_dest = DEST_WRITE;
+
+    // Dependency-breaking idioms such as xor eax, eax or pxor xmm0, xmm0.
+    bool idiom = false;
+    if ((m_deps & IDIOM) != 0 && m_mem == 0 && m_src != 0 &&
+        (m_src & (m_src-1)) == 0)
+        idiom = (flags & VEX) != 0 || m_src == m_dst;
+
+    // A merge only matters if the destination isn't also a source.
+    if ((m_dst & m_src) != 0 || m_dst == 0 || (m_mem & MEM_DEST) != 0)
+        flags &= ~MERGE;
+
+    if (idiom)
+        flags |= IDIOM;
+    else
+    {
+        reads |= m_src | m_addr;
+        if (m_dest != DEST_WRITE)
+            reads |= m_dst;
+        if ((m_deps & RD_FLAGS) != 0)
+            reads |= DepBit(X86_DEP_FLAGS);
+    }
+    if (m_dest != DEST_READ)
+        writes |= m_dst;
+    if ((m_deps & WR_FLAGS) != 0)
+        writes |= DepBit(X86_DEP_FLAGS);
+    if ((m_deps & ACC) != 0)
+    {
+        uint64_t acc = DepBit(X86_DEP_GPR + 0) | DepBit(X86_DEP_GPR + 2);
+        reads |= acc;
+        writes |= acc;
+    }
+    if ((m_deps & STACK) != 0)
+    {
+        reads |= DepBit(X86_DEP_GPR + 4);
+        writes |= DepBit(X86_DEP_GPR + 4);
+    }
+
+    // Memory accesses; address computations and hints don't access memory.
+    if (sclass == X86_SCHED_LEA || sclass == X86_SCHED_NOP)
+        return;
+    if ((m_mem & MEM_SRC) != 0)
+        flags |= LOAD;
+    if ((m_mem & MEM_DEST) != 0)
+    {
+        if (m_dest != DEST_READ)
+            flags |= STORE;
+        if (m_dest != DEST_WRITE)
+            flags |= LOAD;
+    }
+    if (sclass == X86_SCHED_PUSH)
+        flags |= STORE;
+    if (sclass == X86_SCHED_POP)
+        flags |= LOAD;
+}
+
+X86Analysis*
+X86Analysis::Create(llvm::StringRef model)
+{
+    for (unsigned int i=0; i<sizeof(models)/sizeof(models[0]); ++i)
+    {
+        if (model.equals_lower(models[i]->name))
+            return new X86Analysis(*models[i]);
+    }
+    return 0;
+}
+
+X86Analysis::X86Analysis(const X86Model& model)
+    : m_model(model)
+{
+}
+
+X86Analysis::~X86Analysis()
+{
+}
+
+X86Regions::X86Regions()
+    : m_open(false)
+{
+}
+
+X86Regions::~X86Regions()
+{
+}
+
+void
+X86Regions::Begin(Location loc,
+                  llvm::StringRef name,
+                  SourceLocation source,
+                  Diagnostic& diags)
+{
+    if (m_open)
+    {
+        diags.Report(source, diags.getCustomDiagID(Diagnostic::Warning,
+            "analysis region already open; ignored"));
+        return;
+    }
+
+    Region region;
+    region.name = name;
+    region.begin = loc;
+    region.end = loc;
+    region.source = source;
+    m_regions.push_back(region);
+    m_open = true;
+}
+
+void
+X86Regions::End(Location loc, SourceLocation source, Diagnostic& diags)
+{
+    if (!m_open)
+    {
+        diags.Report(source, diags.getCustomDiagID(Diagnostic::Warning,
+            "no analysis region open; ignored"));
+        return;
+    }
+
+    Region& region = m_regions.back();
+    m_open = false;
+    if (loc.bc->getContainer() != region.begin.bc->getContainer())
+    {
+        diags.Report(source, diags.getCustomDiagID(Diagnostic::Warning,
+            "analysis region ends in a different section; ignored"));
+        m_regions.pop_back();
+        return;
+    }
+    region.end = loc;
+}
+
+// Cache line and fetch block sizes common to current x86 processors.
+static const unsigned long cache_line = 64;
+static const unsigned long fetch_block = 32;
+
+// Number of blocks of a given size touched by a range of offsets.
+static unsigned long
+BlocksSpanned(unsigned long begin, unsigned long end, unsigned long block)
+{
+    if (end <= begin)
+        return 0;
+    return (end-1)/block - begin/block + 1;
+}
+
+// Number of blocks of a given size a range of offsets could fit in.
+static unsigned long
+BlocksNeeded(unsigned long begin, unsigned long end, unsigned long block)
+{
+    if (end <= begin)
+        return 0;
+    return (end-begin+block-1)/block;
+}
+
+// Whether a branch target leaves less than half of its fetch block.
+static bool
+isTargetMisaligned(unsigned long off)
+{
+    return off % fetch_block > fetch_block/2;
+}
+
+namespace {
+// A label in a marked region, at its offset in the section.
+struct RegionLabel
+{
+    unsigned long off;
+    const Symbol* sym;
+};
+
+struct RegionLabelOrder
+{
+    bool operator() (const RegionLabel& lhs, const RegionLabel& rhs) const
+    { return lhs.off < rhs.off; }
+};
+} // anonymous namespace
+
+// Get the labels in a region in offset order.  Labels in a hot region are
+// loop heads and branch targets.
+static void
+getRegionLabels(const Object& object,
+                const X86Regions::Region& region,
+                std::vector<RegionLabel>& labels)
+{
+    const BytecodeContainer* container = region.begin.bc->getContainer();
+    unsigned long rbegin = region.begin.getOffset();
+    unsigned long rend = region.end.getOffset();
+
+    labels.clear();
+    for (Object::const_symbol_iterator sym=object.symbols_begin(),
+         end=object.symbols_end(); sym != end; ++sym)
+    {
+        Location loc;
+        if (sym->getName().empty() || !sym->getLabel(&loc) ||
+            loc.bc->getContainer() != container)
+            continue;
+        RegionLabel label;
+        label.off = loc.getOffset();
+        label.sym = &*sym;
+        if (label.off >= rbegin && label.off < rend)
+            labels.push_back(label);
+    }
+    std::stable_sort(labels.begin(), labels.end(), RegionLabelOrder());
+}
+
+void
+X86Regions::CheckLayout(const Object& object, Diagnostic& diags) const
+{
+    if (m_open)
+    {
+        diags.Report(m_regions.back().source,
+                     diags.getCustomDiagID(Diagnostic::Warning,
+                         "analysis region never closed; ignored"));
+    }
+
+    if (diags.getDiagnosticLevel(diag::warn_hot_region_split) ==
+        Diagnostic::Ignored &&
+        diags.getDiagnosticLevel(diag::warn_hot_label_misaligned) ==
+        Diagnostic::Ignored)
+        return;
+
+    std::vector<RegionLabel> labels;
+    for (const_iterator r=begin(), last=end(); r != last; ++r)
+    {
+        unsigned long rbegin = r->begin.getOffset();
+        unsigned long rend = r->end.getOffset();
+
+        unsigned long lines = BlocksSpanned(rbegin, rend, cache_line);
+        unsigned long blocks = BlocksSpanned(rbegin, rend, fetch_block);
+        unsigned long min_lines = BlocksNeeded(rbegin, rend, cache_line);
+        unsigned long min_blocks = BlocksNeeded(rbegin, rend, fetch_block);
+        if (lines > min_lines || blocks > min_blocks)
+        {
+            diags.Report(r->source, diag::warn_hot_region_split)
+                << r->name << static_cast<unsigned int>(rend-rbegin)
+                << static_cast<unsigned int>(lines)
+                << static_cast<unsigned int>(blocks)
+                << static_cast<unsigned int>(min_lines)
+                << static_cast<unsigned int>(min_blocks);
+        }
+
+        getRegionLabels(object, *r, labels);
+        for (std::vector<RegionLabel>::const_iterator l=labels.begin(),
+             lend=labels.end(); l != lend; ++l)
+        {
+            if (isTargetMisaligned(l->off))
+            {
+                diags.Report(l->sym->getDefSource(),
+                             diag::warn_hot_label_misaligned)
+                    << l->sym->getName()
+                    << static_cast<unsigned int>(l->off % fetch_block);
+            }
+        }
+    }
+}
+
+// Print the file and line of a source location.
+static void
+PrintSource(const SourceManager& smgr,
+            SourceLocation source,
+            llvm::raw_ostream& os)
+{
+    if (source.isValid())
+    {
+        PresumedLoc ploc = smgr.getPresumedLoc(source);
+        if (!ploc.isInvalid())
+        {
+            os << ploc.getFilename() << ':' << ploc.getLine();
+            return;
+        }
+    }
+    os << "<unknown>";
+}
+
+void
+X86Regions::WriteLayout(const Object& object,
+                        const SourceManager& smgr,
+                        llvm::raw_ostream& os) const
+{
+    std::vector<RegionLabel> labels;
+    for (const_iterator r=begin(), last=end(); r != last; ++r)
+    {
+        unsigned long rbegin = r->begin.getOffset();
+        unsigned long rend = r->end.getOffset();
+        unsigned long lines = BlocksSpanned(rbegin, rend, cache_line);
+        unsigned long blocks = BlocksSpanned(rbegin, rend, fetch_block);
+        unsigned long min_lines = BlocksNeeded(rbegin, rend, cache_line);
+        unsigned long min_blocks = BlocksNeeded(rbegin, rend, fetch_block);
+
+        PrintSource(smgr, r->source, os);
+        os << ": region '" << r->name << "': " << (rend-rbegin)
+           << " bytes at offset " << llvm::format("0x%lx", rbegin) << '\n';
+        os << "  " << lines << " cache lines (minimum " << min_lines << "), "
+           << blocks << " fetch blocks (minimum " << min_blocks << ')';
+        if (lines > min_lines || blocks > min_blocks)
+            os << "; split, " << (fetch_block - rbegin % fetch_block)
+               << " bytes to the next fetch block";
+        os << '\n';
+
+        getRegionLabels(object, *r, labels);
+        for (std::vector<RegionLabel>::const_iterator l=labels.begin(),
+             lend=labels.end(); l != lend; ++l)
+        {
+            os << "  label '" << l->sym->getName() << "' at offset "
+               << llvm::format("0x%lx", l->off) << ": "
+               << (l->off % fetch_block) << " bytes into its fetch block";
+            if (isTargetMisaligned(l->off))
+                os << "; misaligned, "
+                   << (fetch_block - l->off % fetch_block)
+                   << " bytes to the next fetch block";
+            os << '\n';
+        }
+    }
+}
+
+// Get the source text of an instruction, up to any comment.
+static llvm::StringRef
+getSourceText(const SourceManager& smgr, SourceLocation source)
+{
+    if (!source.isValid())
+        return llvm::StringRef();
+    bool invalid = false;
+    const char* start = smgr.getCharacterData(source, &invalid);
+    if (invalid)
+        return llvm::StringRef();
+    const char* end = start;
+    while (*end != '\0' && *end != '\n' && *end != '\r' && *end != ';')
+        ++end;
+    while (end != start && (end[-1] == ' ' || end[-1] == '\t'))
+        --end;
+    return llvm::StringRef(start, end-start);
+}
+
+namespace {
+// Execution port cycles required by an instruction.
+struct PortUse
+{
+    unsigned int ports;
+    double amount;
+};
+
+static unsigned int
+CountPorts(unsigned int ports)
+{
+    unsigned int n = 0;
+    for (; ports != 0; ports &= ports-1)
+        ++n;
+    return n;
+}
+
+// Place the most constrained work first.
+struct PortUseOrder
+{
+    bool operator() (const PortUse& lhs, const PortUse& rhs) const
+    { return CountPorts(lhs.ports) < CountPorts(rhs.ports); }
+};
+
+// An instruction at its final offset in its section.
+struct PlacedInsn
+{
+    unsigned long off;
+    const X86InsnRecord* insn;
+};
+
+struct PlacedInsnOrder
+{
+    bool operator() (const PlacedInsn& lhs, const PlacedInsn& rhs) const
+    { return lhs.off < rhs.off; }
+};
+
+typedef std::map<const BytecodeContainer*, std::vector<PlacedInsn> >
+    PlacedInsns;
+} // anonymous namespace
+
+// Get the instructions of a section that start in [begin, end).
+static void
+getBody(const std::vector<PlacedInsn>& insns,
+        unsigned long begin,
+        unsigned long end,
+        std::vector<const X86InsnRecord*>& body)
+{
+    PlacedInsn key;
+    key.off = begin;
+    key.insn = 0;
+    body.clear();
+    for (std::vector<PlacedInsn>::const_iterator i =
+         std::lower_bound(insns.begin(), insns.end(), key, PlacedInsnOrder()),
+         iend=insns.end(); i != iend && i->off < end; ++i)
+        body.push_back(i->insn);
+}
+
+// Spread an amount of work over a set of ports, filling the least loaded
+// ports first so that they stay level.
+static void
+AddPressure(std::vector<double>& load, unsigned int ports, double amount)
+{
+    while (amount > 1e-9)
+    {
+        double low = 0, next = 0;
+        unsigned int nlow = 0;
+        bool have_next = false;
+        for (unsigned int p=0; p<load.size(); ++p)
+        {
+            if ((ports & (1U<<p)) == 0)
+                continue;
+            if (nlow == 0 || load[p] < low - 1e-9)
+            {
+                if (nlow != 0)
+                {
+                    next = low;
+                    have_next = true;
+                }
+                low = load[p];
+                nlow = 1;
+            }
+            else if (load[p] < low + 1e-9)
+                ++nlow;
+            else if (!have_next || load[p] < next)
+            {
+                next = load[p];
+                have_next = true;
+            }
+        }
+        if (nlow == 0)
+            return;
+
+        double fill = amount;
+        if (have_next && (next - low) * nlow < fill)
+            fill = (next - low) * nlow;
+        for (unsigned int p=0; p<load.size(); ++p)
+        {
+            if ((ports & (1U<<p)) != 0 && load[p] < low + 1e-9)
+                load[p] += fill / nlow;
+        }
+        amount -= fill;
+    }
+}
+
+void
+X86Analysis::ReportRegion(const SourceManager& smgr,
+                          llvm::raw_ostream& os,
+                          const char* kind,
+                          llvm::StringRef name,
+                          SourceLocation source,
+                          unsigned long begin,
+                          unsigned long end,
+                          const std::vector<const X86InsnRecord*>& body) const
+{
+    const X86Model& model = m_model;
+    unsigned int n = static_cast<unsigned int>(body.size());
+
+    // Resource usage of one iteration.
+    std::vector<PortUse> uses;
+    std::vector<unsigned int> latency(n);
+    unsigned int uops = 0;
+    for (unsigned int i=0; i<n; ++i)
+    {
+        const X86InsnRecord& insn = *body[i];
+        const X86SchedEntry& sched = model.sched[insn.sclass];
+        unsigned int scale = 1;
+        if (model.split256 && (insn.flags & X86InsnRecord::VEX256) != 0 &&
+            insn.sclass >= X86_SCHED_VEC_MOV && insn.sclass <= X86_SCHED_CVT)
+            scale = 2;
+
+        // Moves and pops that load are executed entirely by the load port.
+        bool pure_load = (insn.flags & X86InsnRecord::LOAD) != 0 &&
+            (insn.sclass == X86_SCHED_MOV || insn.sclass == X86_SCHED_VEC_MOV
+             || insn.sclass == X86_SCHED_POP);
+        bool pure_store = (insn.flags & X86InsnRecord::STORE) != 0 &&
+            (insn.sclass == X86_SCHED_MOV ||
+             insn.sclass == X86_SCHED_VEC_MOV);
+
+        uops += sched.uops * scale;
+        latency[i] = pure_load ? 0 : sched.latency;
+        PortUse use;
+        use.amount = scale;
+        if (!pure_load && !pure_store && sched.ports != 0)
+        {
+            use.ports = sched.ports;
+            use.amount = sched.pressure * scale;
+            uses.push_back(use);
+            use.amount = scale;
+        }
+        if ((insn.flags & X86InsnRecord::LOAD) != 0)
+        {
+            use.ports = model.load_ports;
+            uses.push_back(use);
+            latency[i] += model.load_latency;
+        }
+        if ((insn.flags & X86InsnRecord::STORE) != 0)
+        {
+            use.ports = model.store_ports;
+            uses.push_back(use);
+            if (model.store_data != 0)
+            {
+                use.ports = model.store_data;
+                uses.push_back(use);
+            }
+        }
+    }
+
+    std::stable_sort(uses.begin(), uses.end(), PortUseOrder());
+    std::vector<double> load(model.nports, 0.0);
+    for (std::vector<PortUse>::const_iterator i=uses.begin(), end=uses.end();
+         i != end; ++i)
+        AddPressure(load, i->ports, i->amount);
+
+    double dispatch = static_cast<double>(uops) / model.width;
+    double pressure = 0;
+    for (unsigned int p=0; p<model.nports; ++p)
+        pressure = std::max(pressure, load[p]);
+
+    // Follow register dependencies through repeated iterations, ignoring
+    // resource limits, to find the loop-carried recurrence.
+    static const unsigned int iters = 32, window = 16;
+    std::vector<unsigned long> finish(iters*n);
+    std::vector<long> pred(iters*n, -1);
+    unsigned long ready[64];
+    long producer[64];
+    for (unsigned int r=0; r<64; ++r)
+    {
+        ready[r] = 0;
+        producer[r] = -1;
+    }
+    unsigned long path = 0;
+    for (unsigned int it=0; it<iters; ++it)
+    {
+        for (unsigned int i=0; i<n; ++i)
+        {
+            const X86InsnRecord& insn = *body[i];
+            uint64_t reads = insn.reads, writes = insn.writes;
+            // The stack engine tracks implicit stack pointer updates.
+            if (insn.sclass == X86_SCHED_PUSH || insn.sclass == X86_SCHED_POP
+                || insn.sclass == X86_SCHED_BRANCH)
+            {
+                reads &= ~DepBit(X86_DEP_GPR + 4);
+                writes &= ~DepBit(X86_DEP_GPR + 4);
+            }
+
+            unsigned long start = 0;
+            long from = -1;
+            for (unsigned int r=0; r<64; ++r)
+            {
+                if ((reads & DepBit(r)) == 0 || producer[r] < 0)
+                    continue;
+                if (from < 0 || ready[r] > start)
+                {
+                    start = ready[r];
+                    from = producer[r];
+                }
+            }
+            unsigned long e = it*n+i;
+            finish[e] = start + latency[i];
+            pred[e] = from;
+            for (unsigned int r=0; r<64; ++r)
+            {
+                if ((writes & DepBit(r)) == 0)
+                    continue;
+                ready[r] = finish[e];
+                producer[r] = static_cast<long>(e);
+            }
+            if (it == 0)
+                path = std::max(path, finish[e]);
+        }
+    }
+
+    // The instruction whose completion time grows fastest is on the
+    // critical recurrence.
+    double recurrence = 0;
+    long critical = -1;
+    for (unsigned int i=0; i<n; ++i)
+    {
+        unsigned long last = finish[(iters-1)*n+i];
+        double growth =
+            static_cast<double>(last - finish[(iters-1-window)*n+i]) / window;
+        if (growth > recurrence + 1e-9)
+        {
+            recurrence = growth;
+            critical = static_cast<long>((iters-1)*n+i);
+        }
+    }
+
+    double cycles = std::max(std::max(dispatch, pressure), recurrence);
+    const char* bound;
+    if (cycles <= 0)
+        bound = "none";
+    else if (recurrence >= cycles)
+        bound = "dependency chain";
+    else if (pressure >= cycles)
+        bound = "port pressure";
+    else
+        bound = "dispatch width";
+
+    PrintSource(smgr, source, os);
+    os << ": " << kind << " '" << name << "' (" << n << " instructions, "
+       << model.name << ")\n";
+    os << "  cycles per iteration: " << llvm::format("%.2f", cycles)
+       << " (" << bound << ")\n";
+    os << "  dispatch: " << llvm::format("%.2f", dispatch) << " cycles ("
+       << uops << " uops, " << model.width << " per cycle)\n";
+    os << "  port pressure:";
+    for (unsigned int p=0; p<model.nports; ++p)
+    {
+        if (load[p] > 1e-9)
+            os << ' ' << model.port_names[p] << '='
+               << llvm::format("%.2f", load[p]);
+    }
+    os << '\n';
+    if (pressure > 1e-9)
+    {
+        os << "  bottleneck ports:";
+        for (unsigned int p=0; p<model.nports; ++p)
+        {
+            if (load[p] > pressure - 1e-6)
+                os << ' ' << model.port_names[p];
+        }
+        os << " (" << llvm::format("%.2f", pressure) << " cycles)\n";
+    }
+    os << "  latency of one iteration: " << path << " cycles\n";
+    os << "  layout: " << (end-begin) << " bytes at offset "
+       << llvm::format("0x%lx", begin) << ", "
+       << BlocksSpanned(begin, end, cache_line) << " cache lines (minimum "
+       << BlocksNeeded(begin, end, cache_line) << "), "
+       << BlocksSpanned(begin, end, fetch_block) << " fetch blocks (minimum "
+       << BlocksNeeded(begin, end, fetch_block) << ")\n";
+
+    if (critical < 0)
+    {
+        os << "  no loop-carried dependency\n";
+        return;
+    }
+
+    // Walk the critical chain back until an instruction repeats; the
+    // instructions from its later occurrence on form the recurrence.  The
+    // critical instruction itself may only be fed by it.
+    std::vector<unsigned int> chain;
+    std::vector<long> seen(n, -1);
+    for (long e = critical; e >= 0; e = pred[e])
+    {
+        unsigned int i = static_cast<unsigned int>(e % n);
+        if (seen[i] >= 0)
+        {
+            chain.erase(chain.begin(), chain.begin()+seen[i]);
+            break;
+        }
+        seen[i] = static_cast<long>(chain.size());
+        chain.push_back(i);
+    }
+    std::reverse(chain.begin(), chain.end());
+    std::rotate(chain.begin(), std::min_element(chain.begin(), chain.end()),
+                chain.end());
+
+    os << "  loop-carried dependency chain: "
+       << llvm::format("%.2f", recurrence) << " cycles per iteration\n";
+    for (std::vector<unsigned int>::const_iterator i=chain.begin(),
+         end=chain.end(); i != end; ++i)
+    {
+        const X86InsnRecord& insn = *body[*i];
+        os << "    ";
+        PrintSource(smgr, insn.source, os);
+        os << ": " << getSourceText(smgr, insn.source) << " ["
+           << sched_names[insn.sclass] << ", " << latency[*i] << "]\n";
+    }
+}
+
+void
+X86Analysis::Report(const X86Regions& regions,
+                    const SourceManager& smgr,
+                    llvm::raw_ostream& os) const
+{
+    // Sort the instructions of each section by offset once, so that each
+    // region and loop finds its body by binary search.
+    PlacedInsns placed;
+    for (std::vector<X86InsnRecord>::const_iterator i=m_insns.begin(),
+         iend=m_insns.end(); i != iend; ++i)
+    {
+        PlacedInsn p;
+        p.off = i->loc.getOffset();
+        p.insn = &*i;
+        placed[i->loc.bc->getContainer()].push_back(p);
+    }
+    for (PlacedInsns::iterator i=placed.begin(), end=placed.end(); i != end;
+         ++i)
+        std::stable_sort(i->second.begin(), i->second.end(),
+                         PlacedInsnOrder());
+
+    std::vector<const X86InsnRecord*> body;
+
+    for (X86Regions::const_iterator r=regions.begin(), rend=regions.end();
+         r != rend; ++r)
+    {
+        PlacedInsns::const_iterator insns =
+            placed.find(r->begin.bc->getContainer());
+        if (insns == placed.end())
+            continue;
+        unsigned long begin = r->begin.getOffset();
+        unsigned long end = r->end.getOffset();
+        getBody(insns->second, begin, end, body);
+        if (!body.empty())
+            ReportRegion(smgr, os, "region", r->name, r->source, begin, end,
+                         body);
+    }
+
+    // Loops are backward branches to a label in the same section.
+    for (std::vector<X86InsnRecord>::const_iterator b=m_insns.begin(),
+         bend=m_insns.end(); b != bend; ++b)
+    {
+        if (!b->target)
+            continue;
+        Location head;
+        if (!b->target->getLabel(&head) ||
+            head.bc->getContainer() != b->loc.bc->getContainer())
+            continue;
+        unsigned long begin = head.getOffset();
+        unsigned long end = b->loc.getOffset();
+        if (begin > end)
+            continue;
+
+        // The body includes the branch itself.
+        getBody(placed[b->loc.bc->getContainer()], begin, end+1, body);
+        // The loop ends after the branch, which is the bytecode's tail.
+        ReportRegion(smgr, os, "loop", b->target->getName(),
+                     b->target->getDefSource(), begin,
+                     b->loc.bc->getNextOffset(), body);
+    }
+}
+
+X86HazardCheck::X86HazardCheck()
+{
+}
+
+X86HazardCheck::~X86HazardCheck()
+{
+}
+
+bool
+X86HazardCheck::isEnabled(const Diagnostic& diags)
+{
+    return diags.getDiagnosticLevel(diag::warn_avx_sse_transition) !=
+           Diagnostic::Ignored ||
+           diags.getDiagnosticLevel(diag::warn_false_dependency) !=
+           Diagnostic::Ignored;
+}
+
+void
+X86HazardCheck::Check(const X86InsnRecord& insn, Diagnostic& diags)
+{
+    static const uint64_t vec_regs =
+        static_cast<uint64_t>(0xFFFF) << X86_DEP_VEC;
+    static const uint64_t stack_reg = DepBit(X86_DEP_GPR + 4);
+
+    State& state = m_sections[insn.loc.bc->getContainer()];
+    uint64_t dest = insn.writes & ~DepBit(X86_DEP_FLAGS);
+
+    // AVX-SSE transitions.  VEX.128 instructions leave the upper state
+    // alone, so only 256-bit instructions dirty it.
+    if ((insn.flags & X86InsnRecord::ZERO_UPPER) != 0)
+        state.upper_dirty = false;
+    else if ((insn.flags & X86InsnRecord::VEX256) != 0)
+    {
+        state.upper_dirty = true;
+        state.upper_source = insn.source;
+    }
+    else if (state.upper_dirty && (insn.flags & X86InsnRecord::VEX) == 0)
+    {
+        bool sse = ((insn.reads | insn.writes) & vec_regs) != 0;
+        // Calls and returns are the only branches that touch the stack.
+        bool call_ret = insn.sclass == X86_SCHED_BRANCH &&
+                        (insn.writes & stack_reg) != 0;
+        if (sse || call_ret)
+        {
+            if (sse)
+                diags.Report(insn.source, diag::warn_avx_sse_transition);
+            else
+                diags.Report(insn.source, diag::warn_avx_dirty_upper_branch)
+                    << ((insn.flags & X86InsnRecord::STORE) != 0 ? 0 : 1);
+            diags.Report(state.upper_source, diag::note_avx256_here);
+            // Only report the first transition.
+            state.upper_dirty = false;
+        }
+    }
+
+    // False dependencies: a merging instruction is fine if its destination
+    // was just cleared or fully overwritten.
+    if ((insn.flags & X86InsnRecord::MERGE) != 0 &&
+        (state.broken & dest) != dest)
+        diags.Report(insn.source, diag::warn_false_dependency);
+
+    if ((insn.flags & X86InsnRecord::IDIOM) != 0)
+        state.broken |= dest;
+    else if ((insn.flags & X86InsnRecord::MERGE) == 0)
+    {
+        // A write that doesn't read the old value starts a new chain.
+        state.broken |= dest & ~insn.reads;
+        state.broken &= ~(dest & insn.reads);
+    }
+    else
+        state.broken &= ~dest;
+}
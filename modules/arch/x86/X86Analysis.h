@@ -0,0 +1,299 @@
+#ifndef YASM_X86ANALYSIS_H
+#define YASM_X86ANALYSIS_H
+//
+// x86 static performance analysis header file
+//
+//  Copyright (C) 2011  PathScale Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <map>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/System/DataTypes.h"
+#include "yasmx/Config/export.h"
+#include "yasmx/Basic/SourceLocation.h"
+#include "yasmx/Location.h"
+#include "yasmx/SymbolRef.h"
+
+
+namespace llvm { class raw_ostream; }
+
+namespace yasm
+{
+
+class BytecodeContainer;
+class Diagnostic;
+class Object;
+class Operand;
+class SourceManager;
+
+namespace arch
+{
+
+class X86Opcode;
+class X86Register;
+struct X86Model;
+
+// Scheduling class of an instruction.  These are coarse groups of
+// instructions that share execution ports and latency on the modeled
+// microarchitectures.
+enum X86SchedClass
+{
+    X86_SCHED_NOP = 0,      // nop, prefetch hints
+    X86_SCHED_ALU,          // integer add/logic/compare, inc/dec, setcc
+    X86_SCHED_SHIFT,        // integer shift/rotate, cmov
+    X86_SCHED_MOV,          // integer register/immediate move, movzx/movsx
+    X86_SCHED_LEA,          // address computation
+    X86_SCHED_IMUL,         // integer multiply, bit scan, popcnt, crc32
+    X86_SCHED_MUL,          // widening one-operand multiply
+    X86_SCHED_DIV,          // integer divide
+    X86_SCHED_BRANCH,       // jumps, calls, returns
+    X86_SCHED_PUSH,         // push to stack
+    X86_SCHED_POP,          // pop from stack
+    X86_SCHED_VEC_MOV,      // vector register move, load, store
+    X86_SCHED_VEC_LOGIC,    // vector bitwise logic, blend
+    X86_SCHED_VEC_ALU,      // vector integer add/compare/shift
+    X86_SCHED_VEC_SHUF,     // vector shuffle, unpack, insert/extract
+    X86_SCHED_VEC_IMUL,     // vector integer multiply, AES, CLMUL
+    X86_SCHED_FP_ADD,       // floating point add/compare/min/max
+    X86_SCHED_FP_MUL,       // floating point multiply, reciprocal
+    X86_SCHED_FMA,          // fused multiply-add
+    X86_SCHED_FP_DIV,       // floating point divide
+    X86_SCHED_FP_SQRT,      // floating point square root
+    X86_SCHED_CVT,          // conversions, rounding
+    X86_SCHED_X87,          // x87 floating point
+    X86_SCHED_MISC,         // everything else (mostly microcoded)
+    X86_SCHED_COUNT
+};
+
+// Register dependency indices used in X86InsnRecord masks.  Partial
+// registers (al, ax, eax) all map to their full register.
+enum X86DepIndex
+{
+    X86_DEP_GPR = 0,        // 16 general purpose registers
+    X86_DEP_VEC = 16,       // 16 XMM/YMM registers
+    X86_DEP_MMX = 32,       // 8 MMX registers
+    X86_DEP_FPU = 40,       // x87 register stack, as a whole
+    X86_DEP_FLAGS = 41      // arithmetic flags
+};
+
+// Information about an appended instruction, recorded for performance
+// analysis after optimization.
+struct YASM_STD_EXPORT X86InsnRecord
+{
+    enum Flags
+    {
+        LOAD = 1<<0,        // reads memory
+        STORE = 1<<1,       // writes memory
+        VEX = 1<<2,         // VEX or XOP encoded
+        VEX256 = 1<<3,      // 256-bit vector length
+        COND = 1<<4,        // conditional branch
+        MERGE = 1<<5,       // merges into a destination it doesn't read
+        IDIOM = 1<<6,       // dependency-breaking idiom
+        ZERO_UPPER = 1<<7   // vzeroupper or vzeroall
+    };
+
+    X86InsnRecord();
+
+    /// Classify an instruction by its opcode.  Must be called before
+    /// any AddOperand() call.
+    /// @param opcode       opcode, before any conversion to VEX/XOP
+    /// @param spare        Mod/RM spare field of group opcodes
+    /// @param prefix       special prefix (0x66, 0xF2, 0xF3, or 0)
+    /// @param vexdata      VEX/XOP data (0 for legacy encoding)
+    void Classify(X86Opcode opcode,
+                  unsigned char spare,
+                  unsigned char prefix,
+                  unsigned char vexdata);
+
+    /// Classify a relative jump or call.
+    /// @param opcode       short opcode if available, otherwise near opcode
+    void ClassifyJump(X86Opcode opcode);
+
+    /// Record the register and memory accesses of an operand.
+    /// @param op           operand
+    /// @param dest         true if the operand is the destination
+    void AddOperand(const Operand& op, bool dest);
+
+    /// Finish the record after all operands have been added.
+    void Finish();
+
+    /// Get the dependency index of a register.
+    /// @return Index, or -1 if the register is not tracked.
+    static int getDepIndex(const X86Register& reg);
+
+    Location loc;               // start of the instruction
+    SourceLocation source;      // source of the instruction
+    SymbolRef target;           // branch target, if a known symbol
+    uint64_t reads;             // mask of register dependencies read
+    uint64_t writes;            // mask of register dependencies written
+    unsigned char sclass;       // X86SchedClass
+    unsigned char flags;        // Flags
+
+private:
+    void setClass(unsigned char sclass, unsigned char dest,
+                  unsigned char deps);
+    void ClassifyOneByte(unsigned char op, unsigned char spare);
+    void Classify0F(unsigned char op, unsigned char spare, bool scalar);
+    void Classify0F38(unsigned char op, unsigned char prefix);
+    void Classify0F3A(unsigned char op);
+
+    uint64_t m_src;             // source operand registers
+    uint64_t m_dst;             // destination operand registers
+    uint64_t m_addr;            // memory address registers
+    unsigned char m_dest;       // how the destination operand is used
+    unsigned char m_deps;       // implicit dependencies
+    unsigned char m_mem;        // which operands are memory
+};
+
+// Hot regions of code marked with the analyze_begin and analyze_end
+// directives.
+class YASM_STD_EXPORT X86Regions
+{
+public:
+    struct Region
+    {
+        std::string name;
+        Location begin;
+        Location end;
+        SourceLocation source;
+    };
+    typedef std::vector<Region>::const_iterator const_iterator;
+
+    X86Regions();
+    ~X86Regions();
+
+    /// Start a marked region.
+    void Begin(Location loc,
+               llvm::StringRef name,
+               SourceLocation source,
+               Diagnostic& diags);
+
+    /// End the open marked region.
+    void End(Location loc, SourceLocation source, Diagnostic& diags);
+
+    /// Closed regions.
+    const_iterator begin() const { return m_regions.begin(); }
+    const_iterator end() const
+    { return m_open ? m_regions.end()-1 : m_regions.end(); }
+
+    /// Check the final placement of each region and of the labels in it
+    /// against cache line and fetch block boundaries.  Call only after
+    /// optimization.
+    void CheckLayout(const Object& object, Diagnostic& diags) const;
+
+    /// Write the placement of each region, and of each label in it,
+    /// relative to cache line and fetch block boundaries, flagging the
+    /// same placements CheckLayout() warns about.  Call only after
+    /// optimization.
+    void WriteLayout(const Object& object,
+                     const SourceManager& smgr,
+                     llvm::raw_ostream& os) const;
+
+private:
+    X86Regions(const X86Regions&);                  // not implemented
+    const X86Regions& operator=(const X86Regions&); // not implemented
+
+    std::vector<Region> m_regions;
+    bool m_open;
+};
+
+// Static throughput and latency analysis of loops and marked regions.
+// Instructions are recorded as they are appended; once the object has
+// been optimized and all offsets are final, each region is scheduled on
+// a simple port/latency model of the selected microarchitecture.
+class YASM_STD_EXPORT X86Analysis
+{
+public:
+    /// Create an analysis using a named microarchitecture model.
+    /// @param model        model name
+    /// @return Newly allocated analysis, or NULL if model is unrecognized.
+    static X86Analysis* Create(llvm::StringRef model);
+
+    ~X86Analysis();
+
+    void AddInsn(const X86InsnRecord& insn) { m_insns.push_back(insn); }
+
+    /// Analyze marked regions and loops (backward branches to a label),
+    /// and write the report.  Call only after optimization.
+    void Report(const X86Regions& regions,
+                const SourceManager& smgr,
+                llvm::raw_ostream& os) const;
+
+private:
+    explicit X86Analysis(const X86Model& model);
+    X86Analysis(const X86Analysis&);                    // not implemented
+    const X86Analysis& operator=(const X86Analysis&);   // not implemented
+
+    void ReportRegion(const SourceManager& smgr,
+                      llvm::raw_ostream& os,
+                      const char* kind,
+                      llvm::StringRef name,
+                      SourceLocation source,
+                      unsigned long begin,
+                      unsigned long end,
+                      const std::vector<const X86InsnRecord*>& body) const;
+
+    const X86Model& m_model;
+    std::vector<X86InsnRecord> m_insns;
+};
+
+// Linear check of each section's instruction stream for performance
+// hazards: legacy SSE instructions following 256-bit AVX code without an
+// intervening vzeroupper, and legacy scalar instructions with a false
+// dependency on their destination register.  Control flow is not
+// followed; instructions are checked in the order they are appended.
+class YASM_STD_EXPORT X86HazardCheck
+{
+public:
+    X86HazardCheck();
+    ~X86HazardCheck();
+
+    /// Determine if any hazard warnings are enabled.
+    static bool isEnabled(const Diagnostic& diags);
+
+    /// Check an instruction against the preceding instructions in its
+    /// section.  The record must have been finished.
+    void Check(const X86InsnRecord& insn, Diagnostic& diags);
+
+private:
+    struct State
+    {
+        State() : upper_dirty(false), broken(0) {}
+
+        bool upper_dirty;           // upper YMM state is dirty
+        SourceLocation upper_source;// last 256-bit instruction
+        uint64_t broken;            // registers with no pending dependency
+    };
+
+    X86HazardCheck(const X86HazardCheck&);                  // not implemented
+    const X86HazardCheck& operator=(const X86HazardCheck&); // not implemented
+
+    std::map<const BytecodeContainer*, State> m_sections;
+};
+
+}} // namespace yasm::arch
+
+#endif
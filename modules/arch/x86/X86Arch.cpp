@@ -38,8 +38,12 @@
 #include "yasmx/Expr.h"
 #include "yasmx/IntNum.h"
 #include "yasmx/Object.h"
+#include "yasmx/Section.h"
 
+#include "X86Analysis.h"
 #include "X86EffAddr.h"
+#include "X86FeatureUsage.h"
+#include "X86MatchCache.h"
 #include "X86RegisterGroup.h"
 
 
@@ -53,7 +57,13 @@ X86Arch::X86Arch(const ArchModule& module)
       m_mode_bits(0),
       m_force_strict(false),
       m_default_rel(false),
-      m_nop(NOP_BASIC)
+      m_nop(NOP_BASIC),
+      m_analysis(0),
+      m_hazards(new X86HazardCheck),
+      m_regions(new X86Regions),
+      m_features(new X86FeatureUsage),
+      m_match_cache(new X86MatchCache),
+      m_frame_effects(0)
 {
     // default to all instructions/features enabled
     m_active_cpu.set();
@@ -90,6 +100,81 @@ X86Arch::~X86Arch()
 {
 }
 
+bool
+X86Arch::setAnalysisModel(llvm::StringRef model)
+{
+    X86Analysis* analysis = X86Analysis::Create(model);
+    if (!analysis)
+        return false;
+    m_analysis.reset(analysis);
+    return true;
+}
+
+void
+X86Arch::WriteAnalysis(const SourceManager& smgr, llvm::raw_ostream& os) const
+{
+    if (m_analysis)
+        m_analysis->Report(*m_regions, smgr, os);
+}
+
+void
+X86Arch::CheckLayout(const Object& object, Diagnostic& diags) const
+{
+    m_regions->CheckLayout(object, diags);
+}
+
+void
+X86Arch::WriteLayout(const Object& object,
+                     const SourceManager& smgr,
+                     llvm::raw_ostream& os) const
+{
+    m_regions->WriteLayout(object, smgr, os);
+}
+
+void
+X86Arch::getCodeProperties(std::vector<CodeProperty>& props) const
+{
+    // GNU_PROPERTY_X86_ISA_1_NEEDED
+    unsigned long isa = m_features->getIsaNeeded();
+    if (isa != 0)
+        props.push_back(CodeProperty(0xc0008002UL, isa));
+
+    // GNU_PROPERTY_X86_FEATURE_2_USED
+    unsigned long features = m_features->getFeaturesUsed();
+    if (features != 0)
+        props.push_back(CodeProperty(0xc0010001UL, features));
+}
+
+bool
+X86Arch::EnableFeatureReport()
+{
+    m_features->EnableReport();
+    return true;
+}
+
+void
+X86Arch::WriteFeatureReport(const Object& object,
+                            const SourceManager& smgr,
+                            llvm::raw_ostream& os) const
+{
+    m_features->WriteReport(object, smgr, os);
+}
+
+bool
+X86Arch::EnableFrameEffects()
+{
+    if (!m_frame_effects)
+        m_frame_effects.reset(new std::vector<FrameEffect>);
+    return true;
+}
+
+void
+X86Arch::getFrameEffects(std::vector<FrameEffect>& effects) const
+{
+    if (m_frame_effects)
+        effects = *m_frame_effects;
+}
+
 llvm::StringRef
 X86Arch::getMachine() const
 {
@@ -250,6 +335,29 @@ X86Arch::DirDefault(DirectiveInfo& info, Diagnostic& diags)
     }
 }
 
+void
+X86Arch::DirAnalyzeBegin(DirectiveInfo& info, Diagnostic& diags)
+{
+    Section* sect = info.getObject().getCurSection();
+    if (!sect)
+        return;
+
+    llvm::StringRef name = "region";
+    NameValues& nvs = info.getNameValues();
+    if (!nvs.empty() && nvs.front().isString())
+        name = nvs.front().getString();
+    m_regions->Begin(sect->getEndLoc(), name, info.getSource(), diags);
+}
+
+void
+X86Arch::DirAnalyzeEnd(DirectiveInfo& info, Diagnostic& diags)
+{
+    Section* sect = info.getObject().getCurSection();
+    if (!sect)
+        return;
+    m_regions->End(sect->getEndLoc(), info.getSource(), diags);
+}
+
 const unsigned char **
 X86Arch::getFill() const
 {
@@ -488,12 +596,16 @@ X86Arch::AddDirectives(Directives& dirs, llvm::StringRef parser)
         {"cpu",     &X86Arch::DirCpu, Directives::ARG_REQUIRED},
         {"bits",    &X86Arch::DirBits, Directives::ARG_REQUIRED},
         {"default", &X86Arch::DirDefault, Directives::ANY},
+        {"analyze_begin", &X86Arch::DirAnalyzeBegin, Directives::ANY},
+        {"analyze_end", &X86Arch::DirAnalyzeEnd, Directives::ANY},
     };
     static const Directives::Init<X86Arch> gas_dirs[] =
     {
         {".code16", &X86Arch::DirCode16, Directives::ANY},
         {".code32", &X86Arch::DirCode32, Directives::ANY},
         {".code64", &X86Arch::DirCode64, Directives::ANY},
+        {".analyze_begin", &X86Arch::DirAnalyzeBegin, Directives::ANY},
+        {".analyze_end", &X86Arch::DirAnalyzeEnd, Directives::ANY},
     };
 
     if (parser.equals_lower("nasm"))
@@ -29,6 +29,7 @@
 #include <bitset>
 
 #include "yasmx/Config/export.h"
+#include "yasmx/Support/scoped_ptr.h"
 #include "yasmx/Arch.h"
 
 #include "X86Register.h"
@@ -45,6 +46,11 @@ class Object;
 namespace arch
 {
 
+class X86Analysis;
+class X86FeatureUsage;
+class X86HazardCheck;
+class X86MatchCache;
+class X86Regions;
 class X86RegisterGroup;
 
 class YASM_STD_EXPORT X86RegTmod
@@ -170,6 +176,21 @@ public:
 
     bool setVar(llvm::StringRef var, unsigned long val);
 
+    bool setAnalysisModel(llvm::StringRef model);
+    void CheckLayout(const Object& object, Diagnostic& diags) const;
+    void WriteLayout(const Object& object,
+                     const SourceManager& smgr,
+                     llvm::raw_ostream& os) const;
+    void WriteAnalysis(const SourceManager& smgr,
+                       llvm::raw_ostream& os) const;
+    void getCodeProperties(std::vector<CodeProperty>& props) const;
+    bool EnableFeatureReport();
+    void WriteFeatureReport(const Object& object,
+                            const SourceManager& smgr,
+                            llvm::raw_ostream& os) const;
+    bool EnableFrameEffects();
+    void getFrameEffects(std::vector<FrameEffect>& effects) const;
+
     InsnPrefix ParseCheckInsnPrefix(llvm::StringRef id,
                                     SourceLocation source,
                                     Diagnostic& diags) const;
@@ -190,6 +211,24 @@ public:
 
     unsigned int getModeBits() const { return m_mode_bits; }
 
+    /// Get the performance analysis, if enabled.
+    /// @return Analysis, or NULL if not enabled.
+    X86Analysis* getAnalysis() const { return m_analysis.get(); }
+
+    /// Get the performance hazard checker.
+    X86HazardCheck& getHazardCheck() const { return *m_hazards; }
+
+    /// Get the record of CPU features used by appended instructions.
+    X86FeatureUsage& getFeatureUsage() const { return *m_features; }
+
+    /// Get the instruction forms matched for previous instructions.
+    X86MatchCache& getMatchCache() const { return *m_match_cache; }
+
+    /// Get the record of stack frame effects, if enabled.
+    /// @return Frame effects, or NULL if not enabled.
+    std::vector<FrameEffect>* getFrameEffectList() const
+    { return m_frame_effects.get(); }
+
     static const char* getName()
     { return "x86 (IA-32 and derivatives), AMD64"; }
     static const char* getKeyword() { return "x86"; }
@@ -208,6 +247,8 @@ private:
     void DirCode32(DirectiveInfo& info, Diagnostic& diags);
     void DirCode64(DirectiveInfo& info, Diagnostic& diags);
     void DirDefault(DirectiveInfo& info, Diagnostic& diags);
+    void DirAnalyzeBegin(DirectiveInfo& info, Diagnostic& diags);
+    void DirAnalyzeEnd(DirectiveInfo& info, Diagnostic& diags);
 
     // What instructions/features are enabled?
     CpuMask m_active_cpu;
@@ -218,6 +259,24 @@ private:
     bool m_force_strict;
     bool m_default_rel;
     NopFormat m_nop;
+
+    // Performance analysis (NULL if not enabled)
+    util::scoped_ptr<X86Analysis> m_analysis;
+
+    // Performance hazard checker
+    util::scoped_ptr<X86HazardCheck> m_hazards;
+
+    // Hot regions marked in the source
+    util::scoped_ptr<X86Regions> m_regions;
+
+    // CPU features used by appended instructions
+    util::scoped_ptr<X86FeatureUsage> m_features;
+
+    // Instruction forms matched for previous instructions
+    util::scoped_ptr<X86MatchCache> m_match_cache;
+
+    // Stack frame effects of appended instructions (NULL if not enabled)
+    util::scoped_ptr<std::vector<FrameEffect> > m_frame_effects;
 };
 
 }} // namespace yasm::arch
@@ -0,0 +1,337 @@
+//
+// x86 CPU feature usage
+//
+//  Copyright (C) 2011  PathScale Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "X86FeatureUsage.h"
+
+#include <map>
+
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "yasmx/Basic/SourceManager.h"
+#include "yasmx/Bytecode.h"
+#include "yasmx/Insn.h"
+#include "yasmx/Object.h"
+#include "yasmx/Section.h"
+#include "yasmx/Symbol.h"
+
+#include "X86Arch.h"
+#include "X86Register.h"
+
+
+using namespace yasm;
+using namespace yasm::arch;
+
+// GNU_PROPERTY_X86_ISA_1_* levels
+static const unsigned long ISA_1_BASELINE = 1UL<<0;
+static const unsigned long ISA_1_V2 = 1UL<<1;
+static const unsigned long ISA_1_V3 = 1UL<<2;
+
+// GNU_PROPERTY_X86_FEATURE_2_* features
+static const unsigned long FEATURE_2_X86 = 1UL<<0;
+static const unsigned long FEATURE_2_X87 = 1UL<<1;
+static const unsigned long FEATURE_2_MMX = 1UL<<2;
+static const unsigned long FEATURE_2_XMM = 1UL<<3;
+static const unsigned long FEATURE_2_YMM = 1UL<<4;
+static const unsigned long FEATURE_2_XSAVE = 1UL<<7;
+static const unsigned long FEATURE_2_XSAVEOPT = 1UL<<8;
+
+// ISA extensions named in the feature report, with the x86-64 psABI
+// level each belongs to (0 if none).
+static const struct
+{
+    unsigned int cpu;
+    const char* name;
+    unsigned int level;
+} extensions[] =
+{
+    {X86Arch::CPU_FPU,      "fpu",      1},
+    {X86Arch::CPU_MMX,      "mmx",      1},
+    {X86Arch::CPU_SSE,      "sse",      1},
+    {X86Arch::CPU_SSE2,     "sse2",     1},
+    {X86Arch::CPU_SSE3,     "sse3",     2},
+    {X86Arch::CPU_SSSE3,    "ssse3",    2},
+    {X86Arch::CPU_SSE41,    "sse4.1",   2},
+    {X86Arch::CPU_SSE42,    "sse4.2",   2},
+    {X86Arch::CPU_AVX,      "avx",      3},
+    {X86Arch::CPU_FMA,      "fma",      3},
+    {X86Arch::CPU_F16C,     "f16c",     3},
+    {X86Arch::CPU_MOVBE,    "movbe",    3},
+    {X86Arch::CPU_SSE4a,    "sse4a",    0},
+    {X86Arch::CPU_3DNow,    "3dnow",    0},
+    {X86Arch::CPU_XOP,      "xop",      0},
+    {X86Arch::CPU_FMA4,     "fma4",     0},
+    {X86Arch::CPU_AES,      "aes",      0},
+    {X86Arch::CPU_CLMUL,    "clmul",    0},
+    {X86Arch::CPU_XSAVE,    "xsave",    0},
+    {X86Arch::CPU_XSAVEOPT, "xsaveopt", 0},
+    {X86Arch::CPU_FSGSBASE, "fsgsbase", 0},
+    {X86Arch::CPU_RDRAND,   "rdrand",   0},
+    {X86Arch::CPU_SVM,      "svm",      0},
+    {X86Arch::CPU_PadLock,  "padlock",  0},
+    {X86Arch::CPU_SMX,      "smx",      0},
+    {X86Arch::CPU_EPTVPID,  "eptvpid",  0},
+    {X86Arch::CPU_SMM,      "smm",      0}
+};
+static const unsigned int NUM_EXTENSIONS =
+    sizeof(extensions)/sizeof(extensions[0]);
+
+static const char* level_names[] =
+{
+    "baseline", "baseline", "x86-64-v2", "x86-64-v3"
+};
+
+X86FeatureUsage::X86FeatureUsage()
+    : m_regs(0),
+      m_used(false),
+      m_report(false)
+{
+}
+
+X86FeatureUsage::~X86FeatureUsage()
+{
+}
+
+void
+X86FeatureUsage::AddCpu(unsigned int cpu0, unsigned int cpu1,
+                        unsigned int cpu2)
+{
+    m_cpu.set(cpu0);
+    m_cpu.set(cpu1);
+    m_cpu.set(cpu2);
+    m_used = true;
+    if (m_report)
+    {
+        m_insn_cpu.set(cpu0);
+        m_insn_cpu.set(cpu1);
+        m_insn_cpu.set(cpu2);
+    }
+}
+
+void
+X86FeatureUsage::AddInsn(const char* name, Location loc, SourceLocation source)
+{
+    if (!m_report)
+        return;
+
+    unsigned long exts = 0;
+    for (unsigned int i=0; i<NUM_EXTENSIONS; ++i)
+    {
+        if (m_insn_cpu[extensions[i].cpu])
+            exts |= 1UL<<i;
+    }
+    m_insn_cpu.reset();
+
+    // Plain integer instructions only matter for their count, which
+    // isn't reported.
+    if (exts == 0)
+        return;
+    InsnUse insn = {loc, source, name, exts};
+    m_insns.push_back(insn);
+}
+
+namespace {
+// Extensions used by a section or function, and the first instruction
+// (index into the instruction records) using each.
+struct Usage
+{
+    Usage() : exts(0) {}
+
+    void Add(std::size_t index, unsigned long insn_exts)
+    {
+        for (unsigned int i=0; i<NUM_EXTENSIONS; ++i)
+        {
+            if ((insn_exts & (1UL<<i)) && !(exts & (1UL<<i)))
+                first[i] = index;
+        }
+        exts |= insn_exts;
+    }
+
+    unsigned long exts;
+    std::size_t first[NUM_EXTENSIONS];
+};
+
+struct Function
+{
+    std::vector<llvm::StringRef> names;
+    Usage usage;
+};
+} // anonymous namespace
+
+static void
+WriteUsage(llvm::raw_ostream& os,
+           const SourceManager& smgr,
+           const std::vector<X86FeatureUsage::InsnUse>& insns,
+           const char* kind,
+           llvm::StringRef name,
+           const Usage& usage)
+{
+    unsigned int level = 0;
+    for (unsigned int i=0; i<NUM_EXTENSIONS; ++i)
+    {
+        if ((usage.exts & (1UL<<i)) && extensions[i].level > level)
+            level = extensions[i].level;
+    }
+
+    os << kind << ' ' << level_names[level] << ' ';
+    if (usage.exts == 0)
+        os << '-';
+    bool first = true;
+    for (unsigned int i=0; i<NUM_EXTENSIONS; ++i)
+    {
+        if (!(usage.exts & (1UL<<i)))
+            continue;
+        if (!first)
+            os << ',';
+        os << extensions[i].name;
+        first = false;
+    }
+    os << ' ' << name << '\n';
+
+    for (unsigned int i=0; i<NUM_EXTENSIONS; ++i)
+    {
+        if (!(usage.exts & (1UL<<i)))
+            continue;
+        const X86FeatureUsage::InsnUse& insn = insns[usage.first[i]];
+        os << "use " << extensions[i].name << ' '
+           << llvm::format("0x%lx", insn.loc.getOffset()) << ' '
+           << insn.name << ' ';
+        PresumedLoc ploc;
+        if (insn.source.isValid())
+            ploc = smgr.getPresumedLoc(insn.source);
+        if (!ploc.isInvalid())
+            os << ploc.getFilename() << ':' << ploc.getLine();
+        else
+            os << '-';
+        os << '\n';
+    }
+}
+
+void
+X86FeatureUsage::WriteReport(const Object& object,
+                             const SourceManager& smgr,
+                             llvm::raw_ostream& os) const
+{
+    for (Object::const_section_iterator sect = object.sections_begin(),
+         end = object.sections_end(); sect != end; ++sect)
+    {
+        if (!sect->isCode())
+            continue;
+        const BytecodeContainer* container = &*sect;
+
+        // Function labels by offset.  Names following the local label
+        // conventions of the parsers (containing '.') only count if
+        // they're global.
+        std::map<unsigned long, Function> funcs;
+        for (Object::const_symbol_iterator sym = object.symbols_begin(),
+             symend = object.symbols_end(); sym != symend; ++sym)
+        {
+            Location loc;
+            if (!sym->getLabel(&loc) || loc.bc->getContainer() != container)
+                continue;
+            if (!(sym->getVisibility() & Symbol::GLOBAL) &&
+                sym->getName().find('.') != llvm::StringRef::npos)
+                continue;
+            funcs[loc.getOffset()].names.push_back(sym->getName());
+        }
+
+        Usage usage;
+        for (std::size_t i=0; i<m_insns.size(); ++i)
+        {
+            const InsnUse& insn = m_insns[i];
+            if (insn.loc.bc->getContainer() != container)
+                continue;
+            usage.Add(i, insn.exts);
+
+            std::map<unsigned long, Function>::iterator func =
+                funcs.upper_bound(insn.loc.getOffset());
+            if (func != funcs.begin())
+                (--func)->second.usage.Add(i, insn.exts);
+        }
+
+        WriteUsage(os, smgr, m_insns, "section", sect->getName(), usage);
+        for (std::map<unsigned long, Function>::const_iterator
+             func = funcs.begin(), funcend = funcs.end(); func != funcend;
+             ++func)
+        {
+            for (std::vector<llvm::StringRef>::const_iterator
+                 name = func->second.names.begin(),
+                 nameend = func->second.names.end(); name != nameend; ++name)
+                WriteUsage(os, smgr, m_insns, "function", *name,
+                           func->second.usage);
+        }
+    }
+}
+
+void
+X86FeatureUsage::AddOperand(const Operand& op)
+{
+    const X86Register* reg = static_cast<const X86Register*>(op.getReg());
+    if (!reg)
+        return;
+    switch (reg->getType())
+    {
+        case X86Register::FPUREG:   m_regs |= FEATURE_2_X87; break;
+        case X86Register::MMXREG:   m_regs |= FEATURE_2_MMX; break;
+        case X86Register::XMMREG:   m_regs |= FEATURE_2_XMM; break;
+        case X86Register::YMMREG:   m_regs |= FEATURE_2_YMM; break;
+        default:                    break;
+    }
+}
+
+unsigned long
+X86FeatureUsage::getIsaNeeded() const
+{
+    // Levels are as defined by the x86-64 psABI.  Each level used is
+    // recorded on its own; the loader requires all of them.  CpuFeature
+    // is coarser than CPUID, so e.g. POPCNT counts as SSE4.2.
+    unsigned long isa = 0;
+    if (m_cpu[X86Arch::CPU_FPU] || m_cpu[X86Arch::CPU_MMX] ||
+        m_cpu[X86Arch::CPU_SSE] || m_cpu[X86Arch::CPU_SSE2])
+        isa |= ISA_1_BASELINE;
+    if (m_cpu[X86Arch::CPU_SSE3] || m_cpu[X86Arch::CPU_SSSE3] ||
+        m_cpu[X86Arch::CPU_SSE41] || m_cpu[X86Arch::CPU_SSE42])
+        isa |= ISA_1_V2;
+    if (m_cpu[X86Arch::CPU_AVX] || m_cpu[X86Arch::CPU_FMA] ||
+        m_cpu[X86Arch::CPU_F16C] || m_cpu[X86Arch::CPU_MOVBE])
+        isa |= ISA_1_V3;
+    return isa;
+}
+
+unsigned long
+X86FeatureUsage::getFeaturesUsed() const
+{
+    if (!m_used)
+        return 0;
+
+    unsigned long features = FEATURE_2_X86 | m_regs;
+    if (m_cpu[X86Arch::CPU_FPU])
+        features |= FEATURE_2_X87;
+    if (m_cpu[X86Arch::CPU_XSAVE])
+        features |= FEATURE_2_XSAVE;
+    if (m_cpu[X86Arch::CPU_XSAVEOPT])
+        features |= FEATURE_2_XSAVEOPT;
+    return features;
+}
@@ -0,0 +1,125 @@
+#ifndef YASM_X86FEATUREUSAGE_H
+#define YASM_X86FEATUREUSAGE_H
+//
+// x86 CPU feature usage header file
+//
+//  Copyright (C) 2011  PathScale Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <bitset>
+#include <vector>
+
+#include "yasmx/Config/export.h"
+#include "yasmx/Basic/SourceLocation.h"
+#include "yasmx/Location.h"
+
+
+namespace llvm { class raw_ostream; }
+
+namespace yasm
+{
+
+class Object;
+class Operand;
+class SourceManager;
+
+namespace arch
+{
+
+// CPU features and register classes used by the appended instructions,
+// summarized as the x86 ISA level and feature bits of ELF GNU program
+// properties.  Optionally the features of each instruction are kept as
+// well, for a report by section and function.
+class YASM_STD_EXPORT X86FeatureUsage
+{
+public:
+    // Report record of an instruction using at least one extension.
+    struct InsnUse
+    {
+        Location loc;           // start of the instruction
+        SourceLocation source;  // source of the instruction
+        const char* name;       // mnemonic
+        unsigned long exts;     // mask of extensions (report table indices)
+    };
+
+    X86FeatureUsage();
+    ~X86FeatureUsage();
+
+    /// Record the use of an instruction form.
+    /// @param cpu0         first CPU feature required by the form
+    /// @param cpu1         second CPU feature required by the form
+    /// @param cpu2         third CPU feature required by the form
+    void AddCpu(unsigned int cpu0, unsigned int cpu1, unsigned int cpu2);
+
+    /// Keep a record of the features used by each instruction, for
+    /// WriteReport().  Must be called before any instructions are added.
+    void EnableReport() { m_report = true; }
+
+    /// Determine if per-instruction records are kept.
+    bool isReportEnabled() const { return m_report; }
+
+    /// Finish recording an instruction.  Call after AddCpu() for each
+    /// feature set the instruction requires.  Does nothing unless the
+    /// report is enabled.
+    /// @param name         instruction mnemonic
+    /// @param loc          start of the instruction
+    /// @param source       source of the instruction
+    void AddInsn(const char* name, Location loc, SourceLocation source);
+
+    /// Write the ISA extensions used by each code section and by each
+    /// function label in it, with the first instruction that uses each
+    /// extension.  Call only after optimization.
+    /// @param object       object
+    /// @param smgr         source manager
+    /// @param os           output stream
+    void WriteReport(const Object& object,
+                     const SourceManager& smgr,
+                     llvm::raw_ostream& os) const;
+
+    /// Record the registers used by an instruction operand.
+    /// @param op           operand
+    void AddOperand(const Operand& op);
+
+    /// Get the x86-64 ISA levels needed (GNU_PROPERTY_X86_ISA_1_*).
+    /// @return Bitmask of ISA levels.
+    unsigned long getIsaNeeded() const;
+
+    /// Get the features used (GNU_PROPERTY_X86_FEATURE_2_*).
+    /// @return Bitmask of features; 0 if no instructions were recorded.
+    unsigned long getFeaturesUsed() const;
+
+private:
+    X86FeatureUsage(const X86FeatureUsage&);                  // not implemented
+    const X86FeatureUsage& operator=(const X86FeatureUsage&); // not implemented
+
+    std::bitset<64> m_cpu;      // X86Arch::CpuFeature flags used
+    std::bitset<64> m_insn_cpu; // flags used by the current instruction
+    unsigned long m_regs;       // GNU_PROPERTY_X86_FEATURE_2_* from registers
+    bool m_used;                // any instructions recorded
+    bool m_report;              // keep per-instruction records
+    std::vector<InsnUse> m_insns;
+};
+
+}} // namespace yasm::arch
+
+#endif
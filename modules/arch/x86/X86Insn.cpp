@@ -39,14 +39,18 @@
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Config/functional.h"
 #include "yasmx/Support/phash.h"
+#include "yasmx/BytecodeContainer.h"
 #include "yasmx/Bytes.h"
 #include "yasmx/EffAddr.h"
 #include "yasmx/Expr.h"
 #include "yasmx/IntNum.h"
 
+#include "X86Analysis.h"
 #include "X86Arch.h"
 #include "X86Common.h"
 #include "X86EffAddr.h"
+#include "X86FeatureUsage.h"
+#include "X86MatchCache.h"
 #include "X86General.h"
 #include "X86Jmp.h"
 #include "X86JmpFar.h"
@@ -566,6 +570,23 @@ X86Insn::DoAppendJmp(BytecodeContainer& container,
     common.ApplyPrefixes(jinfo.def_opersize_64, m_prefixes, diags);
     common.Finish();
 
+    X86Analysis* analysis = m_arch.getAnalysis();
+    bool hazards = X86HazardCheck::isEnabled(diags);
+    if (analysis || hazards)
+    {
+        X86InsnRecord record;
+        record.ClassifyJump(shortop.isEmpty() ? nearop : shortop);
+        record.loc = container.getEndLoc();
+        record.source = source;
+        if (imm->isSymbol())
+            record.target = imm->getSymbol();
+        record.Finish();
+        if (hazards)
+            m_arch.getHazardCheck().Check(record, diags);
+        if (analysis)
+            analysis->AddInsn(record);
+    }
+
     AppendJmp(container, common, shortop, nearop, imm, imm_source, source,
               op_sel);
     return true;
@@ -961,6 +982,79 @@ X86Insn::MatchInfo(const X86InsnInfo& info, const unsigned int* size_lookup,
 #endif
 }
 
+// Profile everything MatchInfo() and MatchOperand() look at, so that
+// instructions with the same profile match the same form.  Registers are
+// profiled by class, size, and just enough of the number to tell the
+// fixed-register operand types apart.
+void
+X86Insn::ProfileMatch(llvm::FoldingSetNodeID& id) const
+{
+    id.AddPointer(m_group);
+    id.AddInteger(m_num_info);
+    id.AddInteger(m_mode_bits);
+    id.AddInteger(m_suffix);
+    id.AddInteger(m_misc_flags);
+    id.AddInteger(m_parser);
+    id.AddBoolean(m_default_rel);
+    // Add the whole CPU mask, 32 bits at a time (to_ulong() may be that
+    // narrow).
+    for (std::size_t i=0; i<m_active_cpu.size(); i += 32)
+        id.AddInteger(((m_active_cpu >> i) &
+                       X86Arch::CpuMask(0xffffffffUL)).to_ulong());
+
+    id.AddInteger(static_cast<unsigned int>(m_operands.size()));
+    for (Operands::const_iterator op = m_operands.begin(),
+         end = m_operands.end(); op != end; ++op)
+    {
+        id.AddInteger(op->getType());
+        id.AddInteger(op->getSize());
+        id.AddPointer(op->getTargetMod());
+        switch (op->getType())
+        {
+            case Operand::REG:
+            {
+                const X86Register* reg =
+                    static_cast<const X86Register*>(op->getReg());
+                id.AddInteger(reg->getType());
+                id.AddInteger(reg->getSize());
+                id.AddInteger(std::min(reg->getNum(), 5U));
+                break;
+            }
+            case Operand::SEGREG:
+                id.AddPointer(op->getSegReg());
+                break;
+            case Operand::MEMORY:
+            {
+                const EffAddr* ea = op->getMemory();
+                const Expr* disp = ea->m_disp.getAbs();
+                id.AddInteger(ea->m_disp.getSize());
+                id.AddBoolean(ea->m_pc_rel);
+                id.AddBoolean(ea->m_not_pc_rel);
+                if (disp && disp->isRegister())
+                {
+                    const X86Register* reg =
+                        static_cast<const X86Register*>(disp->getRegister());
+                    id.AddInteger(reg->getType());
+                    id.AddInteger(std::min(reg->getNum(), 5U));
+                }
+                else
+                    id.AddBoolean(disp && !disp->isEmpty() &&
+                                  disp->Contains(ExprTerm::REG));
+                break;
+            }
+            case Operand::IMM:
+            {
+                const Expr* imm = op->getImm();
+                id.AddBoolean(imm->isIntNum() && imm->getIntNum().isPos1());
+                id.AddBoolean(op->getSeg() != 0);
+                break;
+            }
+            case Operand::NONE:
+                break;
+        }
+    }
+}
+
 const X86InsnInfo*
 X86Insn::FindMatch(const unsigned int* size_lookup, int bypass) const
 {
@@ -1088,15 +1182,33 @@ X86Insn::DoAppend(BytecodeContainer& container,
         }
     }
 
-    const X86InsnInfo* info = FindMatch(size_lookup, 0);
-
+    // Use the form found for an earlier instruction of the same shape.
+    X86MatchCache& cache = m_arch.getMatchCache();
+    llvm::FoldingSetNodeID shape;
+    ProfileMatch(shape);
+    void* insert_pos;
+    const X86InsnInfo* info = cache.Find(shape, &insert_pos);
     if (!info)
     {
-        // Didn't find a match
-        MatchError(size_lookup, source, diags);
-        return false;
+        info = FindMatch(size_lookup, 0);
+        if (!info)
+        {
+            // Didn't find a match
+            MatchError(size_lookup, source, diags);
+            return false;
+        }
+        cache.Insert(shape, info, insert_pos);
     }
 
+    X86FeatureUsage& features = m_arch.getFeatureUsage();
+    features.AddCpu(m_cpu[0], m_cpu[1], m_cpu[2]);
+    features.AddCpu(info->cpu0, info->cpu1, info->cpu2);
+    for (Operands::const_iterator op = m_operands.begin(),
+         end = m_operands.end(); op != end; ++op)
+        features.AddOperand(*op);
+    if (features.isReportEnabled())
+        features.AddInsn(m_name, container.getEndLoc(), source);
+
     if (m_operands.size() > 0)
     {
         switch (insn_operands[info->operands_index+0].action)
@@ -1110,7 +1222,151 @@ X86Insn::DoAppend(BytecodeContainer& container,
         }
     }
 
-    return DoAppendGeneral(container, *info, size_lookup, source, diags);
+    // Operands are consumed by the append, so classify first.
+    std::vector<Arch::FrameEffect>* frame_effects =
+        m_arch.getFrameEffectList();
+    Arch::FrameEffect effect;
+    bool has_effect = frame_effects && getFrameEffect(&effect, diags);
+
+    if (!DoAppendGeneral(container, *info, size_lookup, source, diags))
+        return false;
+
+    if (has_effect)
+    {
+        effect.loc = container.getEndLoc();
+        effect.source = source;
+        frame_effects->push_back(effect);
+    }
+    return true;
+}
+
+// Match a mnemonic, allowing a GAS operand size suffix.
+static bool
+MatchMnemonic(llvm::StringRef name, llvm::StringRef base)
+{
+    if (name.size() == base.size()+1 && name.startswith(base))
+    {
+        char suffix = name[base.size()];
+        return suffix == 'w' || suffix == 'l' || suffix == 'q';
+    }
+    return name == base;
+}
+
+// Get the DWARF register number of a general purpose register.
+static int
+getDwarfReg(const Operand& op, unsigned int mode_bits)
+{
+    static const int amd64_regs[8] = {0, 2, 1, 3, 7, 6, 4, 5};
+
+    const X86Register* reg = static_cast<const X86Register*>(op.getReg());
+    if (!reg || (reg->isNot(X86Register::REG16) &&
+                 reg->isNot(X86Register::REG32) &&
+                 reg->isNot(X86Register::REG64)))
+        return -1;
+    unsigned int num = reg->getNum();
+    if (mode_bits == 64)
+        return num < 8 ? amd64_regs[num] : static_cast<int>(num);
+    return static_cast<int>(num);
+}
+
+// Determine if an operand is the full stack pointer (num 4) or frame
+// pointer (num 5) of the current mode.
+static bool
+isFrameReg(const Operand& op, unsigned int num, unsigned int mode_bits)
+{
+    const X86Register* reg = static_cast<const X86Register*>(op.getReg());
+    if (!reg || reg->getNum() != num)
+        return false;
+    return reg->is(mode_bits == 64 ? X86Register::REG64 : X86Register::REG32);
+}
+
+bool
+X86Insn::getFrameEffect(Arch::FrameEffect* effect, Diagnostic& diags) const
+{
+    if (m_mode_bits == 16 || !m_name)
+        return false;
+
+    llvm::StringRef name(m_name);
+    effect->reg = -1;
+    effect->size = m_mode_bits/8;
+
+    if (MatchMnemonic(name, "ret") || name == "retn")
+    {
+        effect->kind = Arch::FrameEffect::RETURN;
+        return true;
+    }
+
+    if (m_operands.empty())
+    {
+        if (!MatchMnemonic(name, "leave"))
+            return false;
+        effect->kind = Arch::FrameEffect::LEAVE;
+        effect->reg = m_mode_bits == 64 ? 6 : 5;
+        return true;
+    }
+
+    if (m_operands.size() == 1)
+    {
+        bool push = MatchMnemonic(name, "push");
+        if (!push && !MatchMnemonic(name, "pop"))
+            return false;
+        effect->kind = push ? Arch::FrameEffect::PUSH
+                            : Arch::FrameEffect::POP;
+        // Popping the stack pointer loads it from the stack.
+        if (!push && isFrameReg(m_operands.front(), 4, m_mode_bits))
+            effect->kind = Arch::FrameEffect::UNKNOWN;
+        else if (const Register* reg = m_operands.front().getReg())
+        {
+            effect->reg = getDwarfReg(m_operands.front(), m_mode_bits);
+            effect->size = reg->getSize()/8;
+        }
+        return true;
+    }
+
+    if (m_operands.size() != 2)
+        return false;
+
+    // Operands are in source order; GAS puts the destination last.
+    bool gas = m_parser == X86Arch::PARSER_GAS;
+    const Operand& dest = gas ? m_operands[1] : m_operands[0];
+    const Operand& src = gas ? m_operands[0] : m_operands[1];
+
+    if (MatchMnemonic(name, "mov"))
+    {
+        if (isFrameReg(dest, 5, m_mode_bits) &&
+            isFrameReg(src, 4, m_mode_bits))
+        {
+            effect->kind = Arch::FrameEffect::SET_FP;
+            return true;
+        }
+        if (isFrameReg(dest, 4, m_mode_bits) &&
+            isFrameReg(src, 5, m_mode_bits))
+        {
+            effect->kind = Arch::FrameEffect::SET_SP;
+            return true;
+        }
+    }
+
+    if (!isFrameReg(dest, 4, m_mode_bits))
+        return false;
+
+    // Anything else writing the stack pointer is only understood if it
+    // adds or subtracts a constant.
+    effect->kind = Arch::FrameEffect::UNKNOWN;
+    bool sub = MatchMnemonic(name, "sub");
+    if (!sub && !MatchMnemonic(name, "add"))
+        return true;
+    if (!src.getImm())
+        return true;
+    Expr imm(*src.getImm());
+    imm.Simplify(diags);
+    if (!imm.isIntNum() ||
+        !imm.getIntNum().isInRange(-0x7FFFFFFFL, 0x7FFFFFFFL))
+        return true;
+    long val = imm.getIntNum().getInt();
+    effect->kind = Arch::FrameEffect::ADJUST;
+    effect->size = sub ? val : -val;
+    return true;
 }
 
 namespace {
@@ -1122,6 +1378,7 @@ public:
                  const unsigned int* size_lookup,
                  bool force_strict,
                  bool default_rel,
+                 X86InsnRecord* record,
                  Diagnostic& diags);
     ~BuildGeneral();
 
@@ -1143,6 +1400,7 @@ private:
     const unsigned int* m_size_lookup;
     bool m_force_strict;
     bool m_default_rel;
+    X86InsnRecord* m_record;    // analysis record (NULL if not analyzing)
     Diagnostic& m_diags;
 
     X86Opcode m_opcode;
@@ -1169,12 +1427,14 @@ BuildGeneral::BuildGeneral(const X86InsnInfo& info,
                            const unsigned int* size_lookup,
                            bool force_strict,
                            bool default_rel,
+                           X86InsnRecord* record,
                            Diagnostic& diags)
     : m_info(info),
       m_mode_bits(mode_bits),
       m_size_lookup(size_lookup),
       m_force_strict(force_strict),
       m_default_rel(default_rel),
+      m_record(record),
       m_diags(diags),
       m_opcode(info.opcode_len, info.opcode),
       m_x86_ea(0),
@@ -1265,10 +1525,14 @@ void
 BuildGeneral::ApplyOperands(X86Arch::ParserSelect parser,
                             Insn::Operands& operands)
 {
+    if (m_record)
+        m_record->Classify(m_opcode, m_spare, m_special_prefix, m_vexdata);
+
     // Go through operands and assign
     if (operands.size() > 0)
     {
         const X86InfoOperand* info_ops = &insn_operands[m_info.operands_index];
+        const X86InfoOperand* info_dest = info_ops;
 
         // Use reversed operands in GAS mode if not otherwise specified
         if (parser == X86Arch::PARSER_GAS &&
@@ -1277,14 +1541,22 @@ BuildGeneral::ApplyOperands(X86Arch::ParserSelect parser,
             Insn::Operands::reverse_iterator
                 first = operands.rbegin(), last = operands.rend();
             while (first != last)
+            {
+                if (m_record)
+                    m_record->AddOperand(*first, info_ops == info_dest);
                 ApplyOperand(*info_ops++, *first++);
+            }
         }
         else
         {
             Insn::Operands::iterator
                 first = operands.begin(), last = operands.end();
             while (first != last)
+            {
+                if (m_record)
+                    m_record->AddOperand(*first, info_ops == info_dest);
                 ApplyOperand(*info_ops++, *first++);
+            }
         }
     }
 }
@@ -1643,6 +1915,9 @@ BuildGeneral::Finish(BytecodeContainer& container,
     common.ApplyPrefixes(m_def_opersize_64, prefixes, m_diags, &m_rex);
     common.Finish();
 
+    if (m_record)
+        m_record->loc = container.getEndLoc();
+
     // Convert to VEX/XOP prefixes if requested.
     // To save space in the insn structure, the VEX/XOP prefix is written into
     // special_prefix and the first 2 bytes of the instruction are set to
@@ -1742,15 +2017,32 @@ X86Insn::DoAppendGeneral(BytecodeContainer& container,
                          SourceLocation source,
                          Diagnostic& diags)
 {
+    X86Analysis* analysis = m_arch.getAnalysis();
+    bool hazards = X86HazardCheck::isEnabled(diags);
+    X86InsnRecord record;
+
     BuildGeneral buildgen(info, m_mode_bits, size_lookup, m_force_strict,
-                          m_default_rel, diags);
+                          m_default_rel, (analysis || hazards) ? &record : 0,
+                          diags);
 
     buildgen.ApplyModifiers(m_mod_data);
     buildgen.UpdateRex();
     buildgen.ApplyOperands(static_cast<X86Arch::ParserSelect>(m_parser),
                            m_operands);
     buildgen.ApplySegReg(m_segreg, m_segreg_source);
-    return buildgen.Finish(container, m_prefixes, source);
+    if (!buildgen.Finish(container, m_prefixes, source))
+        return false;
+
+    if (analysis || hazards)
+    {
+        record.source = source;
+        record.Finish();
+        if (hazards)
+            m_arch.getHazardCheck().Check(record, diags);
+        if (analysis)
+            analysis->AddInsn(record);
+    }
+    return true;
 }
 
 namespace {
@@ -1940,7 +2232,11 @@ X86Arch::ParseCheckInsnPrefix(llvm::StringRef id,
 inline
 X86Insn::X86Insn(const X86Arch& arch,
                  const X86InsnInfo* group,
+                 const char* name,
                  const X86Arch::CpuMask& active_cpu,
+                 unsigned char cpu0,
+                 unsigned char cpu1,
+                 unsigned char cpu2,
                  unsigned char mod_data0,
                  unsigned char mod_data1,
                  unsigned char mod_data2,
@@ -1953,6 +2249,7 @@ X86Insn::X86Insn(const X86Arch& arch,
                  bool default_rel)
     : m_arch(arch),
       m_group(group),
+      m_name(name),
       m_active_cpu(active_cpu),
       m_num_info(num_info),
       m_mode_bits(mode_bits),
@@ -1962,6 +2259,9 @@ X86Insn::X86Insn(const X86Arch& arch,
       m_force_strict(force_strict),
       m_default_rel(default_rel)
 {
+    m_cpu[0] = cpu0;
+    m_cpu[1] = cpu1;
+    m_cpu[2] = cpu2;
     m_mod_data[0] = mod_data0;
     m_mod_data[1] = mod_data1;
     m_mod_data[2] = mod_data2;
@@ -2013,10 +2313,14 @@ X86Arch::CreateEmptyInsn() const
     return std::auto_ptr<Insn>(new X86Insn(
         *this,
         empty_insn,
+        "",
         m_active_cpu,
         0,
         0,
         0,
+        0,
+        0,
+        0,
         NELEMS(empty_insn),
         m_mode_bits,
         (m_parser == PARSER_GAS) ? SUF_Z : 0,
@@ -2035,7 +2339,11 @@ X86Arch::CreateInsn(const Arch::InsnInfo* info) const
     return std::auto_ptr<Insn>(new X86Insn(
         *this,
         static_cast<const X86InsnInfo*>(pdata->struc),
+        pdata->name,
         m_active_cpu,
+        pdata->cpu0,
+        pdata->cpu1,
+        pdata->cpu2,
         pdata->mod_data0,
         pdata->mod_data1,
         pdata->mod_data2,
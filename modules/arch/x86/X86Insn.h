@@ -31,6 +31,8 @@
 
 #include "X86Arch.h"
 
+namespace llvm { class FoldingSetNodeID; }
+
 namespace yasm
 {
 
@@ -48,7 +50,11 @@ class YASM_STD_EXPORT X86Insn : public Insn
 public:
     X86Insn(const X86Arch& arch,
             const X86InsnInfo* group,
+            const char* name,
             const X86Arch::CpuMask& active_cpu,
+            unsigned char cpu0,
+            unsigned char cpu1,
+            unsigned char cpu2,
             unsigned char mod_data0,
             unsigned char mod_data1,
             unsigned char mod_data2,
@@ -92,6 +98,7 @@ private:
                          SourceLocation source,
                          Diagnostic& diags);
 
+    void ProfileMatch(llvm::FoldingSetNodeID& id) const;
     const X86InsnInfo* FindMatch(const unsigned int* size_lookup, int bypass)
         const;
     bool MatchInfo(const X86InsnInfo& info,
@@ -106,15 +113,24 @@ private:
                     SourceLocation source,
                     Diagnostic& diags) const;
 
+    bool getFrameEffect(Arch::FrameEffect* effect, Diagnostic& diags) const;
+
     // architecture
     const X86Arch& m_arch;
 
     // instruction parse group - NULL if empty instruction (just prefixes)
     /*@null@*/ const X86InsnInfo* m_group;
 
+    // instruction mnemonic, as looked up
+    const char* m_name;
+
     // CPU feature flags enabled at the time of parsing the instruction
     X86Arch::CpuMask m_active_cpu;
 
+    // CPU features required by the instruction as a whole, in addition
+    // to those of the matched form
+    unsigned char m_cpu[3];
+
     // Modifier data
     unsigned char m_mod_data[3];
 
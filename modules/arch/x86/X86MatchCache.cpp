@@ -0,0 +1,72 @@
+//
+// x86 instruction form match cache
+//
+//  Copyright (C) 2011  PathScale Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#define DEBUG_TYPE "x86"
+
+#include "X86MatchCache.h"
+
+#include "llvm/ADT/Statistic.h"
+
+
+STATISTIC(num_match_hits, "Number of instruction forms found in match cache");
+STATISTIC(num_match_entries, "Number of instruction shapes in match cache");
+
+using namespace yasm;
+using namespace yasm::arch;
+
+X86MatchCache::X86MatchCache()
+{
+}
+
+X86MatchCache::~X86MatchCache()
+{
+    for (std::vector<Entry*>::iterator i=m_entries.begin(),
+         end=m_entries.end(); i != end; ++i)
+        delete *i;
+}
+
+const X86InsnInfo*
+X86MatchCache::Find(const llvm::FoldingSetNodeID& shape, void** insert_pos)
+{
+    Entry* entry = m_set.FindNodeOrInsertPos(shape, *insert_pos);
+    if (!entry)
+        return 0;
+    ++num_match_hits;
+    return entry->info;
+}
+
+void
+X86MatchCache::Insert(const llvm::FoldingSetNodeID& shape,
+                      const X86InsnInfo* info,
+                      void* insert_pos)
+{
+    Entry* entry = new Entry;
+    entry->shape = shape;
+    entry->info = info;
+    m_entries.push_back(entry);
+    m_set.InsertNode(entry, insert_pos);
+    ++num_match_entries;
+}
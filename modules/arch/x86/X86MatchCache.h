@@ -0,0 +1,84 @@
+#ifndef YASM_X86MATCHCACHE_H
+#define YASM_X86MATCHCACHE_H
+//
+// x86 instruction form match cache header file
+//
+//  Copyright (C) 2011  PathScale Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <vector>
+
+#include "llvm/ADT/FoldingSet.h"
+#include "yasmx/Config/export.h"
+
+
+namespace yasm
+{
+namespace arch
+{
+
+struct X86InsnInfo;
+
+// Instruction forms chosen for previously matched instructions, keyed by
+// everything the match depends on: the instruction group, the mode, CPU
+// and parser settings, and the kind and size of each operand (see
+// X86Insn::ProfileMatch()).  Generated code repeats a few instruction
+// shapes many times, so most instructions skip the search through the
+// forms of their group.
+class YASM_STD_EXPORT X86MatchCache
+{
+public:
+    X86MatchCache();
+    ~X86MatchCache();
+
+    // Look up the form matched for an instruction shape.
+    // Returns NULL if the shape hasn't been matched yet; insert_pos is
+    // then set for Insert().
+    const X86InsnInfo* Find(const llvm::FoldingSetNodeID& shape,
+                            /*@out@*/ void** insert_pos);
+
+    // Remember the form matched for an instruction shape.
+    // insert_pos must come from a failed Find() of the same shape.
+    void Insert(const llvm::FoldingSetNodeID& shape,
+                const X86InsnInfo* info,
+                void* insert_pos);
+
+private:
+    X86MatchCache(const X86MatchCache&);                    // not implemented
+    const X86MatchCache& operator=(const X86MatchCache&);   // not implemented
+
+    struct Entry : public llvm::FoldingSetNode
+    {
+        llvm::FoldingSetNodeID shape;
+        const X86InsnInfo* info;
+
+        void Profile(llvm::FoldingSetNodeID& id) const { id = shape; }
+    };
+
+    llvm::FoldingSet<Entry> m_set;
+    std::vector<Entry*> m_entries;  // ownership list
+};
+
+}} // namespace yasm::arch
+
+#endif
@@ -0,0 +1,122 @@
+//
+// CodeView debugging format
+//
+//
+//  Copyright (C) 2011  PathScale Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "CvDebug.h"
+
+#include "yasmx/Support/registry.h"
+#include "yasmx/Arch.h"
+#include "yasmx/Bytecode.h"
+#include "yasmx/BytecodeContainer.h"
+#include "yasmx/Expr.h"
+#include "yasmx/Object.h"
+#include "yasmx/Section.h"
+
+#include "CvTypes.h"
+
+
+using namespace yasm;
+using namespace yasm::dbgfmt;
+
+CvDebug::CvDebug(const DebugFormatModule& module, Object& object)
+    : DebugFormat(module, object)
+    , m_objfmt(0)
+    , m_diags(0)
+    , m_info_size(0)
+{
+    // Several instructions can share a bytecode, so bytecode sources are
+    // too coarse for the line tables.
+    object.EnableInsnLines();
+
+    // Frame data is derived from the prologues; without frame effects
+    // procedures are still described, just without frame sizes.
+    object.getArch()->EnableFrameEffects();
+}
+
+CvDebug::~CvDebug()
+{
+}
+
+bool
+CvDebug::isOkObject(Object& object)
+{
+    return object.getArch()->getModule().getKeyword().equals_lower("x86");
+}
+
+void
+CvDebug::Generate(ObjectFormat& objfmt,
+                  SourceManager& smgr,
+                  Diagnostic& diags)
+{
+    m_objfmt = &objfmt;
+    m_diags = &diags;
+
+    Section& debug_s = Generate_symline(smgr);
+    debug_s.Finalize(diags);
+    debug_s.UpdateOffsets(diags);
+
+    Section& debug_t = Generate_type();
+    debug_t.Finalize(diags);
+    debug_t.UpdateOffsets(diags);
+}
+
+unsigned long
+CvDebug::getRecordSize(unsigned long size)
+{
+    return (4+size+3) & ~3UL;
+}
+
+void
+CvDebug::StartRecord(Section& sect, unsigned long size, unsigned int type)
+{
+    // The length excludes the length field itself.
+    AppendData(sect, getRecordSize(size)-2, 2, *m_object.getArch());
+    AppendData(sect, type, 2, *m_object.getArch());
+}
+
+void
+CvDebug::EndRecord(Section& sect, unsigned long size, bool type_record)
+{
+    unsigned long pad = getRecordSize(size) - (4+size);
+    for (; pad > 0; --pad)
+        AppendByte(sect, type_record ? (CV_LF_PAD0 + pad) : 0);
+}
+
+void
+CvDebug::AppendSecRel(Section& sect, SymbolRef sym)
+{
+    Bytecode& bc = sect.FreshBytecode();
+    Value& off = bc.AppendFixed(4, Expr::Ptr(new Expr(sym)), SourceLocation());
+    off.setSectionRelative();
+    bc.AppendFixed(2, Expr::Ptr(new Expr(SEG(sym))), SourceLocation());
+}
+
+void
+yasm_dbgfmt_cv8_DoRegister()
+{
+    RegisterModule<DebugFormatModule,
+                   DebugFormatModuleImpl<CvDebug> >("cv8");
+}
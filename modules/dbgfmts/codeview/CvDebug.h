@@ -0,0 +1,142 @@
+#ifndef YASM_CVDEBUG_H
+#define YASM_CVDEBUG_H
+//
+// CodeView debugging format
+//
+//
+//  Copyright (C) 2011  PathScale Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <map>
+#include <string>
+#include <vector>
+
+#include "yasmx/Config/export.h"
+#include "yasmx/Arch.h"
+#include "yasmx/DebugFormat.h"
+#include "yasmx/Location.h"
+#include "yasmx/SymbolRef.h"
+
+
+namespace yasm
+{
+
+class BytecodeContainer;
+class Diagnostic;
+class Section;
+
+namespace dbgfmt
+{
+
+/// CodeView 8 (Visual Studio 2005 and later) debugging information:
+/// .debug$S holds the line tables, file checksums, and procedure and
+/// frame symbols, and .debug$T the procedure type they refer to.
+class YASM_STD_EXPORT CvDebug : public DebugFormat
+{
+public:
+    CvDebug(const DebugFormatModule& module, Object& object);
+    ~CvDebug();
+
+    static llvm::StringRef getName() { return "CodeView debugging format"; }
+    static llvm::StringRef getKeyword() { return "cv8"; }
+    static bool isOkObject(Object& object);
+
+    void Generate(ObjectFormat& objfmt, SourceManager& smgr, Diagnostic& diags);
+
+private:
+    // Source file referenced by the line tables.
+    struct File
+    {
+        std::string name;           // filename as recorded
+        unsigned long str;          // offset of name in string table
+        unsigned long info;         // offset of checksum entry (file id)
+        bool has_md5;               // MD5 checksum of contents is known
+        unsigned char md5[16];      // MD5 checksum of contents
+    };
+
+    // Line table entry.
+    struct Line
+    {
+        Location loc;               // start of code
+        unsigned long file;         // index into m_files
+        unsigned long line;         // line number
+    };
+
+    // Procedure: the code from a label to the next one.
+    struct Proc
+    {
+        SymbolRef sym;              // label
+        Location start;             // start of code
+        Location end;               // end of code
+        unsigned long frame;        // bytes of locals allocated
+        unsigned long saved;        // bytes of saved registers
+        bool fp;                    // frame pointer set up
+    };
+
+    // CvDebug_symline.cpp
+    typedef std::map<const BytecodeContainer*, std::vector<Line> > LineMap;
+    void CollectLines(SourceManager& smgr, LineMap& lines);
+    void CollectProcs(Section& sect,
+                      const std::vector<Arch::FrameEffect>& effects,
+                      std::vector<Proc>& procs);
+    unsigned long AddFile(SourceManager& smgr,
+                          const char* filename,
+                          SourceLocation source);
+    Section& Generate_symline(SourceManager& smgr);
+    void AppendLines(Section& debug_s,
+                     Section& sect,
+                     const std::vector<Line>& lines);
+    void AppendProc(Section& debug_s, const Proc& proc);
+
+    // CvDebug_type.cpp
+    Section& Generate_type();
+
+    // CvDebug.cpp
+    /// Get the size of a symbol or type record once padded.
+    /// @param size         size of record data (following the type)
+    /// @return Record size, including the header.
+    static unsigned long getRecordSize(unsigned long size);
+    /// Append a symbol or type record header.  Records are padded to a
+    /// multiple of 4 bytes by EndRecord().
+    /// @param sect         section
+    /// @param size         size of record data (following the type)
+    /// @param type         record type
+    void StartRecord(Section& sect, unsigned long size, unsigned int type);
+    /// Append the padding of a symbol or type record.  Type records are
+    /// padded with LF_PAD bytes, symbol records with zeros.
+    void EndRecord(Section& sect, unsigned long size, bool type_record);
+    /// Append a section-relative offset and section index pair.
+    void AppendSecRel(Section& sect, SymbolRef sym);
+
+    ObjectFormat* m_objfmt;
+    Diagnostic* m_diags;
+
+    std::vector<File> m_files;
+    std::map<std::string, unsigned long> m_file_index;  // by source name
+    std::string m_strtab;           // file string table
+    unsigned long m_info_size;      // size of file checksum entries
+};
+
+}} // namespace yasm::dbgfmt
+
+#endif
@@ -0,0 +1,406 @@
+//
+// CodeView debugging format - symbol and line information
+//
+//
+//  Copyright (C) 2011  PathScale Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "CvDebug.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "config.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "yasmx/Basic/FileManager.h"
+#include "yasmx/Basic/SourceManager.h"
+#include "yasmx/Support/MD5.h"
+#include "yasmx/Bytecode.h"
+#include "yasmx/BytecodeContainer.h"
+#include "yasmx/Object.h"
+#include "yasmx/ObjectFormat.h"
+#include "yasmx/Section.h"
+#include "yasmx/Symbol.h"
+
+#include "CvTypes.h"
+
+
+using namespace yasm;
+using namespace yasm::dbgfmt;
+
+// Size of S_GPROC32/S_LPROC32 data ahead of the name.
+static const unsigned long PROC_SIZE = 35;
+
+// Size of S_FRAMEPROC data.
+static const unsigned long FRAMEPROC_SIZE = 26;
+
+unsigned long
+CvDebug::AddFile(SourceManager& smgr,
+                 const char* filename,
+                 SourceLocation source)
+{
+    std::map<std::string, unsigned long>::iterator i =
+        m_file_index.find(filename);
+    if (i != m_file_index.end())
+        return i->second;
+
+    File file;
+    file.name = m_object.RemapPath(filename);
+    file.str = static_cast<unsigned long>(m_strtab.size());
+    file.info = m_info_size;
+    file.has_md5 = false;
+
+    // The contents are only known if the name hasn't been changed by a
+    // line directive.
+    FileID fid = smgr.getFileID(smgr.getInstantiationLoc(source));
+    const llvm::MemoryBuffer* buf = smgr.getBuffer(fid);
+    const FileEntry* entry = smgr.getFileEntryForID(fid);
+    const char* name = entry ? entry->getName() : buf->getBufferIdentifier();
+    if (std::strcmp(name, filename) == 0)
+    {
+        MD5 md5;
+        md5.Update(reinterpret_cast<const unsigned char*>
+                   (buf->getBufferStart()), buf->getBufferSize());
+        md5.Final(file.md5);
+        file.has_md5 = true;
+    }
+
+    m_strtab += file.name;
+    m_strtab += '\0';
+    m_info_size += (6 + (file.has_md5 ? 16 : 0) + 3) & ~3UL;
+
+    unsigned long index = static_cast<unsigned long>(m_files.size());
+    m_files.push_back(file);
+    m_file_index[filename] = index;
+    return index;
+}
+
+void
+CvDebug::CollectLines(SourceManager& smgr, LineMap& lines)
+{
+    Object::InsnLines* insns = m_object.getInsnLines();
+    if (!insns)
+        return;
+
+    for (Object::InsnLines::const_iterator i=insns->begin(),
+         end=insns->end(); i != end; ++i)
+    {
+        PresumedLoc ploc = smgr.getPresumedLoc(i->source);
+        if (ploc.isInvalid())
+            continue;
+
+        Line line = {i->loc, AddFile(smgr, ploc.getFilename(), i->source),
+                     ploc.getLine()};
+        std::vector<Line>& sect_lines = lines[i->loc.bc->getContainer()];
+        if (!sect_lines.empty())
+        {
+            Line& prev = sect_lines.back();
+            // An instruction that generated no code gives way to the next.
+            if (prev.loc.getOffset() == line.loc.getOffset())
+            {
+                prev = line;
+                continue;
+            }
+            if (prev.file == line.file && prev.line == line.line)
+                continue;
+        }
+        sect_lines.push_back(line);
+    }
+}
+
+void
+CvDebug::CollectProcs(Section& sect,
+                      const std::vector<Arch::FrameEffect>& effects,
+                      std::vector<Proc>& procs)
+{
+    const BytecodeContainer* container = &sect;
+
+    // Procedure labels by offset, using the same local label rules as
+    // the parsers: names containing '.' only count if global.
+    std::map<unsigned long, SymbolRef> labels;
+    for (Object::symbol_iterator sym = m_object.symbols_begin(),
+         end = m_object.symbols_end(); sym != end; ++sym)
+    {
+        Location loc;
+        if (!sym->getLabel(&loc) || loc.bc->getContainer() != container ||
+            SymbolRef(&*sym) == sect.getSymbol())
+            continue;
+        bool global = (sym->getVisibility() & Symbol::GLOBAL) != 0;
+        if (!global && sym->getName().find('.') != llvm::StringRef::npos)
+            continue;
+        SymbolRef& label = labels[loc.getOffset()];
+        if (!label || (global && !(label->getVisibility() & Symbol::GLOBAL)))
+            label = SymbolRef(&*sym);
+    }
+
+    Bytecode& last = sect.bytecodes_back();
+    Location sect_end = {&last, last.getNextOffset()-last.getOffset()};
+
+    std::vector<Arch::FrameEffect>::const_iterator effect = effects.begin();
+    for (std::map<unsigned long, SymbolRef>::const_iterator
+         i=labels.begin(), end=labels.end(); i != end; ++i)
+    {
+        Proc proc;
+        proc.sym = i->second;
+        proc.sym->getLabel(&proc.start);
+        std::map<unsigned long, SymbolRef>::const_iterator next = i;
+        ++next;
+        if (next == end)
+            proc.end = sect_end;
+        else
+            next->second->getLabel(&proc.end);
+        proc.frame = 0;
+        proc.saved = 0;
+        proc.fp = false;
+
+        unsigned long start = proc.start.getOffset();
+        unsigned long stop = proc.end.getOffset();
+        if (start == stop)
+            continue;
+
+        // The frame is whatever the prologue sets up: the effects up to
+        // the first one that isn't a register save, frame pointer setup
+        // or stack allocation.  Effect locations follow the instruction.
+        bool prologue = true;
+        for (; effect != effects.end(); ++effect)
+        {
+            if (effect->loc.bc->getContainer() != container)
+                continue;
+            unsigned long off = effect->loc.getOffset();
+            if (off <= start)
+                continue;
+            if (off > stop)
+                break;
+            if (!prologue)
+                continue;
+            switch (effect->kind)
+            {
+                case Arch::FrameEffect::PUSH:
+                    proc.saved += effect->size;
+                    break;
+                case Arch::FrameEffect::ADJUST:
+                    if (effect->size > 0)
+                        proc.frame += effect->size;
+                    else
+                        prologue = false;
+                    break;
+                case Arch::FrameEffect::SET_FP:
+                    proc.fp = true;
+                    break;
+                default:
+                    prologue = false;
+                    break;
+            }
+        }
+        procs.push_back(proc);
+    }
+}
+
+void
+CvDebug::AppendProc(Section& debug_s, const Proc& proc)
+{
+    const Arch& arch = *m_object.getArch();
+    llvm::StringRef name = proc.sym->getName();
+    unsigned long size = PROC_SIZE + name.size() + 1;
+    unsigned long len = proc.end.getOffset() - proc.start.getOffset();
+    bool global = (proc.sym->getVisibility() & Symbol::GLOBAL) != 0;
+
+    StartRecord(debug_s, size, global ? CV_S_GPROC32 : CV_S_LPROC32);
+    AppendData(debug_s, 0, 4, arch);        // parent; filled in by linker
+    AppendData(debug_s, 0, 4, arch);        // end; filled in by linker
+    AppendData(debug_s, 0, 4, arch);        // next; filled in by linker
+    AppendData(debug_s, len, 4, arch);      // procedure length
+    AppendData(debug_s, 0, 4, arch);        // debug start offset
+    AppendData(debug_s, len, 4, arch);      // debug end offset
+    AppendData(debug_s, CV_FIRST_NONPRIM+1, 4, arch);   // type
+    AppendSecRel(debug_s, proc.sym);
+    AppendByte(debug_s, 0);                 // flags
+    AppendData(debug_s, name, true);
+    EndRecord(debug_s, size, false);
+
+    // Locals and parameters are addressed from the frame pointer if the
+    // prologue sets one up, otherwise from the stack pointer.
+    unsigned long base = proc.fp ? CV_FRAME_FP : CV_FRAME_SP;
+    StartRecord(debug_s, FRAMEPROC_SIZE, CV_S_FRAMEPROC);
+    AppendData(debug_s, proc.frame, 4, arch);   // frame size
+    AppendData(debug_s, 0, 4, arch);        // padding size
+    AppendData(debug_s, 0, 4, arch);        // padding offset
+    AppendData(debug_s, proc.saved, 4, arch);   // saved register size
+    AppendData(debug_s, 0, 4, arch);        // exception handler offset
+    AppendData(debug_s, 0, 2, arch);        // exception handler section
+    AppendData(debug_s, (base<<14) | (base<<16), 4, arch);  // flags
+    EndRecord(debug_s, FRAMEPROC_SIZE, false);
+
+    StartRecord(debug_s, 0, CV_S_END);
+    EndRecord(debug_s, 0, false);
+}
+
+void
+CvDebug::AppendLines(Section& debug_s,
+                     Section& sect,
+                     const std::vector<Line>& lines)
+{
+    const Arch& arch = *m_object.getArch();
+
+    // Runs of lines from the same file form a block.
+    unsigned long size = 12;
+    for (std::vector<Line>::const_iterator i=lines.begin(), end=lines.end();
+         i != end; ++i)
+    {
+        if (i == lines.begin() || (i-1)->file != i->file)
+            size += 12;
+        size += 8;
+    }
+
+    AppendData(debug_s, CV8_LINE_NUMS, 4, arch);
+    AppendData(debug_s, size, 4, arch);
+    AppendSecRel(debug_s, sect.getSymbol());
+    AppendData(debug_s, 0, 2, arch);        // flags
+    AppendData(debug_s, sect.bytecodes_back().getNextOffset(), 4, arch);
+
+    std::vector<Line>::const_iterator i = lines.begin(), end = lines.end();
+    while (i != end)
+    {
+        std::vector<Line>::const_iterator block_end = i;
+        while (block_end != end && block_end->file == i->file)
+            ++block_end;
+        unsigned long num = static_cast<unsigned long>(block_end - i);
+
+        AppendData(debug_s, m_files[i->file].info, 4, arch);
+        AppendData(debug_s, num, 4, arch);
+        AppendData(debug_s, 12+8*num, 4, arch);
+        for (; i != block_end; ++i)
+        {
+            AppendData(debug_s, i->loc.getOffset(), 4, arch);
+            AppendData(debug_s, i->line | CV_LINE_IS_STATEMENT, 4, arch);
+        }
+    }
+}
+
+Section&
+CvDebug::Generate_symline(SourceManager& smgr)
+{
+    const Arch& arch = *m_object.getArch();
+    Section* debug_s =
+        m_objfmt->AppendSection(".debug$S", SourceLocation(), *m_diags);
+
+    // The string table starts with an empty string.
+    m_strtab.assign(1, '\0');
+    LineMap lines;
+    CollectLines(smgr, lines);
+
+    std::vector<Arch::FrameEffect> effects;
+    arch.getFrameEffects(effects);
+    std::vector<Proc> procs;
+    for (Object::section_iterator sect = m_object.sections_begin(),
+         end = m_object.sections_end(); sect != end; ++sect)
+    {
+        if (sect->isCode() && sect->bytecodes_begin() != sect->bytecodes_end())
+            CollectProcs(*sect, effects, procs);
+    }
+
+    AppendData(*debug_s, CV8_SIGNATURE, 4, arch);
+
+    // Symbols
+    std::string objname = m_object.RemapPath(m_object.getObjectFilename());
+    std::string version = PACKAGE_NAME " " + m_object.getVersion().str();
+    unsigned long objname_size = 4 + objname.size() + 1;
+    unsigned long compile_size = 4 + 2 + 6*2 + version.size() + 2;
+
+    unsigned long size =
+        getRecordSize(objname_size) + getRecordSize(compile_size);
+    for (std::vector<Proc>::const_iterator i=procs.begin(), end=procs.end();
+         i != end; ++i)
+    {
+        size += getRecordSize(PROC_SIZE + i->sym->getName().size() + 1);
+        size += getRecordSize(FRAMEPROC_SIZE);
+        size += getRecordSize(0);
+    }
+    AppendData(*debug_s, CV8_DEBUG_SYMS, 4, arch);
+    AppendData(*debug_s, size, 4, arch);
+
+    StartRecord(*debug_s, objname_size, CV_S_OBJNAME);
+    AppendData(*debug_s, 0, 4, arch);       // signature
+    AppendData(*debug_s, objname, true);
+    EndRecord(*debug_s, objname_size, false);
+
+    unsigned int ver[3] = {0, 0, 0};
+    std::sscanf(m_object.getVersion().str().c_str(), "%u.%u.%u",
+                &ver[0], &ver[1], &ver[2]);
+    StartRecord(*debug_s, compile_size, CV_S_COMPILE2);
+    AppendData(*debug_s, CV_CFL_MASM, 4, arch);     // language, flags
+    AppendData(*debug_s, arch.getMachine() == "amd64" ?
+               CV_CFL_AMD64 : CV_CFL_80386, 2, arch);
+    for (int fe=0; fe<2; ++fe)              // front end, then back end
+        for (int i=0; i<3; ++i)
+            AppendData(*debug_s, ver[i], 2, arch);
+    AppendData(*debug_s, version, true);
+    AppendByte(*debug_s, 0);                // end of extra strings
+    EndRecord(*debug_s, compile_size, false);
+
+    for (std::vector<Proc>::const_iterator i=procs.begin(), end=procs.end();
+         i != end; ++i)
+        AppendProc(*debug_s, *i);
+
+    // Line numbers, one table per code section
+    for (Object::section_iterator sect = m_object.sections_begin(),
+         end = m_object.sections_end(); sect != end; ++sect)
+    {
+        LineMap::const_iterator sect_lines = lines.find(&*sect);
+        if (sect_lines != lines.end())
+            AppendLines(*debug_s, *sect, sect_lines->second);
+    }
+
+    // File names
+    AppendData(*debug_s, CV8_FILE_STRTAB, 4, arch);
+    AppendData(*debug_s, m_strtab.size(), 4, arch);
+    AppendData(*debug_s, m_strtab, false);
+    for (size_t i=m_strtab.size(); (i & 3) != 0; ++i)
+        AppendByte(*debug_s, 0);
+
+    // File checksums
+    AppendData(*debug_s, CV8_FILE_INFO, 4, arch);
+    AppendData(*debug_s, m_info_size, 4, arch);
+    for (std::vector<File>::const_iterator i=m_files.begin(),
+         end=m_files.end(); i != end; ++i)
+    {
+        AppendData(*debug_s, i->str, 4, arch);
+        if (i->has_md5)
+        {
+            AppendByte(*debug_s, 16);
+            AppendByte(*debug_s, CV_CHKSUM_MD5);
+            AppendData(*debug_s,
+                       llvm::StringRef(reinterpret_cast<const char*>(i->md5),
+                                       16),
+                       false);
+        }
+        else
+        {
+            AppendByte(*debug_s, 0);
+            AppendByte(*debug_s, CV_CHKSUM_NONE);
+        }
+        AppendData(*debug_s, 0, 2, arch);   // padding
+    }
+
+    return *debug_s;
+}
@@ -0,0 +1,66 @@
+//
+// CodeView debugging format - type information
+//
+//
+//  Copyright (C) 2011  PathScale Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "CvDebug.h"
+
+#include "yasmx/BytecodeContainer.h"
+#include "yasmx/Object.h"
+#include "yasmx/ObjectFormat.h"
+#include "yasmx/Section.h"
+
+#include "CvTypes.h"
+
+
+using namespace yasm;
+using namespace yasm::dbgfmt;
+
+Section&
+CvDebug::Generate_type()
+{
+    Section* debug_t =
+        m_objfmt->AppendSection(".debug$T", SourceLocation(), *m_diags);
+    const Arch& arch = *m_object.getArch();
+
+    AppendData(*debug_t, CV8_SIGNATURE, 4, arch);
+
+    // All procedures share one type: no arguments, returning void.
+    // 0x1000: empty argument list
+    StartRecord(*debug_t, 4, CV_LF_ARGLIST);
+    AppendData(*debug_t, 0, 4, arch);           // argument count
+    EndRecord(*debug_t, 4, true);
+
+    // 0x1001: procedure
+    StartRecord(*debug_t, 12, CV_LF_PROCEDURE);
+    AppendData(*debug_t, CV_T_VOID, 4, arch);   // return type
+    AppendByte(*debug_t, 0);                    // near C calling convention
+    AppendByte(*debug_t, 0);                    // attributes
+    AppendData(*debug_t, 0, 2, arch);           // parameter count
+    AppendData(*debug_t, CV_FIRST_NONPRIM, 4, arch);    // argument list
+    EndRecord(*debug_t, 12, true);
+
+    return *debug_t;
+}
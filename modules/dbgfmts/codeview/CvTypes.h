@@ -0,0 +1,93 @@
+#ifndef YASM_CVTYPES_H
+#define YASM_CVTYPES_H
+//
+// CodeView debugging format types
+//
+//
+//  Copyright (C) 2011  PathScale Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+namespace yasm {
+namespace dbgfmt {
+
+// Signature at the start of .debug$S and .debug$T
+enum { CV8_SIGNATURE = 4 };
+
+// .debug$S subsection types
+enum Cv8Subsection
+{
+    CV8_DEBUG_SYMS = 0xF1,
+    CV8_LINE_NUMS = 0xF2,
+    CV8_FILE_STRTAB = 0xF3,
+    CV8_FILE_INFO = 0xF4
+};
+
+// Symbol record types
+enum CvSymbol
+{
+    CV_S_END = 0x0006,
+    CV_S_FRAMEPROC = 0x1012,
+    CV_S_OBJNAME = 0x1101,
+    CV_S_LPROC32 = 0x110F,
+    CV_S_GPROC32 = 0x1110,
+    CV_S_COMPILE2 = 0x1116
+};
+
+// Type record leaf types
+enum CvLeaf
+{
+    CV_LF_PROCEDURE = 0x1008,
+    CV_LF_ARGLIST = 0x1201,
+    CV_LF_PAD0 = 0xF0
+};
+
+// Primitive types
+enum { CV_T_VOID = 0x0003 };
+
+// First type index of records in .debug$T
+enum { CV_FIRST_NONPRIM = 0x1000 };
+
+// S_COMPILE2 language and machine
+enum
+{
+    CV_CFL_MASM = 0x03,
+    CV_CFL_80386 = 0x03,
+    CV_CFL_AMD64 = 0xD0
+};
+
+// S_FRAMEPROC register encodings of the local and parameter base
+enum CvFrameBase
+{
+    CV_FRAME_SP = 1,    // stack pointer (VFRAME on x86)
+    CV_FRAME_FP = 2     // frame pointer
+};
+
+// File checksum types
+enum { CV_CHKSUM_NONE = 0, CV_CHKSUM_MD5 = 1 };
+
+// Line table entry flag
+enum { CV_LINE_IS_STATEMENT = 0x80000000UL };
+
+}} // namespace yasm::dbgfmt
+
+#endif
@@ -140,13 +140,13 @@ IsFdeMatch::operator() (const DwarfCfiCie& cie)
 }
 
 static unsigned int
-getEncodingSize(unsigned int encoding, Arch& arch)
+getEncodingSize(unsigned int encoding, unsigned int sizeof_address)
 {
     if (encoding == DW_EH_PE_omit)
         return 0;
     switch (encoding & 0x7)
     {
-        case DW_EH_PE_absptr: return arch.getAddressSize()/8;
+        case DW_EH_PE_absptr: return sizeof_address;
         case DW_EH_PE_udata2: return 2;
         case DW_EH_PE_udata4: return 4;
         case DW_EH_PE_udata8: return 8;
@@ -449,7 +449,8 @@ DwarfCfiInsn::Output(DwarfCfiOutput& out)
             unsigned int encoding = m_regs[1];
             Expr::Ptr e(new Expr(m_esc.back()));
 
-            unsigned int size = getEncodingSize(encoding, arch);
+            unsigned int size =
+                getEncodingSize(encoding, out.debug.m_sizeof_address);
             if (size == 0)
                 break;
 
@@ -565,7 +566,8 @@ DwarfCfiCie::Output(DwarfCfiOutput& out, unsigned int align)
     {
         // Augmentation data
         unsigned int per_size =
-            getEncodingSize(m_fde->m_personality_encoding, arch);
+            getEncodingSize(m_fde->m_personality_encoding,
+                            out.debug.m_sizeof_address);
 
         unsigned int size = 1;
         if (per_size != 0)
@@ -674,7 +676,8 @@ DwarfCfiFde::Output(DwarfCfiOutput& out, DwarfCfiCie& cie, unsigned int align)
                sizeof_address, arch, m_source, out.diags);
 
     // lsda
-    unsigned int lsda_size = getEncodingSize(m_lsda_encoding, arch);
+    unsigned int lsda_size = getEncodingSize(m_lsda_encoding,
+                                             out.debug.m_sizeof_address);
     if (out.eh_frame)
         AppendLEB128(container, lsda_size, false, m_source, out.diags);
 
@@ -1272,6 +1275,8 @@ DwarfDebug::InitCfi(Arch& arch)
         m_cie_data_alignment = -4;
         m_default_return_column = 8;
         m_frame_initial_instructions = x86_x86_frame_initial_insns;
+        m_stack_pointer_reg = 4;
+        m_frame_pointer_reg = 5;
     }
     else if (arch.getModule().getKeyword() == "x86" &&
              arch.getMachine() == "amd64")
@@ -1279,12 +1284,16 @@ DwarfDebug::InitCfi(Arch& arch)
         m_cie_data_alignment = -8;
         m_default_return_column = 16;
         m_frame_initial_instructions = x86_amd64_frame_initial_insns;
+        m_stack_pointer_reg = 7;
+        m_frame_pointer_reg = 6;
     }
     else
     {
         m_cie_data_alignment = 0;
         m_default_return_column = 0;
         m_frame_initial_instructions = 0;
+        m_stack_pointer_reg = 0;
+        m_frame_pointer_reg = 0;
     }
 }
 
@@ -1340,7 +1349,7 @@ DwarfDebug::GenerateCfiSection(ObjectFormat& ofmt,
                                bool eh_frame)
 {
     unsigned int align;
-    if (eh_frame)
+    if (eh_frame && m_object.getOptions().AddressSize == 0)
         align = ofmt.getModule().getDefaultX86ModeBits() / 8;
     else
         align = m_sizeof_address;
@@ -1393,6 +1402,7 @@ DwarfDebug::GenerateCfi(ObjectFormat& ofmt,
         diags.Report(SourceLocation(), diag::err_eof_inside_cfiproc);
         return;
     }
+    SynthesizeCfi(diags);
     if (m_fdes.empty())
         return;
 
@@ -102,7 +102,7 @@ public:
     {
         DW_CFA_advance_loc = 0x40,  // low 6 bits: delta
         DW_CFA_offset = 0x80,       // low 6 bits: register, op1: ULEB128 off
-        DW_CFA_restore = 0x70,      // low 6 bits: register
+        DW_CFA_restore = 0xC0,      // low 6 bits: register
         DW_CFA_nop = 0,
         DW_CFA_set_loc,             // op1: address
         DW_CFA_advance_loc1,        // op1: 1-byte delta
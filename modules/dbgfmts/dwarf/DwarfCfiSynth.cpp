@@ -0,0 +1,396 @@
+//
+// DWARF call frame information synthesis
+//
+//
+//  Copyright (C) 2011  PathScale Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "DwarfDebug.h"
+
+#include <map>
+
+#include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Arch.h"
+#include "yasmx/Bytecode.h"
+#include "yasmx/Object.h"
+#include "yasmx/Section.h"
+#include "yasmx/Symbol.h"
+
+
+using namespace yasm;
+using namespace yasm::dbgfmt;
+
+namespace {
+// Rule set of a function at one point, relative to its CFA.
+struct FrameState
+{
+    unsigned int cfa_reg;   // register the CFA is based on
+    long cfa_off;           // CFA offset from cfa_reg
+    long sp_off;            // CFA minus stack pointer
+    long fp_off;            // CFA minus frame pointer
+    bool sp_known;          // sp_off is valid
+    bool fp_set;            // fp_off is valid
+    std::map<int, long> saved;  // saved registers and their CFA offsets
+};
+
+// Tracks the frame of one function and appends the CFI instructions
+// describing each change to its FDE.
+class FrameTracker
+{
+public:
+    FrameTracker(DwarfCfiFde& fde,
+                 unsigned int sp,
+                 unsigned int fp,
+                 long word);
+
+    /// Apply an instruction's effect.
+    /// @return False if the CFA can no longer be tracked.
+    bool Apply(const Arch::FrameEffect& effect);
+
+    /// Determine if the frame is as on entry and no return is pending,
+    /// so a following label may start a new function.
+    bool isEntry() const;
+
+    /// Determine if any effects have been applied.
+    bool hasEffects() const { return m_has_effects; }
+
+private:
+    void Emit(DwarfCfiInsn* insn);
+    void setCfaOffset();
+    bool Pop(int reg, long size);
+
+    DwarfCfiFde& m_fde;
+    unsigned int m_sp, m_fp;
+    long m_word;
+
+    FrameState m_state;
+    FrameState m_body;      // state remembered ahead of an epilogue
+    bool m_in_epilogue;     // m_body is valid
+    bool m_returned;        // return seen, restore pending
+    bool m_has_effects;
+
+    Location m_last;        // location of the last emitted row
+    Location m_loc;         // location of the current effect
+    SourceLocation m_source;// source of the current effect
+};
+} // anonymous namespace
+
+FrameTracker::FrameTracker(DwarfCfiFde& fde,
+                           unsigned int sp,
+                           unsigned int fp,
+                           long word)
+    : m_fde(fde)
+    , m_sp(sp)
+    , m_fp(fp)
+    , m_word(word)
+    , m_in_epilogue(false)
+    , m_returned(false)
+    , m_has_effects(false)
+    , m_last(fde.m_start)
+{
+    m_state.cfa_reg = sp;
+    m_state.cfa_off = word;
+    m_state.sp_off = word;
+    m_state.fp_off = 0;
+    m_state.sp_known = true;
+    m_state.fp_set = false;
+}
+
+bool
+FrameTracker::isEntry() const
+{
+    if (m_returned)
+        return true;
+    return m_state.cfa_reg == m_sp && m_state.sp_known &&
+        m_state.sp_off == m_word && m_state.saved.empty();
+}
+
+void
+FrameTracker::Emit(DwarfCfiInsn* insn)
+{
+    if (!(m_loc == m_last))
+    {
+        DwarfCfiInsn* advance = DwarfCfiInsn::MakeAdvanceLoc(m_last, m_loc);
+        advance->setSource(m_source);
+        m_fde.m_insns.push_back(advance);
+        m_last = m_loc;
+    }
+    insn->setSource(m_source);
+    m_fde.m_insns.push_back(insn);
+}
+
+void
+FrameTracker::setCfaOffset()
+{
+    if (m_state.cfa_reg != m_sp)
+        return;
+    m_state.cfa_off = m_state.sp_off;
+    Emit(DwarfCfiInsn::MakeDefCfaOffset(m_state.cfa_off));
+}
+
+bool
+FrameTracker::Pop(int reg, long size)
+{
+    if (!m_state.sp_known)
+        return m_state.cfa_reg != m_sp;
+    long slot = -m_state.sp_off;
+    m_state.sp_off -= size;
+
+    if (reg >= 0 && static_cast<unsigned int>(reg) == m_fp)
+        m_state.fp_set = false;
+    if (m_state.cfa_reg == m_fp && !m_state.fp_set)
+    {
+        m_state.cfa_reg = m_sp;
+        m_state.cfa_off = m_state.sp_off;
+        Emit(DwarfCfiInsn::MakeDefCfa(m_sp, m_state.cfa_off));
+    }
+    else
+        setCfaOffset();
+
+    std::map<int, long>::iterator i = m_state.saved.find(reg);
+    if (i != m_state.saved.end() && i->second == slot)
+    {
+        m_state.saved.erase(i);
+        Emit(DwarfCfiInsn::MakeRestore(reg));
+    }
+    return true;
+}
+
+bool
+FrameTracker::Apply(const Arch::FrameEffect& effect)
+{
+    m_has_effects = true;
+
+    // Code following a return within the function runs with the frame
+    // as it was before the epilogue.
+    if (m_returned)
+    {
+        m_returned = false;
+        if (m_in_epilogue)
+        {
+            Emit(DwarfCfiInsn::MakeRestoreState());
+            m_state = m_body;
+            m_in_epilogue = false;
+        }
+    }
+
+    m_loc = effect.loc;
+    m_source = effect.source;
+
+    // Remember the body state ahead of the first instruction that starts
+    // tearing the frame down.
+    bool teardown = effect.kind == Arch::FrameEffect::POP ||
+        effect.kind == Arch::FrameEffect::SET_SP ||
+        effect.kind == Arch::FrameEffect::LEAVE ||
+        (effect.kind == Arch::FrameEffect::ADJUST && effect.size < 0);
+    if (teardown && !m_in_epilogue && !isEntry())
+    {
+        Emit(DwarfCfiInsn::MakeRememberState());
+        m_body = m_state;
+        m_in_epilogue = true;
+    }
+
+    switch (effect.kind)
+    {
+        case Arch::FrameEffect::PUSH:
+            if (!m_state.sp_known)
+                return m_state.cfa_reg != m_sp;
+            m_state.sp_off += effect.size;
+            setCfaOffset();
+            if (effect.reg >= 0 && static_cast<unsigned int>(effect.reg) != m_sp
+                && m_state.saved.count(effect.reg) == 0)
+            {
+                m_state.saved[effect.reg] = -m_state.sp_off;
+                Emit(DwarfCfiInsn::MakeOffset(effect.reg, -m_state.sp_off));
+            }
+            return true;
+        case Arch::FrameEffect::POP:
+            return Pop(effect.reg, effect.size);
+        case Arch::FrameEffect::ADJUST:
+            if (!m_state.sp_known)
+                return m_state.cfa_reg != m_sp;
+            m_state.sp_off += effect.size;
+            setCfaOffset();
+            return true;
+        case Arch::FrameEffect::SET_FP:
+            if (!m_state.sp_known)
+                return false;
+            m_state.fp_off = m_state.sp_off;
+            m_state.fp_set = true;
+            if (m_state.cfa_reg == m_sp)
+            {
+                m_state.cfa_reg = m_fp;
+                Emit(DwarfCfiInsn::MakeDefCfaRegister(m_fp));
+            }
+            return true;
+        case Arch::FrameEffect::SET_SP:
+        case Arch::FrameEffect::LEAVE:
+            if (!m_state.fp_set)
+            {
+                m_state.sp_known = false;
+                return m_state.cfa_reg != m_sp;
+            }
+            m_state.sp_off = m_state.fp_off;
+            m_state.sp_known = true;
+            setCfaOffset();
+            if (effect.kind == Arch::FrameEffect::LEAVE)
+                return Pop(effect.reg, effect.size);
+            return true;
+        case Arch::FrameEffect::RETURN:
+            m_returned = true;
+            return true;
+        case Arch::FrameEffect::UNKNOWN:
+            m_state.sp_known = false;
+            return m_state.cfa_reg != m_sp;
+    }
+    return true;
+}
+
+namespace {
+struct FrameLabel
+{
+    Location loc;
+    SymbolRef sym;
+};
+} // anonymous namespace
+
+void
+DwarfDebug::SynthesizeCfi(Diagnostic& diags)
+{
+    if (m_frame_initial_instructions == 0)
+        return;
+
+    std::vector<Arch::FrameEffect> effects;
+    m_object.getArch()->getFrameEffects(effects);
+    if (effects.empty())
+        return;
+
+    long word = -m_cie_data_alignment;
+    size_t num_explicit = m_fdes.size();
+
+    for (Object::section_iterator sect = m_object.sections_begin(),
+         end = m_object.sections_end(); sect != end; ++sect)
+    {
+        if (!sect->isCode() || sect->bytecodes_begin() == sect->bytecodes_end())
+            continue;
+        BytecodeContainer* container = &*sect;
+
+        // Ranges already covered by .cfi_startproc/.cfi_endproc.
+        std::map<unsigned long, unsigned long> covered;
+        for (size_t i=0; i<num_explicit; ++i)
+        {
+            const DwarfCfiFde& fde = m_fdes[i];
+            if (fde.m_start.bc->getContainer() == container)
+                covered[fde.m_start.getOffset()] = fde.m_end.getOffset();
+        }
+
+        // Function labels by offset, using the same local label rules
+        // as the parsers: names containing '.' only count if global.
+        std::map<unsigned long, FrameLabel> labels;
+        for (Object::symbol_iterator sym = m_object.symbols_begin(),
+             symend = m_object.symbols_end(); sym != symend; ++sym)
+        {
+            Location loc;
+            if (!sym->getLabel(&loc) || loc.bc->getContainer() != container)
+                continue;
+            if (!(sym->getVisibility() & Symbol::GLOBAL) &&
+                sym->getName().find('.') != llvm::StringRef::npos)
+                continue;
+            FrameLabel label = {loc, SymbolRef(&*sym)};
+            labels.insert(std::make_pair(loc.getOffset(), label));
+        }
+
+        Bytecode& last = sect->bytecodes_back();
+        Location sect_end = {&last, last.getNextOffset()-last.getOffset()};
+
+        std::auto_ptr<DwarfCfiFde> fde;
+        std::auto_ptr<FrameTracker> tracker;
+        SymbolRef func;
+        std::map<unsigned long, FrameLabel>::const_iterator label =
+            labels.begin();
+        std::vector<Arch::FrameEffect>::const_iterator effect =
+            effects.begin();
+
+        for (;;)
+        {
+            // Skip effects in other sections.
+            while (effect != effects.end() &&
+                   effect->loc.bc->getContainer() != container)
+                ++effect;
+
+            // An effect located at a label belongs to the instruction
+            // before it, so effects go first.
+            if (effect != effects.end() &&
+                (label == labels.end() ||
+                 effect->loc.getOffset() <= label->first))
+            {
+                if (tracker.get() && !tracker->Apply(*effect))
+                {
+                    diags.Report(effect->source,
+                                 diag::warn_cfi_synthesis_untracked)
+                        << func->getName();
+                    tracker.reset(0);
+                    fde.reset(0);
+                }
+                ++effect;
+                continue;
+            }
+
+            // Labels within a function that has a frame set up are
+            // branch targets, not functions.
+            if (label != labels.end() && tracker.get() &&
+                !tracker->isEntry())
+            {
+                ++label;
+                continue;
+            }
+
+            Location fde_end =
+                label != labels.end() ? label->second.loc : sect_end;
+            if (tracker.get() && tracker->hasEffects())
+            {
+                fde->Close(fde_end);
+                m_fdes.push_back(fde.release());
+            }
+            tracker.reset(0);
+            fde.reset(0);
+
+            if (label == labels.end())
+                break;
+
+            // Leave functions with explicit CFI alone.
+            std::map<unsigned long, unsigned long>::const_iterator cover =
+                covered.upper_bound(label->first);
+            if (cover == covered.begin() ||
+                (--cover)->second <= label->first)
+            {
+                func = label->second.sym;
+                fde.reset(new DwarfCfiFde(*this, label->second.loc,
+                                          func->getDefSource()));
+                m_frame_initial_instructions(*fde);
+                tracker.reset(new FrameTracker(*fde, m_stack_pointer_reg,
+                                               m_frame_pointer_reg, word));
+            }
+            ++label;
+        }
+    }
+}
@@ -45,7 +45,9 @@ using namespace yasm::dbgfmt;
 DwarfDebug::DwarfDebug(const DebugFormatModule& module, Object& object)
     : DebugFormat(module, object)
     , m_format(FORMAT_32BIT)    // TODO: flexible?
-    , m_sizeof_address(object.getArch()->getAddressSize()/8)
+    , m_sizeof_address((object.getOptions().AddressSize ?
+                        object.getOptions().AddressSize :
+                        object.getArch()->getAddressSize())/8)
     , m_min_insn_len(object.getArch()->getModule().getMinInsnLen())
     , m_fdes_owner(m_fdes)
     , m_cur_fde(0)
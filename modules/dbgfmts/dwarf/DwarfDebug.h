@@ -60,6 +60,7 @@ public:
     static bool isOkObject(Object& object) { return true; }
 
     void AddDirectives(Directives& dirs, llvm::StringRef parser);
+    bool hasCallFrameInfo() const { return true; }
     void Generate(ObjectFormat& objfmt, SourceManager& smgr, Diagnostic& diags);
 
     struct Filename
@@ -130,6 +131,8 @@ private:
     unsigned int m_default_return_column;
     void (*m_frame_initial_instructions) (DwarfCfiFde& fde);
     unsigned int m_fde_reloc_size;
+    unsigned int m_stack_pointer_reg;
+    unsigned int m_frame_pointer_reg;
 
     // Initialize CFI settings
     void InitCfi(Arch& arch);
@@ -171,6 +174,10 @@ private:
                    bool* out_set);
     void AdvanceCfiAddress(Location loc, SourceLocation source);
 
+    // Synthesize FDEs for functions without CFI directives from the
+    // stack frame effects of their instructions.
+    void SynthesizeCfi(Diagnostic& diags);
+
     // Generate CFI section.
     void GenerateCfiSection(ObjectFormat& ofmt,
                             Diagnostic& diags,
@@ -115,17 +115,22 @@ DwarfDebug::Generate_info(Section& debug_line, Section* main_code)
     // input filename: use file 1 if specified, otherwise use source filename
     AppendAbbrevAttr(abbrev, DW_AT_name, DW_FORM_string);
     if (!m_filenames.empty() && !m_filenames[0].pathname.empty())
-        AppendData(debug_info, m_filenames[0].pathname, true);
+        AppendData(debug_info, m_object.RemapPath(m_filenames[0].pathname),
+                   true);
     else
-        AppendData(debug_info, m_object.getSourceFilename(), true);
+        AppendData(debug_info,
+                   m_object.RemapPath(m_object.getSourceFilename()), true);
 
     // compile directory (current working directory)
     AppendAbbrevAttr(abbrev, DW_AT_comp_dir, DW_FORM_string);
-    AppendData(debug_info, llvm::sys::Path::GetCurrentDirectory().str(), true);
+    AppendData(debug_info,
+               m_object.RemapPath(llvm::sys::Path::GetCurrentDirectory().str()),
+               true);
 
     // producer - assembler name
     AppendAbbrevAttr(abbrev, DW_AT_producer, DW_FORM_string);
-    AppendData(debug_info, PACKAGE_NAME " " PACKAGE_VERSION, true);
+    AppendData(debug_info, PACKAGE_NAME " " + m_object.getVersion().str(),
+               true);
 
     // language - no standard code for assembler, use MIPS as a substitute
     AppendAbbrevAttr(abbrev, DW_AT_language, DW_FORM_data2);
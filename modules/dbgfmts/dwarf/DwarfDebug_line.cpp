@@ -128,12 +128,13 @@ unsigned long
 DwarfDebug::AddDir(llvm::StringRef dirname)
 {
     // Put the directory into the directory table (checking for duplicates)
+    std::string mapped = m_object.RemapPath(dirname);
     Dirs::iterator d =
-        std::find(m_dirs.begin(), m_dirs.end(), dirname);
+        std::find(m_dirs.begin(), m_dirs.end(), mapped);
     if (d != m_dirs.end())
         return d-m_dirs.begin();
 
-    m_dirs.push_back(dirname);
+    m_dirs.push_back(mapped);
     return m_dirs.size()-1;
 }
 
@@ -141,10 +142,11 @@ size_t
 DwarfDebug::AddFile(const FileEntry* file)
 {
     unsigned long dir = AddDir(file->getDir()->getName());
+    std::string name = m_object.RemapPath(file->getName());
 
     // Put the filename into the filename table (checking for duplicates)
     Filenames::iterator f = std::find_if(m_filenames.begin(), m_filenames.end(),
-                                         MatchFileDir(file->getName(), dir));
+                                         MatchFileDir(name, dir));
 
     size_t filenum;
     if (f != m_filenames.end())
@@ -158,9 +160,13 @@ DwarfDebug::AddFile(const FileEntry* file)
         filenum = m_filenames.size();
         m_filenames.push_back(Filename());
     }
-    m_filenames[filenum].filename = file->getName();
+    m_filenames[filenum].filename = name;
     m_filenames[filenum].dir = dir;
-    m_filenames[filenum].time = file->getModificationTime();
+    // The modification time isn't a property of the input contents.
+    if (m_object.hasFixedTimestamp())
+        m_filenames[filenum].time = 0;
+    else
+        m_filenames[filenum].time = file->getModificationTime();
     m_filenames[filenum].length = file->getSize();
     return filenum;
 }
@@ -27,7 +27,9 @@
 #include "BinLink.h"
 
 #include <algorithm>
+#include <vector>
 
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/Support/raw_ostream.h"
 #include "yasmx/Basic/Diagnostic.h"
@@ -74,40 +76,6 @@ yasm::objfmt::append_data(pugi::xml_node out, const BinGroups& groups)
 }
 #endif // WITH_XML
 
-// Recursive function to find group containing named section.
-static BinGroup*
-FindGroup(BinGroups& groups, const std::string& name)
-{
-    for (BinGroups::iterator group = groups.begin(), end = groups.end();
-         group != end; ++group)
-    {
-        if (group->m_section.getName() == name)
-            return &(*group);
-        // Recurse to loop through follow groups
-        BinGroup* found = FindGroup(group->m_follow_groups, name);
-        if (found)
-            return found;
-    }
-    return 0;
-}
-
-// Recursive function to find group.  Returns NULL if not found.
-static BinGroup*
-FindGroup(BinGroups& groups, const Section& section)
-{
-    for (BinGroups::iterator group = groups.begin(), end = groups.end();
-         group != end; ++group)
-    {
-        if (&group->m_section == &section)
-            return &(*group);
-        // Recurse to loop through follow groups
-        BinGroup* found = FindGroup(group->m_follow_groups, section);
-        if (found)
-            return found;
-    }
-    return 0;
-}
-
 BinLink::BinLink(Object& object, Diagnostic& diags)
     : m_object(object),
       m_diags(diags),
@@ -217,11 +185,106 @@ CompareIStart(const BinGroup& lhs, const BinGroup& rhs)
     return (lhs.m_section.getLMA() < rhs.m_section.getLMA());
 }
 
+// Builds the follows tree from a flat list of groups.  Each section follows
+// at most one other section, so once loops are rejected the groups form a
+// forest that can be built in one pass over the list, with followers kept
+// in section order.
 bool
-BinLink::DoLink(const IntNum& origin)
+BinLink::LinkFollowGroups(BinGroups& groups, bool vfollows)
 {
-    BinGroups::iterator group;
+    static const int NO_FOLLOWS = -1;
+    static const int UNKNOWN_FOLLOWS = -2;
+
+    int ngroups = static_cast<int>(groups.size());
+
+    llvm::StringMap<int> index;
+    for (int i=0; i<ngroups; ++i)
+        index.GetOrCreateValue(groups.at(i).m_section.getName(), i);
+
+    // Resolve the section each group follows.
+    std::vector<int> follows(ngroups, NO_FOLLOWS);
+    for (int i=0; i<ngroups; ++i)
+    {
+        const BinSection& bsd = groups.at(i).m_bsd;
+        const std::string& name = vfollows ? bsd.vfollows : bsd.follows;
+        if (name.empty())
+            continue;
+        llvm::StringMap<int>::const_iterator found = index.find(name);
+        follows[i] = (found == index.end()) ? UNKNOWN_FOLLOWS
+                                            : found->getValue();
+    }
+
+    // Find loops.  Walk each follows chain once, marking groups in progress;
+    // reaching an in-progress group closes a loop.  The loop is reported at
+    // its last member in section order.
+    enum { UNVISITED = 0, IN_PROGRESS, DONE };
+    std::vector<char> state(ngroups, UNVISITED);
+    std::vector<bool> closes_loop(ngroups, false);
+    std::vector<int> path;
+    for (int i=0; i<ngroups; ++i)
+    {
+        int j = i;
+        while (j >= 0 && state[j] == UNVISITED)
+        {
+            state[j] = IN_PROGRESS;
+            path.push_back(j);
+            j = follows[j];
+        }
+        if (j >= 0 && state[j] == IN_PROGRESS)
+        {
+            int last = j;
+            for (std::vector<int>::iterator k=
+                 std::find(path.begin(), path.end(), j), end=path.end();
+                 k != end; ++k)
+                last = std::max(last, *k);
+            closes_loop[last] = true;
+        }
+        for (std::vector<int>::iterator k=path.begin(), end=path.end();
+             k != end; ++k)
+            state[*k] = DONE;
+        path.clear();
+    }
+
+    // Report the first error in section order.
+    for (int i=0; i<ngroups; ++i)
+    {
+        const BinGroup& group = groups.at(i);
+        if (follows[i] == UNKNOWN_FOLLOWS)
+        {
+            m_diags.Report(SourceLocation(),
+                           vfollows ? diag::err_section_vfollows_unknown
+                                    : diag::err_section_follows_unknown)
+                << group.m_section.getName()
+                << (vfollows ? group.m_bsd.vfollows : group.m_bsd.follows);
+            return false;
+        }
+        if (closes_loop[i])
+        {
+            m_diags.Report(SourceLocation(),
+                           vfollows ? diag::err_section_vfollows_loop
+                                    : diag::err_section_follows_loop)
+                << group.m_section.getName()
+                << groups.at(follows[i]).m_section.getName();
+            return false;
+        }
+    }
+
+    // Move each group that follows another under the group it follows.
+    std::vector<BinGroup*> flat;
+    groups.swap(flat);
+    for (int i=0; i<ngroups; ++i)
+    {
+        if (follows[i] == NO_FOLLOWS)
+            groups.push_back(flat[i]);
+        else
+            flat[follows[i]]->m_follow_groups.push_back(flat[i]);
+    }
+    return true;
+}
 
+bool
+BinLink::DoLink(const IntNum& origin)
+{
     // Create LMA section groups
     for (Object::section_iterator i=m_object.sections_begin(),
          end=m_object.sections_end(); i != end; ++i)
@@ -237,42 +300,10 @@ BinLink::DoLink(const IntNum& origin)
     //  - progbits/nobits setting
     //  - order in the input file
 
-    // Look at each group with follows specified, and find the section
-    // that group is supposed to follow.
-    group = m_lma_groups.begin();
-    while (group != m_lma_groups.end())
-    {
-        if (!group->m_bsd.follows.empty())
-        {
-            BinGroup* found;
-            // Need to find group containing section this section follows.
-            found = FindGroup(m_lma_groups, group->m_bsd.follows);
-            if (!found)
-            {
-                m_diags.Report(SourceLocation(),
-                               diag::err_section_follows_unknown)
-                    << group->m_section.getName()
-                    << group->m_bsd.follows;
-                return false;
-            }
-
-            // Check for loops
-            if (&group->m_section == &found->m_section ||
-                FindGroup(group->m_follow_groups, found->m_section))
-            {
-                m_diags.Report(SourceLocation(), diag::err_section_follows_loop)
-                    << group->m_section.getName()
-                    << found->m_section.getName();
-                return false;
-            }
-
-            // Remove this section from main lma groups list and
-            // add it after the section it's supposed to follow.
-            found->m_follow_groups.push_back(m_lma_groups.detach(group));
-        }
-        else
-            ++group;
-    }
+    // Attach each group with follows specified to the group for the
+    // section it's supposed to follow.
+    if (!LinkFollowGroups(m_lma_groups, false))
+        return false;
 
     // Move BSS sections without a start to the end of the top-level groups
     BinGroups::iterator bss_begin =
@@ -328,43 +359,10 @@ BinLink::DoLink(const IntNum& origin)
         m_vma_groups.push_back(new BinGroup(*i, *bsd));
     }
 
-    // Look at each group with vfollows specified, and find the section
-    // that group is supposed to follow.
-    group = m_vma_groups.begin();
-    while (group != m_vma_groups.end())
-    {
-        if (!group->m_bsd.vfollows.empty())
-        {
-            BinGroup* found;
-            // Need to find group containing section this section follows.
-            found = FindGroup(m_vma_groups, group->m_bsd.vfollows);
-            if (!found)
-            {
-                m_diags.Report(SourceLocation(),
-                               diag::err_section_vfollows_unknown)
-                    << group->m_section.getName()
-                    << group->m_bsd.vfollows;
-                return false;
-            }
-
-            // Check for loops
-            if (&group->m_section == &found->m_section ||
-                FindGroup(group->m_follow_groups, found->m_section))
-            {
-                m_diags.Report(SourceLocation(),
-                               diag::err_section_vfollows_loop)
-                    << group->m_section.getName()
-                    << found->m_section.getName();
-                return false;
-            }
-
-            // Remove this section from main lma groups list and
-            // add it after the section it's supposed to follow.
-            found->m_follow_groups.push_back(m_vma_groups.detach(group));
-        }
-        else
-            ++group;
-    }
+    // Attach each group with vfollows specified to the group for the
+    // section it's supposed to follow.
+    if (!LinkFollowGroups(m_vma_groups, true))
+        return false;
 
     // Due to the combination of steps above, we now know that all top-level
     // groups have integer ivstart:
@@ -424,18 +422,62 @@ BinLink::CheckLMAOverlap(const Section& sect, const Section& other)
     return true;
 }
 
-// Check for LMA overlap using a simple N^2 algorithm.
+namespace {
+struct SectionLMA
+{
+    const Section* sect;
+    const BinSection* bsd;
+    unsigned int order;     // position in object section list
+};
+} // anonymous namespace
+
+static inline bool
+CompareLMA(const SectionLMA& lhs, const SectionLMA& rhs)
+{
+    return (lhs.sect->getLMA() < rhs.sect->getLMA());
+}
+
+// Check for LMA overlap by sweeping the sections in LMA order, keeping the
+// section that reaches furthest so far.
 bool
 BinLink::CheckLMAOverlap()
 {
+    std::vector<SectionLMA> sects;
+    sects.reserve(m_object.getNumSections());
+    unsigned int order = 0;
     for (Object::const_section_iterator i=m_object.sections_begin(),
-         end=m_object.sections_end(); i != end; ++i)
+         end=m_object.sections_end(); i != end; ++i, ++order)
     {
-        for (Object::const_section_iterator j=i+1, end=m_object.sections_end();
-             j != end; ++j)
+        const BinSection* bsd = i->getAssocData<BinSection>();
+        assert(bsd);
+        if (bsd->length.isZero())
+            continue;
+        SectionLMA s = {&(*i), bsd, order};
+        sects.push_back(s);
+    }
+
+    std::stable_sort(sects.begin(), sects.end(), CompareLMA);
+
+    const SectionLMA* reach = 0;
+    IntNum reach_end;
+    for (std::vector<SectionLMA>::const_iterator i=sects.begin(),
+         end=sects.end(); i != end; ++i)
+    {
+        if (reach && i->sect->getLMA() < reach_end)
+        {
+            // Report in section order for consistent diagnostics.
+            if (reach->order < i->order)
+                return CheckLMAOverlap(*reach->sect, *i->sect);
+            else
+                return CheckLMAOverlap(*i->sect, *reach->sect);
+        }
+
+        IntNum sect_end = i->sect->getLMA();
+        sect_end += i->bsd->length;
+        if (!reach || sect_end > reach_end)
         {
-            if (!CheckLMAOverlap(*i, *j))
-                return false;
+            reach = &(*i);
+            reach_end = sect_end;
         }
     }
     return true;
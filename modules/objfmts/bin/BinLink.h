@@ -93,6 +93,7 @@ public:
 
 private:
     bool CreateLMAGroup(Section& sect);
+    bool LinkFollowGroups(BinGroups& groups, bool vfollows);
     bool CheckLMAOverlap(const Section& sect, const Section& other);
 
     void OutputValue(Value& value, Bytes& bytes, unsigned int destsize,
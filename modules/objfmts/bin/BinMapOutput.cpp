@@ -208,44 +208,26 @@ BinMapOutput::OutputSectionsDetail()
     InnerSectionsDetail(m_groups);
 }
 
-static unsigned long
-CountSymbols(const Object& object, const Section* sect)
-{
-    unsigned long count = 0;
-
-    for (Object::const_symbol_iterator sym = object.symbols_begin(),
-         end = object.symbols_end(); sym != end; ++sym)
-    {
-        Location loc;
-        // TODO: autodetect wider size
-        if ((sect == 0 && sym->getEqu()) ||
-            (sym->getLabel(&loc) && loc.bc->getContainer() == sect))
-            count++;
-    }
-
-    return count;
-}
-
 void
-BinMapOutput::OutputSymbols(const Section* sect)
+BinMapOutput::OutputSymbols(const Section* sect, const SymbolList& syms)
 {
-    for (Object::const_symbol_iterator sym = m_object.symbols_begin(),
-         end = m_object.symbols_end(); sym != end; ++sym)
+    for (SymbolList::const_iterator i = syms.begin(), end = syms.end();
+         i != end; ++i)
     {
+        const Symbol* sym = *i;
         const std::string& name = sym->getName();
-        const Expr* equ;
         Location loc;
 
-        if (sect == 0 && (equ = sym->getEqu()))
+        if (sect == 0)
         {
-            std::auto_ptr<Expr> realequ(equ->clone());
+            std::auto_ptr<Expr> realequ(sym->getEqu()->clone());
             realequ->Simplify(m_diags);
             BinSimplify(*realequ);
             realequ->Simplify(m_diags);
             OutputIntNum(realequ->getIntNum());
             m_os << "  " << name << '\n';
         }
-        else if (sym->getLabel(&loc) && loc.bc->getContainer() == sect)
+        else if (sym->getLabel(&loc))
         {
             // Real address
             OutputIntNum(sect->getLMA() + loc.getOffset());
@@ -261,12 +243,15 @@ BinMapOutput::OutputSymbols(const Section* sect)
 }
 
 void
-BinMapOutput::InnerSectionsSymbols(const BinGroups& groups)
+BinMapOutput::InnerSectionsSymbols(const BinGroups& groups,
+                                   const SectionSymbols& sect_syms)
 {
     for (BinGroups::const_iterator group = groups.begin(), end=groups.end();
          group != end; ++group)
     {
-        if (CountSymbols(m_object, &group->m_section) > 0)
+        SectionSymbols::const_iterator syms =
+            sect_syms.find(&group->m_section);
+        if (syms != sect_syms.end())
         {
             llvm::StringRef name = group->m_section.getName();
             m_os << "---- Section " << name << ' ';
@@ -277,12 +262,12 @@ BinMapOutput::InnerSectionsSymbols(const BinGroups& groups)
             m_os << llvm::format("%-*s", m_bytes*2+2, (const char*)"Real");
             m_os << llvm::format("%-*s", m_bytes*2+2, (const char*)"Virtual");
             m_os << "Name\n";
-            OutputSymbols(&group->m_section);
+            OutputSymbols(&group->m_section, syms->second);
             m_os << "\n\n";
         }
 
         // Recurse to loop through follow groups
-        InnerSectionsSymbols(group->m_follow_groups);
+        InnerSectionsSymbols(group->m_follow_groups, sect_syms);
     }
 }
 
@@ -294,12 +279,23 @@ BinMapOutput::OutputSectionsSymbols()
         m_os << '-';
     m_os << "\n\n";
 
-    // We do two passes for EQU and each section; the first pass
-    // determines the byte width to use for the value and whether any
-    // symbols are present, the second pass actually outputs the text.
+    // Bucket symbols by section in a single pass over the symbol table,
+    // keeping symbol table order within each bucket.
+    SymbolList equs;
+    SectionSymbols sect_syms;
+    for (Object::const_symbol_iterator sym = m_object.symbols_begin(),
+         end = m_object.symbols_end(); sym != end; ++sym)
+    {
+        Location loc;
+        // TODO: autodetect wider size
+        if (sym->getEqu())
+            equs.push_back(&(*sym));
+        else if (sym->getLabel(&loc))
+            sect_syms[loc.bc->getContainer()].push_back(&(*sym));
+    }
 
     // EQUs
-    if (CountSymbols(m_object, 0) > 0)
+    if (!equs.empty())
     {
         m_os << "---- No Section ";
         for (int i=0; i<63; ++i)
@@ -307,10 +303,10 @@ BinMapOutput::OutputSectionsSymbols()
         m_os << "\n\n";
         m_os << llvm::format("%-*s", m_bytes*2+2, (const char*)"Value");
         m_os << "Name\n";
-        OutputSymbols(0);
+        OutputSymbols(0, equs);
         m_os << "\n\n";
     }
 
     // Other sections
-    InnerSectionsSymbols(m_groups);
+    InnerSectionsSymbols(m_groups, sect_syms);
 }
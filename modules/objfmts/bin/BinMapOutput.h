@@ -26,6 +26,9 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 //
+#include <map>
+#include <vector>
+
 #include "yasmx/Config/export.h"
 #include "BinLink.h"
 
@@ -35,9 +38,11 @@ namespace llvm { class raw_ostream; }
 namespace yasm
 {
 
+class BytecodeContainer;
 class Diagnostic;
 class IntNum;
 class Object;
+class Symbol;
 
 namespace objfmt
 {
@@ -59,11 +64,15 @@ public:
     void OutputSectionsSymbols();
 
 private:
+    typedef std::vector<const Symbol*> SymbolList;
+    typedef std::map<const BytecodeContainer*, SymbolList> SectionSymbols;
+
     void OutputIntNum(const IntNum& intn);
     void InnerSectionsSummary(const BinGroups& groups);
     void InnerSectionsDetail(const BinGroups& groups);
-    void OutputSymbols(const Section* sect);
-    void InnerSectionsSymbols(const BinGroups& groups);
+    void OutputSymbols(const Section* sect, const SymbolList& syms);
+    void InnerSectionsSymbols(const BinGroups& groups,
+                              const SectionSymbols& sect_syms);
 
     // address width
     int m_bytes;
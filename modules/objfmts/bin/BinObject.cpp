@@ -26,6 +26,9 @@
 //
 #include "BinObject.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "llvm/ADT/Twine.h"
 #include "llvm/Support/raw_ostream.h"
 #include "yasmx/Basic/Diagnostic.h"
@@ -162,11 +165,25 @@ BinOutput::OutputSection(Section& sect, const IntNum& origin)
                 << sect.getName();
             return;
         }
-        m_fd_os.seek(file_start.getUInt());
-        if (m_os.has_error())
+        // Sections are output in LMA order, so usually the stream is
+        // already in position or only a short alignment gap needs to be
+        // filled; only seek (which flushes) for larger jumps.
+        static const unsigned long MAX_PAD = 4096;
+        unsigned long pos = static_cast<unsigned long>(m_fd_os.tell());
+        unsigned long target = file_start.getUInt();
+        if (target > pos && target - pos <= MAX_PAD)
         {
-            Diag(SourceLocation(), diag::err_file_output_seek);
-            return;
+            for (; pos < target; ++pos)
+                m_fd_os << '\0';
+        }
+        else if (target != pos)
+        {
+            m_fd_os.seek(target);
+            if (m_os.has_error())
+            {
+                Diag(SourceLocation(), diag::err_file_output_seek);
+                return;
+            }
         }
 
         outputter = this;
@@ -179,11 +196,88 @@ BinOutput::OutputSection(Section& sect, const IntNum& origin)
     }
 }
 
+// Get the final address of a location, if it is in a section.
+static inline bool
+getLocationAddress(Location loc, /*@out@*/ IntNum* addr)
+{
+    const BytecodeContainer* container = loc.bc->getContainer();
+    if (!container)
+        return false;
+    *addr = container->getSection()->getVMA();
+    *addr += loc.getOffset();
+    return true;
+}
+
+// Get the final value of a symbol that needs no expression evaluation.
+// Follows the same resolution order as the general path in
+// ConvertValueToBytes().
+static bool
+getFixedSymbolValue(const Symbol& sym, /*@out@*/ IntNum* val)
+{
+    Location loc;
+    if (sym.isAbsoluteSymbol())
+    {
+        *val = 0;
+        return true;
+    }
+    if (sym.getLabel(&loc) && getLocationAddress(loc, val))
+        return true;
+    return getBinSSymValue(sym, val);
+}
+
+// Get the final value of a position-fixed value: a constant, optionally
+// plus a label or special symbol, optionally PC-relative.  These make up
+// nearly all values in a flat image and are computed directly, without
+// building and simplifying an expression.
+static bool
+getFixedValue(const Value& value, /*@out@*/ IntNum* val)
+{
+    if (value.isWRT() || value.isSegOf())
+        return false;
+
+    const Expr* abs = value.getAbs();
+    if (abs && !abs->isIntNum())
+        return false;
+
+    if (SymbolRef rel = value.getRelative())
+    {
+        if (!getFixedSymbolValue(*rel, val))
+            return false;
+        if (value.hasSubRelative())
+        {
+            Location sub_loc;
+            IntNum sub;
+            if (!value.getSubLocation(&sub_loc) ||
+                !getLocationAddress(sub_loc, &sub))
+                return false;
+            *val -= sub;
+        }
+    }
+    else if (value.hasSubRelative())
+        return false;
+    else
+        *val = 0;
+
+    if (abs)
+        *val += abs->getIntNum();
+    return true;
+}
+
 bool
 BinOutput::ConvertValueToBytes(Value& value,
                                Location loc,
                                NumericOutput& num_out)
 {
+    IntNum intn;
+    m_object.getArch()->setEndian(num_out.getBytes());
+
+    // Fast path for values with fully known addresses.
+    if (getFixedValue(value, &intn))
+    {
+        num_out.OutputInteger(intn);
+        return true;
+    }
+
     // Binary objects we need to resolve against object, not against section.
     if (value.isRelative())
     {
@@ -218,8 +312,6 @@ done:
     }
 
     // Output
-    IntNum intn;
-    m_object.getArch()->setEndian(num_out.getBytes());
     if (value.OutputBasic(num_out, &intn, getDiagnostics()))
         return true;
 
@@ -255,6 +347,12 @@ CheckSymbol(const Symbol& sym, Diagnostic& diags)
     }
 }
 
+static inline bool
+CompareLMA(const Section* lhs, const Section* rhs)
+{
+    return (lhs->getLMA() < rhs->getLMA());
+}
+
 void
 BinObject::Output(llvm::raw_fd_ostream& os,
                   bool all_syms,
@@ -297,12 +395,19 @@ BinObject::Output(llvm::raw_fd_ostream& os,
     if (!link.CheckLMAOverlap())
         return;
 
-    // Output sections
-    BinOutput out(os, m_object, diags);
+    // Output sections in LMA order to keep file writes sequential.
+    std::vector<Section*> sections;
+    sections.reserve(m_object.getNumSections());
     for (Object::section_iterator i=m_object.sections_begin(),
          end=m_object.sections_end(); i != end; ++i)
+        sections.push_back(&(*i));
+    std::stable_sort(sections.begin(), sections.end(), CompareLMA);
+
+    BinOutput out(os, m_object, diags);
+    for (std::vector<Section*>::iterator i=sections.begin(),
+         end=sections.end(); i != end; ++i)
     {
-        out.OutputSection(*i, origin);
+        out.OutputSection(**i, origin);
     }
 }
 
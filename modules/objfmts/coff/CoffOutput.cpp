@@ -26,8 +26,6 @@
 //
 #include "CoffObject.h"
 
-#include <cstdlib>
-#include <ctime>
 #include <vector>
 
 #include "llvm/Support/raw_ostream.h"
@@ -513,7 +511,8 @@ CoffObject::Output(llvm::raw_fd_ostream& os,
     // Update file symbol filename
     assert(m_file_coffsym != 0);
     m_file_coffsym->m_aux.resize(1);
-    m_file_coffsym->m_aux[0].fname = m_object.getSourceFilename();
+    m_file_coffsym->m_aux[0].fname =
+        m_object.RemapPath(m_object.getSourceFilename());
 
     // Number sections and determine each section's addr values.
     // The latter is needed in VMA case before actually outputting
@@ -590,12 +589,7 @@ CoffObject::Output(llvm::raw_fd_ostream& os,
     bytes.setLittleEndian();
     Write16(bytes, m_machine);          // magic number
     Write16(bytes, scnum-1);            // number of sects
-    unsigned long ts;
-    if (std::getenv("YASM_TEST_SUITE"))
-        ts = 0;
-    else
-        ts = static_cast<unsigned long>(std::time(NULL));
-    Write32(bytes, ts);                 // time/date stamp
+    Write32(bytes, m_object.getTimestamp());    // time/date stamp
     Write32(bytes, symtab_pos);         // file ptr to symtab
     Write32(bytes, symtab_count);       // number of symtabs
     Write16(bytes, 0);                  // size of optional header (none)
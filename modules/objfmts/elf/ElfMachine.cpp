@@ -49,6 +49,7 @@ static const MachineCheckCreate machines[] =
 {
     {&impl::ElfMatch_x86_x86, &impl::ElfCreate_x86_x86},
     {&impl::ElfMatch_x86_amd64, &impl::ElfCreate_x86_amd64},
+    {&impl::ElfMatch_x86_x32, &impl::ElfCreate_x86_x32},
 };
 static const size_t nmachines = sizeof(machines)/sizeof(machines[0]);
 
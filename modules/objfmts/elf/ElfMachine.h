@@ -26,6 +26,7 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 //
+#include <cstring>
 #include <memory>
 #include <string>
 
@@ -85,6 +86,15 @@ isWRTElfSymRelative(const Symbol& wrt)
     return ssym->sym_relative;
 }
 
+inline bool
+isWRTElfPLT(const Symbol& wrt)
+{
+    const ElfSpecialSymbol* ssym = wrt.getAssocData<ElfSpecialSymbol>();
+    if (!ssym)
+        return false;
+    return std::strcmp(ssym->name, "plt") == 0;
+}
+
 inline bool
 isWRTElfPosAdjusted(const Symbol& wrt)
 {
@@ -130,9 +140,13 @@ bool ElfMatch_x86_x86(llvm::StringRef arch_keyword,
 bool ElfMatch_x86_amd64(llvm::StringRef arch_keyword,
                         llvm::StringRef arch_machine,
                         ElfClass cls);
+bool ElfMatch_x86_x32(llvm::StringRef arch_keyword,
+                      llvm::StringRef arch_machine,
+                      ElfClass cls);
 
 std::auto_ptr<ElfMachine> ElfCreate_x86_x86();
 std::auto_ptr<ElfMachine> ElfCreate_x86_amd64();
+std::auto_ptr<ElfMachine> ElfCreate_x86_x32();
 } // namespace impl
 
 }} // namespace yasm::objfmt
@@ -42,6 +42,8 @@
 //
 #include "ElfObject.h"
 
+#include <map>
+
 #include "llvm/ADT/SmallString.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
@@ -84,6 +86,19 @@ isLocal(const Symbol& sym)
     return (vis == Symbol::LOCAL || (vis & Symbol::DLOCAL) != 0);
 }
 
+// Determine if references to a global symbol always resolve to its
+// definition in this object.  Weak definitions may be overridden at link
+// time even if hidden.
+static bool
+isNonPreemptible(const Symbol& sym)
+{
+    const ElfSymbol* elfsym = sym.getAssocData<ElfSymbol>();
+    if (!elfsym || elfsym->getBinding() != STB_GLOBAL)
+        return false;
+    ElfSymbolVis vis = elfsym->getVisibility();
+    return vis == STV_HIDDEN || vis == STV_INTERNAL;
+}
+
 static inline bool
 byIndex(const Symbol& s1, const Symbol& s2)
 {
@@ -143,7 +158,10 @@ Elf32Object::~Elf32Object()
 bool
 Elf32Object::isOkObject(Object& object)
 {
-    return isOkElfMachine(*object.getArch(), ELFCLASS32);
+    // 64-bit code in a 32-bit ELF file is the x32 ABI; ask for it with
+    // elfx32 rather than getting it by accident.
+    return isOkElfMachine(*object.getArch(), ELFCLASS32) &&
+        !object.getArch()->getMachine().equals_lower("amd64");
 }
 
 Elf64Object::~Elf64Object()
@@ -156,6 +174,17 @@ Elf64Object::isOkObject(Object& object)
     return isOkElfMachine(*object.getArch(), ELFCLASS64);
 }
 
+ElfX32Object::~ElfX32Object()
+{
+}
+
+bool
+ElfX32Object::isOkObject(Object& object)
+{
+    return isOkElfMachine(*object.getArch(), ELFCLASS32) &&
+        object.getArch()->getMachine().equals_lower("amd64");
+}
+
 static bool
 TasteCommon(const llvm::MemoryBuffer& in,
             /*@out@*/ std::string* arch_keyword,
@@ -194,7 +223,8 @@ Elf32Object::Taste(const llvm::MemoryBuffer& in,
                    /*@out@*/ std::string* arch_keyword,
                    /*@out@*/ std::string* machine)
 {
-    return TasteCommon(in, arch_keyword, machine, ELFCLASS32);
+    return TasteCommon(in, arch_keyword, machine, ELFCLASS32) &&
+        *machine != "amd64";
 }
 
 bool
@@ -205,6 +235,15 @@ Elf64Object::Taste(const llvm::MemoryBuffer& in,
     return TasteCommon(in, arch_keyword, machine, ELFCLASS64);
 }
 
+bool
+ElfX32Object::Taste(const llvm::MemoryBuffer& in,
+                    /*@out@*/ std::string* arch_keyword,
+                    /*@out@*/ std::string* machine)
+{
+    return TasteCommon(in, arch_keyword, machine, ELFCLASS32) &&
+        *machine == "amd64";
+}
+
 static inline bool
 LoadStringTable(StringTable* strtab,
                 const llvm::MemoryBuffer& in,
@@ -392,6 +431,7 @@ ElfObject::InitSymbols(llvm::StringRef parser)
 {
     // Set object options
     m_object.getOptions().DisableGlobalSubRelative = true;
+    m_object.getOptions().AddressSize = (m_config.cls == ELFCLASS32) ? 32 : 64;
 
     // Add .file symbol
     SymbolRef filesym = m_object.AppendSymbol(".file");
@@ -865,6 +905,21 @@ ElfOutput::ConvertValueToBytes(Value& value,
             return false;
         }
 
+        // A PC-relative reference to a symbol in this section that can't
+        // be preempted is a constant.  A PLT reference to it would be
+        // resolved directly by the linker, so it is a constant too.
+        Location symloc;
+        if (pc_rel && !m_object.getConfig().KeepPCRelRelocs
+            && (!wrt || isWRTElfPLT(*wrt))
+            && isNonPreemptible(*sym) && sym->getLabel(&symloc)
+            && symloc.bc->getContainer() == loc.bc->getContainer())
+        {
+            intn += symloc.getOffset();
+            intn -= loc.getOffset();
+            num_out.OutputInteger(intn);
+            return true;
+        }
+
         // Create relocation
         Section* sect = loc.bc->getContainer()->getSection();
         std::auto_ptr<ElfReloc> reloc =
@@ -1042,7 +1097,8 @@ ElfObject::Output(llvm::raw_fd_ostream& os,
     // Add filename to strtab and set as .file symbol name
     if (m_file_elfsym)
     {
-        m_file_elfsym->setName(strtab.getIndex(m_object.getSourceFilename()));
+        m_file_elfsym->setName(strtab.getIndex(
+            m_object.RemapPath(m_object.getSourceFilename())));
     }
 
     // Create .note.GNU-stack if we need to advise linker about executable
@@ -1069,6 +1125,10 @@ ElfObject::Output(llvm::raw_fd_ostream& os,
         }
     }
 
+    // Record the processor features used by the code.
+    if (oconfig.CodeProperties)
+        AppendCodeProperties(diags);
+
     // Allocate space for Ehdr by seeking forward
     os.seek(m_config.getProgramHeaderSize());
     if (os.has_error())
@@ -1183,6 +1243,19 @@ ElfObject::Output(llvm::raw_fd_ostream& os,
         FinalizeSymbol(*i, strtab, all_syms, diags);
     }
 
+    // Give global code labels function types and sizes.  This follows
+    // symbol finalization so types and sizes given with global take
+    // precedence.
+    if (m_object.getConfig().FunctionSizes)
+    {
+        for (Object::section_iterator i=m_object.sections_begin(),
+             end=m_object.sections_end(); i != end; ++i)
+        {
+            if (i->isCode() && i->bytecodes_begin() != i->bytecodes_end())
+                InferFunctionSizes(*i);
+        }
+    }
+
     // Number user sections (numbering required for group sections).
     for (Object::section_iterator i=m_object.sections_begin(),
          end=m_object.sections_end(); i != end; ++i)
@@ -1386,6 +1459,83 @@ ElfObject::AddDefaultSection()
     return section;
 }
 
+void
+ElfObject::InferFunctionSizes(Section& sect)
+{
+    // Global labels by offset; labels at the same offset are aliases
+    // and get the same size.
+    std::multimap<unsigned long, SymbolRef> labels;
+    for (Object::symbol_iterator sym = m_object.symbols_begin(),
+         end = m_object.symbols_end(); sym != end; ++sym)
+    {
+        Location loc;
+        if ((sym->getVisibility() & Symbol::GLOBAL) == 0 ||
+            !sym->getLabel(&loc) || loc.bc->getContainer() != &sect ||
+            SymbolRef(&*sym) == sect.getSymbol())
+            continue;
+        labels.insert(std::make_pair(loc.getOffset(), SymbolRef(&*sym)));
+    }
+
+    unsigned long sect_end = sect.bytecodes_back().getNextOffset();
+    for (std::multimap<unsigned long, SymbolRef>::const_iterator
+         i=labels.begin(), end=labels.end(); i != end; ++i)
+    {
+        std::multimap<unsigned long, SymbolRef>::const_iterator next =
+            labels.upper_bound(i->first);
+        unsigned long size =
+            (next == end ? sect_end : next->first) - i->first;
+        if (size == 0)
+            continue;
+
+        // Explicit .type and .size take precedence.
+        ElfSymbol& elfsym = BuildSymbol(*i->second);
+        if (elfsym.hasType() && elfsym.getType() != STT_FUNC)
+            continue;
+        elfsym.setType(STT_FUNC);
+        if (!elfsym.hasSize())
+            elfsym.setSize(Expr(IntNum(size)), SourceLocation());
+    }
+}
+
+void
+ElfObject::AppendCodeProperties(Diagnostic& diags)
+{
+    std::vector<Arch::CodeProperty> props;
+    m_object.getArch()->getCodeProperties(props);
+    if (props.empty())
+        return;
+
+    // Don't second-guess a hand-written note.
+    if (m_object.FindSection(".note.gnu.property"))
+    {
+        diags.Report(SourceLocation(), diag::warn_gnu_property_exists);
+        return;
+    }
+
+    Section* note = AppendSection(".note.gnu.property", SourceLocation(),
+                                  diags);
+    unsigned int align = (m_config.cls == ELFCLASS32) ? 4 : 8;
+    note->setAlign(align);
+    note->getAssocData<ElfSection>()->setTypeFlags(SHT_NOTE, SHF_ALLOC);
+
+    // Each property is a 4-byte type, data size, and data, padded to the
+    // note alignment.
+    EndianState endian;
+    m_config.setEndian(endian);
+    AppendData(*note, 4, 4, endian);                        // name size
+    AppendData(*note, props.size()*(8+align), 4, endian);   // desc size
+    AppendData(*note, NT_GNU_PROPERTY_TYPE_0, 4, endian);   // type
+    AppendData(*note, "GNU", 4, true);                      // name
+    for (std::vector<Arch::CodeProperty>::const_iterator i=props.begin(),
+         end=props.end(); i != end; ++i)
+    {
+        AppendData(*note, i->first, 4, endian);     // pr_type
+        AppendData(*note, 4, 4, endian);            // pr_datasz
+        AppendData(*note, i->second, align, endian);// pr_data and padding
+    }
+    note->UpdateOffsets(diags);
+}
+
 Section*
 ElfObject::AppendSection(llvm::StringRef name,
                          SourceLocation source,
@@ -2087,4 +2237,6 @@ yasm_objfmt_elf_DoRegister()
                    ObjectFormatModuleImpl<Elf32Object> >("elf32");
     RegisterModule<ObjectFormatModule,
                    ObjectFormatModuleImpl<Elf64Object> >("elf64");
+    RegisterModule<ObjectFormatModule,
+                   ObjectFormatModuleImpl<ElfX32Object> >("elfx32");
 }
@@ -197,6 +197,12 @@ enum ElfSectionIndexValues
 };
 typedef unsigned int ElfSectionIndex;
 
+// elf note types - GNU namespace
+enum ElfNoteType
+{
+    NT_GNU_PROPERTY_TYPE_0 = 5  // program property
+};
+
 // elf symbol binding - index of visibility/behavior
 enum ElfSymbolBinding
 {
@@ -57,6 +57,8 @@ public:
 class Elf_x86_amd64 : public ElfMachine
 {
 public:
+    /// @param x32      x32 ABI (ELFCLASS32 with 64-bit code)
+    explicit Elf_x86_amd64(bool x32) : m_x32(x32) {}
     ~Elf_x86_amd64() {}
 
     void Configure(ElfConfig* config) const;
@@ -78,6 +80,9 @@ public:
     {
         return std::auto_ptr<ElfReloc>(new ElfReloc_x86_amd64(sym, addr));
     }
+
+private:
+    bool m_x32;
 };
 } // anonymous namespace
 
@@ -94,13 +99,30 @@ impl::ElfMatch_x86_amd64(llvm::StringRef arch_keyword,
 std::auto_ptr<ElfMachine>
 impl::ElfCreate_x86_amd64()
 {
-    return std::auto_ptr<ElfMachine>(new Elf_x86_amd64);
+    return std::auto_ptr<ElfMachine>(new Elf_x86_amd64(false));
+}
+
+bool
+impl::ElfMatch_x86_x32(llvm::StringRef arch_keyword,
+                       llvm::StringRef arch_machine,
+                       ElfClass cls)
+{
+    return (arch_keyword.equals_lower("x86") &&
+            arch_machine.equals_lower("amd64") &&
+            cls == ELFCLASS32);
+}
+
+std::auto_ptr<ElfMachine>
+impl::ElfCreate_x86_x32()
+{
+    return std::auto_ptr<ElfMachine>(new Elf_x86_amd64(true));
 }
 
 void
 Elf_x86_amd64::Configure(ElfConfig* config) const
 {
-    config->cls = ELFCLASS64;
+    // x32 uses the x86-64 machine and relocations in 32-bit ELF files.
+    config->cls = m_x32 ? ELFCLASS32 : ELFCLASS64;
     config->encoding = ELFDATA2LSB;
     config->osabi = ELFOSABI_SYSV;
     config->abi_version = 0;
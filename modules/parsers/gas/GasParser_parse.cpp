@@ -41,6 +41,7 @@
 #include "yasmx/Arch.h"
 #include "yasmx/Bytecode.h"
 #include "yasmx/BytecodeContainer.h"
+#include "yasmx/CodeProfile.h"
 #include "yasmx/Expr_util.h"
 #include "yasmx/Object.h"
 #include "yasmx/Section.h"
@@ -115,9 +116,11 @@ next:
                 // Label
                 SourceLocation id_source = ConsumeToken();
                 ConsumeToken(); // consume the colon too
-                ParseSymbol(ii)->CheckedDefineLabel(m_container->getEndLoc(),
-                                                    id_source,
-                                                    m_preproc.getDiagnostics());
+                SymbolRef sym = ParseSymbol(ii);
+                AppendProfileAlign(*m_object, *m_container, sym->getName(),
+                                   id_source);
+                sym->CheckedDefineLabel(m_container->getEndLoc(), id_source,
+                                        m_preproc.getDiagnostics());
                 goto next;
             }
             else if (peek_token.is(GasToken::equal))
@@ -2603,6 +2606,7 @@ void
 GasParser::DefineLabel(llvm::StringRef name, SourceLocation source)
 {
     SymbolRef sym = m_object->getSymbol(name);
+    AppendProfileAlign(*m_object, *m_container, name, source);
     sym->CheckedDefineLabel(m_container->getEndLoc(), source,
                             m_preproc.getDiagnostics());
 }
@@ -28,7 +28,6 @@
 
 #include "config.h"
 
-#include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
 
@@ -45,7 +44,6 @@
 
 #include "nasm.h"
 #include "nasmlib.h"
-#include "nasm-eval.h"
 #include "nasm-pp.h"
 
 #include "nasm-macros.i"
@@ -53,40 +51,6 @@
 using namespace yasm;
 using namespace yasm::parser;
 
-static unsigned int nasm_errors;
-
-static void
-nasm_efunc(int severity, const char *fmt, ...)
-{
-    va_list va;
-
-    fprintf(stderr, "%s:%ld: ", nasm::nasm_src_get_fname(),
-            nasm::nasm_src_get_linnum());
-
-    va_start(va, fmt);
-    switch (severity & ERR_MASK) {
-        case ERR_WARNING:
-            vfprintf(stderr, fmt, va);
-            fputc('\n', stderr);
-            break;
-        case ERR_NONFATAL:
-            vfprintf(stderr, fmt, va);
-            fputc('\n', stderr);
-            ++nasm_errors;
-            break;
-        case ERR_FATAL:
-        case ERR_PANIC:
-            vfprintf(stderr, fmt, va);
-            fputc('\n', stderr);
-            exit(1);
-            /*@notreached@*/
-            break;
-        case ERR_DEBUG:
-            break;
-    }
-    va_end(va);
-}
-
 NasmParser::NasmParser(const ParserModule& module,
                        Diagnostic& diags,
                        SourceManager& sm,
@@ -132,11 +96,9 @@ NasmParser::Parse(Object& object, Directives& dirs, Diagnostic& diags)
 
 #if 1
     // XXX: HACK: run through nasm preproc and replace main file contents
-    nasm::yasm_preproc = &m_preproc;
-    nasm::yasm_object = &object;
+    nasm::Preproc& nasmpp = m_nasm_preproc.getNasmPreproc();
     SourceManager& sm = m_preproc.getSourceManager();
-    nasm_errors = 0;
-    nasm::nasmpp.reset(sm.getMainFileID(), 2, nasm_efunc, nasm::nasm_evaluate, nasm::setfuncs);
+    nasmpp.reset(sm.getMainFileID(), 2, &object);
 
     // pass down command line options
     for (std::vector<NasmPreproc::Predef>::iterator
@@ -148,16 +110,16 @@ NasmParser::Parse(Object& object, Directives& dirs, Diagnostic& diags)
         switch (i->m_type)
         {
             case NasmPreproc::Predef::PREINC:
-                nasm::pp_pre_include(def);
+                nasmpp.pre_include(def);
                 break;
             case NasmPreproc::Predef::PREDEF:
-                nasm::pp_pre_define(def);
+                nasmpp.pre_define(def);
                 break;
             case NasmPreproc::Predef::UNDEF:
-                nasm::pp_pre_undefine(def);
+                nasmpp.pre_undefine(def);
                 break;
             case NasmPreproc::Predef::BUILTIN:
-                nasm::pp_builtin_define(def);
+                nasmpp.builtin_define(def);
                 break;
         }
     }
@@ -189,21 +151,21 @@ NasmParser::Parse(Object& object, Directives& dirs, Diagnostic& diags)
             PACKAGE_VERSION);
     nasm_version_mac[7] = NULL;
     // NOTE: useful
-    nasm::pp_extra_stdmac(const_cast<const char**>(nasm_version_mac));
+    nasmpp.extra_stdmac(const_cast<const char**>(nasm_version_mac));
 
     // add standard macros
     // NOTE: useful
-    nasm::pp_extra_stdmac(nasm_standard_mac);
+    nasmpp.extra_stdmac(nasm_standard_mac);
 
     // preprocess input
     std::string result;
     long prior_linnum = 0;
     char *file_name = 0;
     int lineinc = 0;
-    while (char* line = nasm::nasmpp.getline())
+    while (char* line = nasmpp.getline())
     {
         long linnum = prior_linnum += lineinc;
-        int altline = nasm::nasm_src_get(&linnum, &file_name);
+        int altline = nasmpp.src_get(&linnum, &file_name);
         if (altline != 0) {
             lineinc = (altline != -1 || lineinc != 1);
             llvm::SmallString<64> linestr;
@@ -217,10 +179,10 @@ NasmParser::Parse(Object& object, Directives& dirs, Diagnostic& diags)
         result += line;
         result += '\n';
     }
-    nasm::nasmpp.cleanup(1);
+    nasmpp.cleanup(1);
     for (int i=0; i<7; ++i)
         delete[] nasm_version_mac[i];
-    if (nasm_errors > 0)
+    if (nasmpp.get_error_count() > 0)
     {
         diags.Report(SourceLocation(), diag::fatal_pp_errors);
         return;
@@ -41,6 +41,7 @@
 #include "yasmx/BytecodeContainer.h"
 #include "yasmx/Bytes.h"
 #include "yasmx/Bytes_util.h"
+#include "yasmx/CodeProfile.h"
 #include "yasmx/EffAddr.h"
 #include "yasmx/Expr.h"
 #include "yasmx/Object.h"
@@ -1762,6 +1763,7 @@ NasmParser::DefineLabel(SymbolRef sym, SourceLocation source, bool local)
         sym->CheckedDefineEqu(m_abspos, source, m_preproc.getDiagnostics());
     else
     {
+        AppendProfileAlign(*m_object, *m_container, sym->getName(), source);
         m_bc = &m_container->FreshBytecode();
         sym->CheckedDefineLabel(m_container->getEndLoc(), source,
                                 m_preproc.getDiagnostics());
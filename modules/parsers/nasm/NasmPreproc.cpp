@@ -31,6 +31,7 @@
 #include "NasmPreproc.h"
 
 #include "NasmLexer.h"
+#include "nasm-pp.h"
 
 
 using namespace yasm;
@@ -40,6 +41,7 @@ NasmPreproc::NasmPreproc(Diagnostic& diags,
                          SourceManager& sm,
                          HeaderSearch& headers)
     : Preprocessor(diags, sm, headers)
+    , m_nasmpp(new nasm::Preproc(*this))
 {
 }
 
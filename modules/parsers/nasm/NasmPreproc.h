@@ -33,7 +33,9 @@
 #include "yasmx/Basic/SourceLocation.h"
 #include "yasmx/Config/export.h"
 #include "yasmx/Parse/Preprocessor.h"
+#include "yasmx/Support/scoped_ptr.h"
 
+namespace nasm { class Preproc; }
 
 namespace yasm
 {
@@ -62,6 +64,10 @@ public:
 
     std::vector<Predef> m_predefs;
 
+    /// Get the NASM preprocessor.  All of its state is owned by this
+    /// instance, so separate instances may be used concurrently.
+    nasm::Preproc& getNasmPreproc() { return *m_nasmpp; }
+
 protected:
     virtual void RegisterBuiltinMacros();
     virtual Lexer* CreateLexer(FileID fid,
@@ -74,6 +80,8 @@ private:
     IdentifierInfo *m_BITS;           // __BITS__
 
     SourceLocation m_DATE_loc, m_TIME_loc;
+
+    util::scoped_ptr<nasm::Preproc> m_nasmpp;
 };
 
 }} // namespace yasm::parser
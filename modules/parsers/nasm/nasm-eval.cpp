@@ -8,6 +8,7 @@
  * initial version 27/iii/95 by Simon Tatham
  */
 #include <cctype>
+#include <limits>
 
 #include "yasmx/Expr.h"
 #include "yasmx/IntNum.h"
@@ -24,33 +25,182 @@ using yasm::IntNum;
 
 namespace nasm {
 
-/* The assembler object (for symbol table). */
-yasm::Object *yasm_object;
+/*
+ * Value of a (sub)expression.  Preprocessor expressions are nearly
+ * always plain integer arithmetic (%assign counters, %if and %rep
+ * conditions), so integers are computed natively.  The value is only
+ * turned into an Expr once it needs something native arithmetic can't
+ * provide: a symbol, a result that doesn't fit in a long, or a division
+ * by zero (which is then diagnosed when the caller simplifies the Expr).
+ */
+class EvalValue
+{
+public:
+    EvalValue() : m_native(true), m_val(0) {}
+
+    void setInt(const IntNum& intn);
+    void setSymbol(yasm::SymbolRef sym);
+
+    /* Get the value as an Expr, converting it if necessary. */
+    Expr& getExpr();
+
+    void Calc(yasm::Op::Op op, EvalValue& rhs);
+    void Calc(yasm::Op::Op op);
+    void Cond(EvalValue& t, EvalValue& f);
+
+private:
+    bool CalcNative(yasm::Op::Op op, long rhs);
 
-static scanner scan;    /* Address of scanner routine */
-static efunc error;     /* Address of error reporting routine */
-static curl_eval curly_evaluator; /*curly structure processor func*/
-static ppdir_eval ppdir_evaluator;/* %ifdir expression (without the
-                                    curly structure) handler */
+    bool m_native;      /* value is m_val, not m_expr */
+    long m_val;
+    Expr m_expr;
+};
 
-void setfuncs(scanner sc,efunc errfunc, curl_eval curl_evalfunc, ppdir_eval ppdirfunc)
+void EvalValue::setInt(const IntNum& intn)
 {
-    scan = sc;
-    error = errfunc;
-    curly_evaluator = curl_evalfunc;
-    ppdir_evaluator = ppdirfunc;
+    if (intn.isInt()) {
+        m_native = true;
+        m_val = intn.getInt();
+    } else {
+        m_native = false;
+        m_expr = Expr(intn);
+    }
 }
 
-static struct tokenval *tokval;   /* The current token */
-static int i;                     /* The t_type of tokval */
+void EvalValue::setSymbol(yasm::SymbolRef sym)
+{
+    m_native = false;
+    m_expr = Expr(sym);
+}
 
-static void *scpriv;
+Expr& EvalValue::getExpr()
+{
+    if (m_native) {
+        m_expr = Expr(IntNum(m_val));
+        m_native = false;
+    }
+    return m_expr;
+}
+
+/*
+ * Perform op natively, giving the same result as IntNum would.  Returns
+ * false (leaving the value untouched) if the result can't be computed
+ * natively.
+ */
+bool EvalValue::CalcNative(yasm::Op::Op op, long rhs)
+{
+    static const long LMAX = std::numeric_limits<long>::max();
+    static const long LMIN = std::numeric_limits<long>::min();
+    static const long LBITS = std::numeric_limits<unsigned long>::digits;
+    static const long LHALF = 1L << (LBITS/2 - 1);
+    long lhs = m_val;
+
+    switch (op) {
+      case yasm::Op::ADD:
+        if ((rhs > 0 && lhs > LMAX-rhs) || (rhs < 0 && lhs < LMIN-rhs))
+            return false;
+        m_val = lhs + rhs;
+        break;
+      case yasm::Op::SUB:
+        if ((rhs < 0 && lhs > LMAX+rhs) || (rhs > 0 && lhs < LMIN+rhs))
+            return false;
+        m_val = lhs - rhs;
+        break;
+      case yasm::Op::MUL:
+        /* half range */
+        if (lhs <= -LHALF || lhs >= LHALF || rhs <= -LHALF || rhs >= LHALF)
+            return false;
+        m_val = lhs * rhs;
+        break;
+      case yasm::Op::DIV:
+      case yasm::Op::SIGNDIV:
+        if (rhs == 0 || (lhs == LMIN && rhs == -1))
+            return false;
+        m_val = lhs / rhs;
+        break;
+      case yasm::Op::MOD:
+      case yasm::Op::SIGNMOD:
+        if (rhs == 0 || (lhs == LMIN && rhs == -1))
+            return false;
+        m_val = lhs % rhs;
+        break;
+      case yasm::Op::NEG:
+        if (lhs == LMIN)
+            return false;
+        m_val = -lhs;
+        break;
+      case yasm::Op::NOT:   m_val = ~lhs; break;
+      case yasm::Op::OR:    m_val = lhs | rhs; break;
+      case yasm::Op::AND:   m_val = lhs & rhs; break;
+      case yasm::Op::XOR:   m_val = lhs ^ rhs; break;
+      case yasm::Op::SHL:
+        if (rhs < 0 || rhs >= LBITS-1 ||
+            ((lhs << rhs) >> rhs) != lhs)
+            return false;
+        m_val = lhs << rhs;
+        break;
+      case yasm::Op::SHR:
+        if (rhs < 0 || rhs >= LBITS)
+            return false;
+        m_val = lhs >> rhs;
+        break;
+      case yasm::Op::LOR:   m_val = (lhs || rhs); break;
+      case yasm::Op::LAND:  m_val = (lhs && rhs); break;
+      case yasm::Op::LNOT:  m_val = !lhs; break;
+      case yasm::Op::LXOR:  m_val = (!!lhs ^ !!rhs); break;
+      case yasm::Op::EQ:    m_val = (lhs == rhs); break;
+      case yasm::Op::LT:    m_val = (lhs < rhs); break;
+      case yasm::Op::GT:    m_val = (lhs > rhs); break;
+      case yasm::Op::LE:    m_val = (lhs <= rhs); break;
+      case yasm::Op::GE:    m_val = (lhs >= rhs); break;
+      case yasm::Op::NE:    m_val = (lhs != rhs); break;
+      default:
+        return false;
+    }
+    return true;
+}
+
+void EvalValue::Calc(yasm::Op::Op op, EvalValue& rhs)
+{
+    if (m_native && rhs.m_native && CalcNative(op, rhs.m_val))
+        return;
+    getExpr().Calc(op, rhs.getExpr());
+}
+
+void EvalValue::Calc(yasm::Op::Op op)
+{
+    if (m_native && CalcNative(op, 0))
+        return;
+    getExpr().Calc(op);
+}
+
+/*
+ * Replace the value (the condition) with t if nonzero, or f if zero.
+ */
+void EvalValue::Cond(EvalValue& t, EvalValue& f)
+{
+    if (m_native && t.m_native && f.m_native) {
+        m_val = m_val ? t.m_val : f.m_val;
+        return;
+    }
+    /*
+     * yasm-nextgen currently has no handler for ternary operators
+     * so the e->Calc approach cannot be used here and the stuffs
+     * inside e->Calc is directly done here. Might not worth
+     * fixing anyway since the ?: is probably the only ternary
+     * operator that will be supported by yasm-nextgen
+     */
+    Expr& e = getExpr();
+    e.Append(t.getExpr());
+    e.Append(f.getExpr());
+    e.AppendOp(yasm::Op::COND, 3);
+}
 
 /*
  * Recursive-descent parser. Called with a single boolean operand,
  * which is TRUE if the evaluation is critical (i.e. unresolved
- * symbols are an error condition). Must update the global `i' to
- * reflect the token after the parsed string. May return NULL.
+ * symbols are an error condition). Must update `i' to reflect the
+ * token after the parsed string. May return NULL.
  *
  * evaluate() should report its own errors: on return it is assumed
  * that if NULL has been returned, the error has already been
@@ -80,13 +230,34 @@ static void *scpriv;
  *       | number
  */
 
-static bool rexpc(Expr*);
-static bool rexp0(Expr*), rexp1(Expr*), rexp2(Expr*), rexp3(Expr*);
+/*
+ * The state of a single evaluation. Nested evaluations (from within
+ * {%ppdir} structures) get their own, so they can't disturb the
+ * token position of the expression that contains them.
+ */
+class Evaluator
+{
+public:
+    Evaluator(EvalClient& client, yasm::Object* object, void* scprivate,
+              struct tokenval* tv, int critical);
+    bool evaluate(EvalValue* e) { return (this->*bexpr)(e); }
+
+private:
+    bool rexpc(EvalValue*);
+    bool rexp0(EvalValue*), rexp1(EvalValue*), rexp2(EvalValue*);
+    bool rexp3(EvalValue*);
 
-static bool expr0(Expr*), expr1(Expr*), expr2(Expr*), expr3(Expr*);
-static bool expr4(Expr*), expr5(Expr*), expr6(Expr*);
+    bool expr0(EvalValue*), expr1(EvalValue*), expr2(EvalValue*);
+    bool expr3(EvalValue*), expr4(EvalValue*), expr5(EvalValue*);
+    bool expr6(EvalValue*);
 
-static bool (*bexpr)(Expr*);
+    EvalClient& client;
+    yasm::Object* yasm_object;      /* The assembler object (for symbol table) */
+    struct tokenval *tokval;        /* The current token */
+    int i;                          /* The t_type of tokval */
+    void *scpriv;
+    bool (Evaluator::*bexpr)(EvalValue*);
+};
 
 
 /*
@@ -94,14 +265,14 @@ static bool (*bexpr)(Expr*);
  * !? is chosen instead of ? because ? can be recognised as a part or
  * the beginning of an identifier in the nasm language.
  */
-static bool rexpc(Expr* e)
+bool Evaluator::rexpc(EvalValue* e)
 {
     if (!rexp0(e))
         return false;
     while (i == TOKEN_TERN)
     {
-        i = scan(scpriv, tokval);
-        Expr f, f2;
+        i = client.scan(scpriv, tokval);
+        EvalValue f, f2;
         if (!rexp1(&f))
             return false;
         if (i != ':') {
@@ -111,36 +282,27 @@ static bool rexpc(Expr* e)
              * float comes before :, then the following error line
              * will be reported, which seems inappropriate.
              */
-            error(ERR_FATAL, "expecting `:'");
+            client.report(ERR_FATAL, "expecting `:'");
             return false;
         }
-        i = scan(scpriv, tokval);
+        i = client.scan(scpriv, tokval);
         if (!rexp1(&f2))
             return false;
-        /*
-         * yasm-nextgen currently has no handler for ternary operators
-         * so the e->Calc approach cannot be used here and the stuffs
-         * inside e->Calc is directly done here. Might not worth
-         * fixing anyway since the ?: is probably the only ternary
-         * operator that will be supported by yasm-nextgen
-         */
-        e->Append(f);
-        e->Append(f2);
-        e->AppendOp(yasm::Op::COND, 3);
+        e->Cond(f, f2);
 
     }
     return true;
 }
 
-static bool rexp0(Expr* e)
+bool Evaluator::rexp0(EvalValue* e)
 {
     if (!rexp1(e))
         return false;
 
     while (i == TOKEN_DBL_OR)
     {
-        i = scan(scpriv, tokval);
-        Expr f;
+        i = client.scan(scpriv, tokval);
+        EvalValue f;
         if (!rexp1(&f))
             return false;
 
@@ -149,15 +311,15 @@ static bool rexp0(Expr* e)
     return true;
 }
 
-static bool rexp1(Expr* e)
+bool Evaluator::rexp1(EvalValue* e)
 {
     if (!rexp2(e))
         return false;
 
     while (i == TOKEN_DBL_XOR)
     {
-        i = scan(scpriv, tokval);
-        Expr f;
+        i = client.scan(scpriv, tokval);
+        EvalValue f;
         if (!rexp2(&f))
             return false;
 
@@ -166,14 +328,14 @@ static bool rexp1(Expr* e)
     return true;
 }
 
-static bool rexp2(Expr* e)
+bool Evaluator::rexp2(EvalValue* e)
 {
     if (!rexp3(e))
         return false;
     while (i == TOKEN_DBL_AND)
     {
-        i = scan(scpriv, tokval);
-        Expr f;
+        i = client.scan(scpriv, tokval);
+        EvalValue f;
         if (!rexp3(&f))
             return false;
 
@@ -182,7 +344,7 @@ static bool rexp2(Expr* e)
     return true;
 }
 
-static bool rexp3(Expr* e)
+bool Evaluator::rexp3(EvalValue* e)
 {
     if (!expr0(e))
         return false;
@@ -191,8 +353,8 @@ static bool rexp3(Expr* e)
            i == TOKEN_NE || i == TOKEN_LE || i == TOKEN_GE)
     {
         int j = i;
-        i = scan(scpriv, tokval);
-        Expr f;
+        i = client.scan(scpriv, tokval);
+        EvalValue f;
         if (!expr0(&f))
             return false;
 
@@ -221,15 +383,15 @@ static bool rexp3(Expr* e)
     return true;
 }
 
-static bool expr0(Expr* e)
+bool Evaluator::expr0(EvalValue* e)
 {
     if (!expr1(e))
         return false;
 
     while (i == '|')
     {
-        i = scan(scpriv, tokval);
-        Expr f;
+        i = client.scan(scpriv, tokval);
+        EvalValue f;
         if (!expr1(&f))
             return false;
 
@@ -238,14 +400,14 @@ static bool expr0(Expr* e)
     return true;
 }
 
-static bool expr1(Expr* e)
+bool Evaluator::expr1(EvalValue* e)
 {
     if (!expr2(e))
         return false;
 
     while (i == '^') {
-        i = scan(scpriv, tokval);
-        Expr f;
+        i = client.scan(scpriv, tokval);
+        EvalValue f;
         if (!expr2(&f))
             return false;
 
@@ -254,14 +416,14 @@ static bool expr1(Expr* e)
     return true;
 }
 
-static bool expr2(Expr* e)
+bool Evaluator::expr2(EvalValue* e)
 {
     if (!expr3(e))
         return false;
 
     while (i == '&') {
-        i = scan(scpriv, tokval);
-        Expr f;
+        i = client.scan(scpriv, tokval);
+        EvalValue f;
         if (!expr3(&f))
             return false;
 
@@ -270,7 +432,7 @@ static bool expr2(Expr* e)
     return true;
 }
 
-static bool expr3(Expr* e)
+bool Evaluator::expr3(EvalValue* e)
 {
     if (!expr4(e))
         return false;
@@ -278,8 +440,8 @@ static bool expr3(Expr* e)
     while (i == TOKEN_SHL || i == TOKEN_SHR)
     {
         int j = i;
-        i = scan(scpriv, tokval);
-        Expr f;
+        i = client.scan(scpriv, tokval);
+        EvalValue f;
         if (!expr4(&f))
             return false;
 
@@ -295,15 +457,15 @@ static bool expr3(Expr* e)
     return true;
 }
 
-static bool expr4(Expr* e)
+bool Evaluator::expr4(EvalValue* e)
 {
     if (!expr5(e))
         return false;
     while (i == '+' || i == '-')
     {
         int j = i;
-        i = scan(scpriv, tokval);
-        Expr f;
+        i = client.scan(scpriv, tokval);
+        EvalValue f;
         if (!expr5(&f))
             return false;
         switch (j) {
@@ -318,7 +480,7 @@ static bool expr4(Expr* e)
     return true;
 }
 
-static bool expr5(Expr* e)
+bool Evaluator::expr5(EvalValue* e)
 {
     if (!expr6(e))
         return false;
@@ -326,8 +488,8 @@ static bool expr5(Expr* e)
            i == TOKEN_SDIV || i == TOKEN_SMOD)
     {
         int j = i;
-        i = scan(scpriv, tokval);
-        Expr f;
+        i = client.scan(scpriv, tokval);
+        EvalValue f;
         if (!expr6(&f))
             return false;
         switch (j) {
@@ -351,19 +513,19 @@ static bool expr5(Expr* e)
     return true;
 }
 
-static bool expr6(Expr* e)
+bool Evaluator::expr6(EvalValue* e)
 {
     if (i == '-') {
-        i = scan(scpriv, tokval);
+        i = client.scan(scpriv, tokval);
         if (!expr6(e))
             return false;
         e->Calc(yasm::Op::NEG);
         return true;
     } else if (i == '+') {
-        i = scan(scpriv, tokval);
+        i = client.scan(scpriv, tokval);
         return expr6(e);
     } else if (i == '~') {
-        i = scan(scpriv, tokval);
+        i = client.scan(scpriv, tokval);
         if (!expr6(e))
             return false;
         e->Calc(yasm::Op::NOT);
@@ -374,54 +536,42 @@ static bool expr6(Expr* e)
 	 * preprocessor expression syntax. Added here to get the work
 	 * done.
 	 */
-        i = scan(scpriv, tokval);
+        i = client.scan(scpriv, tokval);
         if (!expr6(e))
             return false;
         e->Calc(yasm::Op::LNOT);
         return true;
     } else if (i == TOKEN_SEG) {
-        i = scan(scpriv, tokval);
+        i = client.scan(scpriv, tokval);
         if (!expr6(e))
             return false;
-        error(ERR_NONFATAL, "%s not supported", "SEG");
+        client.report(ERR_NONFATAL, "%s not supported", "SEG");
         return true;
     } else if (i == '(') {
-        i = scan(scpriv, tokval);
-        if (!bexpr(e))
+        i = client.scan(scpriv, tokval);
+        if (!(this->*bexpr)(e))
             return false;
         if (i != ')') {
-            error(ERR_NONFATAL, "expecting `)'");
+            client.report(ERR_NONFATAL, "expecting `)'");
             return false;
         }
-        i = scan(scpriv, tokval);
+        i = client.scan(scpriv, tokval);
         return true;
     } else if (i == '{' ) {
         /*
          * scpriv -> A -> B
          * A is the current Token*, B is the current Token
-         * curly_evaluator updates A to A2, but also calls
-         * if_condition(), which may change the value of scpriv
-         * again by calling evaluate(). 
-         * Thus when curly_evaluator returns, scpriv would no longer
-         * point to A2, but would point, instead, to another Token*
-         * scpriv -broken-> A2 -> B2
-         *        -newly set-> A3
-         * Since A2 is needed for correct behaviour, scpriv must be
-         * backed up and restored after curly_evaluator returns, so
-         * that it still points to A2
-         *
-         * A2 is the Token* after the '}' that corresponds to the
-         * opening '{'
+         * evaluate_curly_brackets updates A to A2, the Token* after
+         * the '}' that corresponds to the opening '{'.  It may
+         * evaluate further expressions via if_condition(), but those
+         * have their own Evaluator, so scpriv still points to A2
+         * when it returns.
          */
-        void* saved_priv = scpriv;
-        tokenval *saved_tok = tokval;
-        int j = curly_evaluator(scpriv);
-        scpriv = saved_priv;
-        tokval = saved_tok;
+        int j = client.evaluate_curly_brackets(scpriv);
         if( j == -1)
             return false;
-        *e = Expr(IntNum(j));
-        i = scan(scpriv, tokval);
+        e->setInt(IntNum(j));
+        i = client.scan(scpriv, tokval);
         return true;
     }
     else if (i == TOKEN_NUM || i == TOKEN_ID ||
@@ -429,33 +579,33 @@ static bool expr6(Expr* e)
     {
         switch (i) {
           case TOKEN_NUM:
-            *e = Expr(*tokval->t_integer);
+            e->setInt(*tokval->t_integer);
             break;
           case TOKEN_ID:
             if (yasm_object) {
                 yasm::SymbolRef sym = yasm_object->getSymbol(tokval->t_charptr);
                 if (sym) {
                     sym->Use(yasm::SourceLocation());
-                    *e = Expr(sym);
+                    e->setSymbol(sym);
                 } else {
-                    error(ERR_NONFATAL,
+                    client.report(ERR_NONFATAL,
                           "undefined symbol `%s' in preprocessor",
                           tokval->t_charptr);
-                    *e = Expr(IntNum(1));
+                    e->setInt(IntNum(1));
                 }
                 break;
             }
             /*fallthrough*/
           case TOKEN_HERE:
           case TOKEN_BASE:
-            error(ERR_NONFATAL,
+            client.report(ERR_NONFATAL,
                   "cannot reference symbol `%s' in preprocessor",
                   (i == TOKEN_ID ? tokval->t_charptr :
                    i == TOKEN_HERE ? "$" : "$$"));
-            *e = Expr(IntNum(1));
+            e->setInt(IntNum(1));
             break;
         }
-        i = scan(scpriv, tokval);
+        i = client.scan(scpriv, tokval);
         return true;
     } 
     else if(i == TOKEN_PPDIR) {
@@ -463,41 +613,49 @@ static bool expr6(Expr* e)
          * not consume %ppdir tokens(actually all TOK_PREPROC_IDs are
          * sent in here)
          */
-        int j = ppdir_evaluator(scpriv);
+        int j = client.ppdir_processor(scpriv);
         if( j == -1 )
             return false;
-        *e = Expr(IntNum(j));
-        i = scan(scpriv, tokval);
+        e->setInt(IntNum(j));
+        i = client.scan(scpriv, tokval);
         return true;
     }
     else {
-        error(ERR_NONFATAL, "expression syntax error");
+        client.report(ERR_NONFATAL, "expression syntax error");
         return false;
     }
 }
 
-Expr *nasm_evaluate (void *scprivate, struct tokenval *tv,
-                          int critical)
+Evaluator::Evaluator(EvalClient& client_, yasm::Object* object,
+                     void* scprivate, struct tokenval* tv, int critical)
+    : client(client_)
+    , yasm_object(object)
+    , tokval(tv)
+    , scpriv(scprivate)
 {
     if (critical & CRITICAL) {
         critical &= ~CRITICAL;
-        bexpr = rexpc;
+        bexpr = &Evaluator::rexpc;
     } else
-        bexpr = expr0;
-
-    scpriv = scprivate;
-    tokval = tv;
+        bexpr = &Evaluator::expr0;
 
     if (tokval->t_type == TOKEN_INVALID)
-        i = scan(scpriv, tokval);
+        i = client.scan(scpriv, tokval);
     else
         i = tokval->t_type;
+}
+
+Expr *nasm_evaluate (EvalClient &client, yasm::Object *object,
+                     void *scprivate, struct tokenval *tv, int critical)
+{
+    Evaluator evaluator(client, object, scprivate, tv, critical);
 
+    EvalValue v;
+    if (!evaluator.evaluate(&v))
+        return NULL;
     Expr* e = new Expr;
-    if (bexpr(e))
-        return e;
-    delete e;
-    return NULL;
+    e->swap(v.getExpr());
+    return e;
 }
 
 } // namespace nasm
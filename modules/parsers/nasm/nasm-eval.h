@@ -15,17 +15,14 @@ namespace yasm { class Expr; class Object; }
 
 namespace nasm {
 
-extern yasm::Object* yasm_object;
-
 /*
- * The evaluator itself.
+ * The evaluator itself. Symbols are looked up in `object' (which
+ * may be NULL if symbols should not be referenced).
  */
-yasm::Expr *nasm_evaluate (void *scprivate, struct tokenval *tv,
+yasm::Expr *nasm_evaluate (EvalClient &client, yasm::Object *object,
+                          void *scprivate, struct tokenval *tv,
                           int critical);
 
-void setfuncs(scanner cs, efunc errfunc, curl_eval curl_evalfunc, ppdir_eval ppdirfunc);
-
-
 } // namespace nasm
 
 #endif
@@ -11,7 +11,7 @@
 
 /* Typical flow of text through preproc
  *
- * pp_getline gets tokenised lines, either
+ * getline gets tokenised lines, either
  *
  *   from a macro expansion
  *
@@ -48,6 +48,7 @@
 
 #include "nasm.h"
 #include "nasmlib.h"
+#include "nasm-eval.h"
 #include "nasm-pp.h"
 
 using yasm::DirectoryLookup;
@@ -59,14 +60,8 @@ using yasm::SourceLocation;
 
 namespace nasm {
 
-int tasm_compatible_mode = 0;
-int tasm_locals;
-const char *tasm_segment;
-
-yasm::Preprocessor* yasm_preproc;
-
 const llvm::MemoryBuffer*
-yasm_fopen_include(llvm::StringRef filename,
+Preproc::yasm_fopen_include(llvm::StringRef filename,
                    const DirectoryLookup* from_dir,
                    const DirectoryLookup*& cur_dir,
                    FileID from_file,
@@ -97,7 +92,7 @@ yasm_fopen_include(llvm::StringRef filename,
     return input_file;
 }
 
-char *
+static char *
 yasm_fgets(char *buf, int n, const llvm::MemoryBuffer *in, size_t *pos)
 {
     if (n <= 0)
@@ -133,13 +128,18 @@ typedef struct SMacro SMacro;
 typedef struct MMacro MMacro;
 typedef struct Context Context;
 typedef struct Token Token;
-typedef struct Blocks Blocks;
 typedef struct Line Line;
 typedef struct Include Include;
 typedef struct Cond Cond;
 
 /*
  * Store the definition of a single-line macro.
+ *
+ * A parameterless macro also caches the result of fully expanding
+ * it, together with the macros that took part in that expansion.
+ * The cache is only valid while `cache_gen' matches the generation
+ * of the macro tables, which changes whenever a single-line macro
+ * or context is defined or removed.
  */
 struct SMacro
 {
@@ -150,6 +150,10 @@ struct SMacro
     int nparam;
     int in_progress;
     Token *expansion;
+    Token *cache;               /* fully expanded `expansion' */
+    SMacro **cache_deps;        /* macros expanded to produce `cache' */
+    int cache_ndeps;
+    unsigned long cache_gen;
 };
 
 /*
@@ -420,52 +424,6 @@ static const char *tasm_directives[] = {
     "ifndef", "include", "local"
 };
 
-static int StackSize = 4;
-static const char *StackPointer = "ebp";
-static int ArgOffset = 8;
-static int LocalOffset = 4;
-static int Level = 0;
-
-
-static Context *cstk;
-static Include *istk;
-
-static efunc _error;            /* Pointer to client-provided error reporting function */
-static evalfunc evaluate;
-
-static int pass;                /* HACK: pass 0 = generate dependencies only */
-
-static unsigned long unique;    /* unique identifier numbers */
-
-static Line *builtindef = NULL;
-static Line *stddef = NULL;
-static Line *predef = NULL;
-static int first_line = 1;
-static int curly_opened = 0;
-
-/*
- * The number of hash values we use for the macro lookup tables.
- * FIXME: We should *really* be able to configure this at run time,
- * or even have the hash table automatically expanding when necessary.
- */
-#define NHASH 31
-
-/*
- * The current set of multi-line macros we have defined.
- */
-static MMacro *mmacros[NHASH];
-
-/*
- * The current set of single-line macros we have defined.
- */
-static SMacro *smacros[NHASH];
-
-/*
- * The multi-line macro we are currently defining, or the %rep
- * block we are currently reading, if any.
- */
-static MMacro *defining;
-
 /*
  * The number of macro parameters to allocate space for at a time.
  */
@@ -529,37 +487,10 @@ static const char *tasm_compat_macros[] =
     NULL
 };
 
-static int nested_mac_count, nested_rep_count;
-
 /*
  * Tokens are allocated in blocks to improve speed
  */
 #define TOKEN_BLOCKSIZE 4096
-static Token *freeTokens = NULL;
-struct Blocks {
-        Blocks *next;
-        void *chunk;
-};
-
-static Blocks blocks = { NULL, NULL };
-
-/*
- * Forward declarations.
- */
-static Token *expand_mmac_params(Token * tline);
-static Token *expand_smacro(Token * tline);
-static Token *expand_id(Token * tline);
-static Context *get_ctx(char *name, int all_contexts);
-static void make_tok_num(Token * tok, const IntNum& val);
-static void error(int severity, const char *fmt, ...);
-static void *new_Block(size_t size);
-static void delete_Blocks(void);
-static Token *new_Token(Token * next, int type, const char *text,
-                        size_t txtlen);
-static Token *delete_Token(Token * t);
-static Token *tokenise(char *line);
-static int evaluate_curly_brackets(void *private_data);
-static int ppdir_processor(void *private_data);
 
 /*
  * Macros for safe checking of token pointers, avoid *(NULL)
@@ -575,15 +506,11 @@ static int ppdir_processor(void *private_data);
  * be nice to be able to use the NASM pre-processor to do it).
  */
 
-typedef struct TMEndItem {
+struct TMEndItem {
     int type;
     void *data;
     struct TMEndItem *next;
-} TMEndItem;
-
-static TMEndItem *EndmStack = NULL, *EndsStack = NULL;
-
-char **TMParameters;
+};
 
 struct TStrucField {
     char *name;
@@ -595,16 +522,13 @@ struct TStruc {
     struct TStrucField *fields, *lastField;
     struct TStruc *next;
 };
-static struct TStruc *TStrucs = NULL;
-static int inTstruc = 0;
 
 struct TSegmentAssume {
     char *segreg;
     char *segment;
 };
-struct TSegmentAssume *TAssumes;
 
-const char *tasm_get_segment_register(const char *segment)
+const char *Preproc::tasm_get_segment_register(const char *segment)
 {
     struct TSegmentAssume *assume;
     if (!TAssumes)
@@ -616,8 +540,8 @@ const char *tasm_get_segment_register(const char *segment)
     return assume->segreg;
 }
 
-static char *
-check_tasm_directive(char *line)
+char *
+Preproc::check_tasm_directive(char *line)
 {
     int i, j, k, m;
     size_t len, len2;
@@ -1091,7 +1015,7 @@ check_tasm_directive(char *line)
     return line;
 }
 
-static Token * tasm_join_tokens(Token *tline)
+Token * Preproc::tasm_join_tokens(Token *tline)
 {
     Token *t, *prev, *next;
     for (prev = NULL, t = tline; t; prev = t, t = next) {
@@ -1126,8 +1050,8 @@ static Token * tasm_join_tokens(Token *tline)
  * flags') into NASM preprocessor line number indications (`%line
  * lineno file').
  */
-static char *
-prepreproc(char *line)
+char *
+Preproc::prepreproc(char *line)
 {
     int lineno;
     size_t fnlen;
@@ -1209,8 +1133,8 @@ hash(char *s)
 /*
  * Free a linked list of tokens.
  */
-static void
-free_tlist(Token * list_)
+void
+Preproc::free_tlist(Token * list_)
 {
     while (list_)
     {
@@ -1218,11 +1142,24 @@ free_tlist(Token * list_)
     }
 }
 
+/*
+ * Free a single-line macro definition.
+ */
+void
+Preproc::free_smacro(SMacro * s)
+{
+    nasm_free(s->name);
+    free_tlist(s->expansion);
+    free_tlist(s->cache);
+    nasm_free(s->cache_deps);
+    nasm_free(s);
+}
+
 /*
  * Free a linked list of lines.
  */
-static void
-free_llist(Line * list_)
+void
+Preproc::free_llist(Line * list_)
 {
     Line *l;
     while (list_)
@@ -1237,8 +1174,8 @@ free_llist(Line * list_)
 /*
  * Free an MMacro
  */
-static void
-free_mmacro(MMacro * m)
+void
+Preproc::free_mmacro(MMacro * m)
 {
     nasm_free(m->name);
     free_tlist(m->dlist);
@@ -1250,21 +1187,20 @@ free_mmacro(MMacro * m)
 /*
  * Pop the context stack.
  */
-static void
-ctx_pop(void)
+void
+Preproc::ctx_pop(void)
 {
     Context *c = cstk;
     SMacro *smac, *s;
 
     cstk = cstk->next;
     smac = c->localmac;
+    smacro_gen++;
     while (smac)
     {
         s = smac;
         smac = smac->next;
-        nasm_free(s->name);
-        free_tlist(s->expansion);
-        nasm_free(s);
+        free_smacro(s);
     }
     nasm_free(c->name);
     nasm_free(c);
@@ -1277,8 +1213,8 @@ ctx_pop(void)
  * return lines from the standard macro set if this has not already
  * been done.
  */
-static char *
-read_line(void)
+char *
+Preproc::read_line(void)
 {
     char *buffer, *p, *q;
     int bufsize, continued_count;
@@ -1328,7 +1264,7 @@ read_line(void)
         return NULL;
     }
 
-    nasm_src_set_linnum(nasm_src_get_linnum() + istk->lineinc + (continued_count * istk->lineinc));
+    src_set_linnum(src_get_linnum() + istk->lineinc + (continued_count * istk->lineinc));
 
     /*
      * Play safe: remove CRs as well as LFs, if any of either are
@@ -1353,8 +1289,8 @@ read_line(void)
  * don't need to parse the value out of e.g. numeric tokens: we
  * simply split one string into many.
  */
-static Token *
-tokenise(char *line)
+Token *
+Preproc::tokenise(char *line)
 {
     char *p = line;
     int type;
@@ -1520,8 +1456,8 @@ tokenise(char *line)
  * returns a pointer to the block.  The managed blocks are 
  * deleted only all at once by the delete_Blocks function.
  */
-static void *
-new_Block(size_t size)
+void *
+Preproc::new_Block(size_t size)
 {
         Blocks *b = &blocks;
         
@@ -1542,8 +1478,8 @@ new_Block(size_t size)
 /*
  * this function deletes all managed blocks of memory
  */
-static void
-delete_Blocks(void)
+void
+Preproc::delete_Blocks(void)
 {
         Blocks *a,*b = &blocks;
 
@@ -1568,8 +1504,8 @@ delete_Blocks(void)
  *  back to the caller.  It sets the type and text elements, and
  *  also the mac and next elements to NULL.
  */
-static Token *
-new_Token(Token * next, int type, const char *text, size_t txtlen)
+Token *
+Preproc::new_Token(Token * next, int type, const char *text, size_t txtlen)
 {
     Token *t;
     int i;
@@ -1601,8 +1537,8 @@ new_Token(Token * next, int type, const char *text, size_t txtlen)
     return t;
 }
 
-static Token *
-delete_Token(Token * t)
+Token *
+Preproc::delete_Token(Token * t)
 {
     Token *next = t->next;
     nasm_free(t->text);
@@ -1616,8 +1552,8 @@ delete_Token(Token * t)
  * If expand_locals is not zero, identifiers of the form "%$*xxx"
  * will be transformed into ..@ctxnum.xxx
  */
-static char *
-detoken(Token * tlist, int expand_locals)
+char *
+Preproc::detoken(Token * tlist, int expand_locals)
 {
     Token *t;
     size_t len;
@@ -1687,8 +1623,8 @@ detoken(Token * tlist, int expand_locals)
  * the first token in the line to be passed in as its private_data
  * field.
  */
-static int
-ppscan(void *private_data, struct tokenval *tokval)
+int
+Preproc::scan(void *private_data, struct tokenval *tokval)
 {
     Token **tlineptr = (Token**)private_data;
     Token *tline;
@@ -1823,8 +1759,8 @@ mstrcmp(char *p, char *q, int casesense)
  * only the context that directly results from the number of $'s
  * in variable's name.
  */
-static Context *
-get_ctx(char *name, int all_contexts)
+Context *
+Preproc::get_ctx(char *name, int all_contexts)
 {
     Context *ctx;
     SMacro *m;
@@ -1876,8 +1812,8 @@ get_ctx(char *name, int all_contexts)
  * the include path one by one until it finds the file or reaches
  * the end of the path.
  */
-static const llvm::MemoryBuffer*
-inc_fopen(char *file,
+const llvm::MemoryBuffer*
+Preproc::inc_fopen(char *file,
           const DirectoryLookup* from_dir,
           const DirectoryLookup*& cur_dir,
           FileID from_file,
@@ -1986,8 +1922,8 @@ inc_fopen(char *file,
  * with %$ the context will be automatically computed. If all_contexts
  * is true, macro will be searched in outer contexts as well.
  */
-static int
-smacro_defined(Context * ctx, char *name, int nparam, SMacro ** defn,
+int
+Preproc::smacro_defined(Context * ctx, char *name, int nparam, SMacro ** defn,
         int nocase)
 {
     SMacro *m;
@@ -2032,8 +1968,8 @@ smacro_defined(Context * ctx, char *name, int nparam, SMacro ** defn,
  * code, and also to mark off the default parameters when provided
  * in a %macro definition line.
  */
-static void
-count_mmac_params(Token * t, int *nparam, Token *** params)
+void
+Preproc::count_mmac_params(Token * t, int *nparam, Token *** params)
 {
     int paramsize, brace;
 
@@ -2083,8 +2019,8 @@ count_mmac_params(Token * t, int *nparam, Token *** params)
  *
  * We must free the tline we get passed.
  */
-static int
-if_condition(Token * tline, int i)
+int
+Preproc::if_condition(Token * tline, int i)
 {
     int j, casesense;
     Token *t, *tt, **tptr, *origline;
@@ -2418,8 +2354,8 @@ if_condition(Token * tline, int i)
  * First tokenise the string, apply "expand_smacro" and then de-tokenise back.
  * The returned variable should ALWAYS be freed after usage.
  */
-static void
-expand_macros_in_string(char **p)
+void
+Preproc::expand_macros_in_string(char **p)
 {
     Token *line = tokenise(*p);
     line = expand_smacro(line);
@@ -2430,7 +2366,7 @@ expand_macros_in_string(char **p)
  * This function uses a binary search to find out what directive tline
  * is. It is called by do_directive() and evaluate_curly_brackets()
  */
-static void locate_directive(int &i, int &j, int&k, Token *tline)
+void Preproc::locate_directive(int &i, int &j, int&k, Token *tline)
 {
     int m;
     i = -1;
@@ -2468,8 +2404,8 @@ static void locate_directive(int &i, int &j, int&k, Token *tline)
  * @return DIRECTIVE_FOUND or NO_DIRECTIVE_FOUND
  * 
  */
-static int
-do_directive(Token * tline)
+int
+Preproc::do_directive(Token * tline)
 {
     int i, j, k, m, nparam, nolist;
     int offset;
@@ -2817,11 +2753,10 @@ do_directive(Token * tline)
                 {
                     SMacro *s = smacros[j];
                     smacros[j] = smacros[j]->next;
-                    nasm_free(s->name);
-                    free_tlist(s->expansion);
-                    nasm_free(s);
+                    free_smacro(s);
                 }
             }
+            smacro_gen++;
             free_tlist(origline);
             return DIRECTIVE_FOUND;
 
@@ -2856,8 +2791,8 @@ do_directive(Token * tline)
             inc->fid = to_file;
             inc->cur_dir = to_dir;
             inc->pos = 0;
-            inc->fname = nasm_src_set_fname(nasm_strdup(inc->in->getBufferIdentifier()));
-            inc->lineno = nasm_src_set_linnum(0);
+            inc->fname = src_set_fname(nasm_strdup(inc->in->getBufferIdentifier()));
+            inc->lineno = src_set_linnum(0);
             inc->lineinc = 1;
             inc->expansion = NULL;
             inc->mstk = NULL;
@@ -2885,6 +2820,7 @@ do_directive(Token * tline)
             ctx->name = nasm_strdup(tline->text);
             ctx->number = unique++;
             cstk = ctx;
+            smacro_gen++;
             free_tlist(origline);
             break;
 
@@ -2950,9 +2886,7 @@ do_directive(Token * tline)
                         else
                         {
                             *smlast = smac->next;
-                            nasm_free(smac->name);
-                            free_tlist(smac->expansion);
-                            nasm_free(smac);
+                            free_smacro(smac);
                             smac = *smlast;
                         }
                     }
@@ -2971,14 +2905,13 @@ do_directive(Token * tline)
                         else
                         {
                             *smlast = smac->next;
-                            nasm_free(smac->name);
-                            free_tlist(smac->expansion);
-                            nasm_free(smac);
+                            free_smacro(smac);
                             smac = *smlast;
                         }
                     }
                 }
                 Level--;
+                smacro_gen++;
             }
             free_tlist(origline);
             break;
@@ -3519,6 +3452,8 @@ do_directive(Token * tline)
                      */
                     nasm_free(smac->name);
                     free_tlist(smac->expansion);
+                    free_tlist(smac->cache);
+                    nasm_free(smac->cache_deps);
                 }
                 else
                 {
@@ -3539,6 +3474,10 @@ do_directive(Token * tline)
             smac->level = Level;
             smac->expansion = macro_start;
             smac->in_progress = FALSE;
+            smac->cache = NULL;
+            smac->cache_deps = NULL;
+            smac->cache_ndeps = 0;
+            smacro_gen++;
             free_tlist(origline);
             return DIRECTIVE_FOUND;
 
@@ -3580,11 +3519,10 @@ do_directive(Token * tline)
                 if (*s)
                 {
                     *s = smac->next;
-                    nasm_free(smac->name);
-                    free_tlist(smac->expansion);
-                    nasm_free(smac);
+                    free_smacro(smac);
                 }
             }
+            smacro_gen++;
             free_tlist(origline);
             return DIRECTIVE_FOUND;
 
@@ -3649,6 +3587,8 @@ do_directive(Token * tline)
                      */
                     nasm_free(smac->name);
                     free_tlist(smac->expansion);
+                    free_tlist(smac->cache);
+                    nasm_free(smac->cache_deps);
                 }
             }
             else
@@ -3663,6 +3603,10 @@ do_directive(Token * tline)
             smac->level = 0;
             smac->expansion = macro_start;
             smac->in_progress = FALSE;
+            smac->cache = NULL;
+            smac->cache_deps = NULL;
+            smac->cache_ndeps = 0;
+            smacro_gen++;
             free_tlist(tline);
             free_tlist(origline);
             return DIRECTIVE_FOUND;
@@ -3761,6 +3705,8 @@ do_directive(Token * tline)
                      */
                     nasm_free(smac->name);
                     free_tlist(smac->expansion);
+                    free_tlist(smac->cache);
+                    nasm_free(smac->cache_deps);
                 }
             }
             else
@@ -3775,6 +3721,10 @@ do_directive(Token * tline)
             smac->level = 0;
             smac->expansion = macro_start;
             smac->in_progress = FALSE;
+            smac->cache = NULL;
+            smac->cache_deps = NULL;
+            smac->cache_ndeps = 0;
+            smacro_gen++;
             free_tlist(tline);
             free_tlist(origline);
             return DIRECTIVE_FOUND;
@@ -3858,6 +3808,8 @@ do_directive(Token * tline)
                      */
                     nasm_free(smac->name);
                     free_tlist(smac->expansion);
+                    free_tlist(smac->cache);
+                    nasm_free(smac->cache_deps);
                 }
             }
             else
@@ -3872,6 +3824,10 @@ do_directive(Token * tline)
             smac->level = 0;
             smac->expansion = macro_start;
             smac->in_progress = FALSE;
+            smac->cache = NULL;
+            smac->cache_deps = NULL;
+            smac->cache_ndeps = 0;
+            smacro_gen++;
             free_tlist(origline);
             return DIRECTIVE_FOUND;
 
@@ -3903,11 +3859,11 @@ do_directive(Token * tline)
                 tline = tline->next;
             }
             skip_white_(tline);
-            nasm_src_set_linnum(k);
+            src_set_linnum(k);
             istk->lineinc = m;
             if (tline)
             {
-                nasm_free(nasm_src_set_fname(detoken(tline, FALSE)));
+                nasm_free(src_set_fname(detoken(tline, FALSE)));
             }
             free_tlist(origline);
             return DIRECTIVE_FOUND;
@@ -3968,8 +3924,8 @@ find_cc(Token * t)
  * Expand MMacro-local things: parameter references (%0, %n, %+n,
  * %-n) and MMacro-local identifiers (%%foo).
  */
-static Token *
-expand_mmac_params(Token * tline)
+Token *
+Preproc::expand_mmac_params(Token * tline)
 {
     Token *t, *tt, **tail, *thead;
 
@@ -4209,8 +4165,8 @@ expand_mmac_params(Token * tline)
  * Tokens from input to output a lot of the time, rather than
  * actually bothering to destroy and replicate.)
  */
-static Token *
-expand_smacro(Token * tline)
+Token *
+Preproc::expand_smacro(Token * tline)
 {
     Token *t, *tt, *mstart, **tail, *thead;
     SMacro *head = NULL, *m;
@@ -4240,6 +4196,8 @@ expand_smacro(Token * tline)
   again:
     tail = &thead;
     thead = NULL;
+    smacro_stack.clear();
+    smacro_deps.clear();
 
     /*
      * curl_valid represents if we're inside a valid {%pp_dir}
@@ -4261,6 +4219,7 @@ expand_smacro(Token * tline)
          */
         if(tok_is_(tline, "{") )
         {
+            smacro_uncacheable(0);
             if(curl_valid)
             {
                 ++curl_valid_opened;
@@ -4344,15 +4303,17 @@ expand_smacro(Token * tline)
                         if (!strcmp("__FILE__", m->name))
                         {
                             long num = 0;
-                            nasm_src_get(&num, &(tline->text));
+                            smacro_uncacheable(0);
+                            src_get(&num, &(tline->text));
                             nasm_quote(&(tline->text));
                             tline->type = TOK_STRING;
                             continue;
                         }
                         if (!strcmp("__LINE__", m->name))
                         {
+                            smacro_uncacheable(0);
                             nasm_free(tline->text);
-                            make_tok_num(tline, nasm_src_get_linnum());
+                            make_tok_num(tline, src_get_linnum());
                             continue;
                         }
                         tline = delete_Token(tline);
@@ -4375,6 +4336,7 @@ expand_smacro(Token * tline)
                         t = tline->next;
                         while (tok_type_(t, TOK_SMAC_END))
                         {
+                            smacro_end_deleted(t);
                             t->mac->in_progress = FALSE;
                             t->text = NULL;
                             t = tline->next = delete_Token(t);
@@ -4410,6 +4372,7 @@ expand_smacro(Token * tline)
                             t = tline->next;
                             while (tok_type_(t, TOK_SMAC_END))
                             {
+                                smacro_end_deleted(t);
                                 t->mac->in_progress = FALSE;
                                 t->text = NULL;
                                 t = tline->next = delete_Token(t);
@@ -4494,7 +4457,10 @@ expand_smacro(Token * tline)
                     }
                 }
                 if (m && m->in_progress)
+                {
+                    smacro_blocked(m);
                     m = NULL;
+                }
                 if (!m)         /* in progess or didn't find '(' or wrong nparam */
                 {
                     /* 
@@ -4507,6 +4473,29 @@ expand_smacro(Token * tline)
                     nasm_free(paramsize);
                     tline = mstart;
                 }
+                else if (m->nparam == 0 && smacro_cached(m))
+                {
+                    /*
+                     * The macro has been fully expanded before, and
+                     * nothing it depends on has changed since: copy
+                     * the expansion straight to the output.
+                     */
+                    tline = mstart->next;
+                    mstart->next = NULL;
+                    free_tlist(mstart);
+                    for (tt = m->cache; tt; tt = tt->next)
+                    {
+                        t = *tail = new_Token(NULL, tt->type, tt->text, 0);
+                        tail = &t->next;
+                    }
+                    if (!smacro_stack.empty())
+                    {
+                        smacro_deps.push_back(m);
+                        smacro_deps.insert(smacro_deps.end(), m->cache_deps,
+                                           m->cache_deps + m->cache_ndeps);
+                    }
+                    continue;   /* main token loop */
+                }
                 else
                 {
                     /*
@@ -4525,6 +4514,17 @@ expand_smacro(Token * tline)
                     tt->mac = m;
                     m->in_progress = TRUE;
                     tline = tt;
+
+                    /*
+                     * Record where the expansion starts in the output,
+                     * so that it can be cached when its SMAC_END token
+                     * is reached.
+                     */
+                    if (!smacro_stack.empty())
+                        smacro_deps.push_back(m);
+                    SMacroExpansion exp =
+                        { m, tt, tail, smacro_deps.size(), true };
+                    smacro_stack.push_back(exp);
                     for (t = m->expansion; t; t = t->next)
                     {
                         if (t->type >= TOK_SMAC_PARAM)
@@ -4566,6 +4566,8 @@ expand_smacro(Token * tline)
 
         if (tline->type == TOK_SMAC_END)
         {
+            if (!smacro_stack.empty() && smacro_stack.back().end == tline)
+                smacro_finish(tail);
             tline->mac->in_progress = FALSE;
             tline = delete_Token(tline);
         }
@@ -4652,6 +4654,113 @@ expand_smacro(Token * tline)
     return thead;
 }
 
+/*
+ * Check whether the cached expansion of a parameterless single-line
+ * macro may be used: no macro has been defined or removed since it
+ * was made, and none of the macros it expanded is in progress (which
+ * would stop them from being expanded now).
+ */
+bool
+Preproc::smacro_cached(SMacro * m)
+{
+    int i;
+
+    if (!m->cache || m->cache_gen != smacro_gen)
+        return false;
+    for (i = 0; i < m->cache_ndeps; i++)
+        if (m->cache_deps[i]->in_progress)
+            return false;
+    return true;
+}
+
+/*
+ * Mark the expansions in progress from `from' upwards as depending on
+ * their surroundings, so they won't be cached.
+ */
+void
+Preproc::smacro_uncacheable(size_t from)
+{
+    for (; from < smacro_stack.size(); from++)
+        smacro_stack[from].cacheable = false;
+}
+
+/*
+ * Expansion of `m' was suppressed because it is in progress. That
+ * only follows from the macro text if `m' itself is being expanded
+ * inside the expansion in question.
+ */
+void
+Preproc::smacro_blocked(SMacro * m)
+{
+    size_t i = smacro_stack.size();
+
+    while (i > 0 && smacro_stack[i-1].mac != m)
+        i--;
+    smacro_uncacheable(i);
+}
+
+/*
+ * A macro call read parameters past the end of an expansion, so
+ * the expansion depends on what follows it.
+ */
+void
+Preproc::smacro_end_deleted(Token * end)
+{
+    size_t i = smacro_stack.size();
+
+    while (i > 0 && smacro_stack[i-1].end != end)
+        i--;
+    if (i == 0)
+        return;
+    smacro_stack.resize(i-1);
+    if (smacro_stack.empty())
+        smacro_deps.clear();
+}
+
+/*
+ * The innermost expansion in progress is complete, and its output
+ * runs from its start up to `tail'. Cache it if possible.
+ */
+void
+Preproc::smacro_finish(Token ** tail)
+{
+    SMacroExpansion &exp = smacro_stack.back();
+    SMacro *m = exp.mac;
+
+    if (exp.cacheable && m->nparam == 0)
+    {
+        Token *t, **ctail;
+        size_t ndeps = smacro_deps.size() - exp.deps;
+
+        free_tlist(m->cache);
+        nasm_free(m->cache_deps);
+        m->cache = NULL;
+        ctail = &m->cache;
+        if (exp.start != tail)
+        {
+            for (t = *exp.start; ; t = t->next)
+            {
+                *ctail = new_Token(NULL, t->type, t->text, 0);
+                ctail = &(*ctail)->next;
+                if (&t->next == tail)
+                    break;
+            }
+        }
+        m->cache_ndeps = (int)ndeps;
+        m->cache_deps = NULL;
+        if (ndeps > 0)
+        {
+            m->cache_deps = (SMacro**)nasm_malloc(ndeps * sizeof(SMacro*));
+            memcpy(m->cache_deps, &smacro_deps[exp.deps],
+                   ndeps * sizeof(SMacro*));
+        }
+        m->cache_gen = smacro_gen;
+    }
+    smacro_stack.pop_back();
+    if (smacro_stack.empty())
+        smacro_deps.clear();
+}
+
 /*
  * Similar to expand_smacro but used exclusively with macro identifiers
  * right before they are fetched in. The reason is that there can be
@@ -4671,8 +4780,8 @@ expand_smacro(Token * tline)
  * otherwise it will be left as-is) then concatenate all successive
  * PP_IDs into one.
  */
-static Token *
-expand_id(Token * tline)
+Token *
+Preproc::expand_id(Token * tline)
 {
     Token *cur, *oldnext = NULL;
 
@@ -4718,8 +4827,8 @@ expand_id(Token * tline)
  * to be called with tline->type == TOK_ID, so the putative macro
  * name is easy to find.
  */
-static MMacro *
-is_mmacro(Token * tline, Token *** params_array)
+MMacro *
+Preproc::is_mmacro(Token * tline, Token *** params_array)
 {
     MMacro *head, *m;
     Token **params;
@@ -4825,8 +4934,8 @@ is_mmacro(Token * tline, Token *** params_array)
  * there is one to be expanded. If there is, push the expansion on
  * istk->expansion and return 1. Otherwise return 0.
  */
-static int
-expand_mmacro(Token * tline)
+int
+Preproc::expand_mmacro(Token * tline)
 {
     Token *startline = tline;
     Token *label = NULL;
@@ -4995,8 +5104,8 @@ expand_mmacro(Token * tline)
  * won't want to see same error twice (preprocessing is done once
  * per pass) we will want to show errors only during pass one.
  */
-static void
-error(int severity, const char *fmt, ...)
+void
+Preproc::error(int severity, const char *fmt, ...)
 {
     va_list arg;
     char buff[1024];
@@ -5005,6 +5114,9 @@ error(int severity, const char *fmt, ...)
     if (istk && istk->conds && !emitting(istk->conds->state))
         return;
 
+    /* An expansion that reports errors can't be replayed from cache */
+    smacro_uncacheable(0);
+
     va_start(arg, fmt);
 #ifdef HAVE_VSNPRINTF
     vsnprintf(buff, sizeof(buff), fmt, arg);
@@ -5014,21 +5126,143 @@ error(int severity, const char *fmt, ...)
     va_end(arg);
 
     if (istk && istk->mstk && istk->mstk->name)
-        _error(severity | ERR_PASS1, "(%s:%d) %s", istk->mstk->name,
-                istk->mstk->lineno, buff);
+        report(severity | ERR_PASS1, "(%s:%d) %s", istk->mstk->name,
+               istk->mstk->lineno, buff);
     else 
-        _error(severity | ERR_PASS1, "%s", buff);
+        report(severity | ERR_PASS1, "%s", buff);
 }
 
-static void
-pp_reset(FileID fid, int apass, efunc errfunc, evalfunc eval, nasm_eval_setfuncs setfunc)
+void
+Preproc::report(int severity, const char *fmt, ...)
+{
+    va_list va;
+
+    fprintf(stderr, "%s:%ld: ", file_name, line_number);
+
+    va_start(va, fmt);
+    switch (severity & ERR_MASK) {
+        case ERR_WARNING:
+            vfprintf(stderr, fmt, va);
+            fputc('\n', stderr);
+            break;
+        case ERR_NONFATAL:
+            vfprintf(stderr, fmt, va);
+            fputc('\n', stderr);
+            ++nasm_errors;
+            break;
+        case ERR_FATAL:
+        case ERR_PANIC:
+            vfprintf(stderr, fmt, va);
+            fputc('\n', stderr);
+            exit(1);
+            /*@notreached@*/
+            break;
+        case ERR_DEBUG:
+            break;
+    }
+    va_end(va);
+}
+
+Expr *
+Preproc::evaluate(void *scprivate, struct tokenval *tv, int critical)
+{
+    return nasm_evaluate(*this, yasm_object, scprivate, tv, critical);
+}
+
+Preproc::Preproc(yasm::Preprocessor& preproc)
+    : yasm_preproc(&preproc)
+    , yasm_object(NULL)
+    , file_name(NULL)
+    , line_number(0)
+    , nasm_errors(0)
+    , tasm_compatible_mode(0)
+    , tasm_locals(0)
+    , tasm_segment(NULL)
+    , StackSize(4)
+    , StackPointer("ebp")
+    , ArgOffset(8)
+    , LocalOffset(4)
+    , Level(0)
+    , cstk(NULL)
+    , istk(NULL)
+    , pass(0)
+    , unique(0)
+    , builtindef(NULL)
+    , stddef(NULL)
+    , predef(NULL)
+    , first_line(1)
+    , curly_opened(0)
+    , smacro_gen(0)
+    , defining(NULL)
+    , nested_mac_count(0)
+    , nested_rep_count(0)
+    , freeTokens(NULL)
+    , EndmStack(NULL)
+    , EndsStack(NULL)
+    , TMParameters(NULL)
+    , TStrucs(NULL)
+    , inTstruc(0)
+    , TAssumes(NULL)
 {
     int h;
 
-    //Sets utility functions for stuffs in nasm-eval.cpp
-    setfunc(ppscan, errfunc, evaluate_curly_brackets, ppdir_processor);
+    for (h = 0; h < NHASH; h++)
+    {
+        mmacros[h] = NULL;
+        smacros[h] = NULL;
+    }
+    blocks.next = NULL;
+    blocks.chunk = NULL;
+}
+
+Preproc::~Preproc()
+{
+    cleanup(0);
+    nasm_free(file_name);
+}
+
+char *
+Preproc::src_set_fname(char *newname)
+{
+    char *oldname = file_name;
+    file_name = newname;
+    return oldname;
+}
+
+long
+Preproc::src_set_linnum(long newline)
+{
+    long oldline = line_number;
+    line_number = newline;
+    return oldline;
+}
 
-    _error = errfunc;
+int
+Preproc::src_get(long *xline, char **xname)
+{
+    if (!file_name || !*xname || strcmp(*xname, file_name))
+    {
+        nasm_free(*xname);
+        *xname = file_name ? nasm_strdup(file_name) : NULL;
+        *xline = line_number;
+        return -2;
+    }
+    if (*xline != line_number)
+    {
+        long tmp = line_number - *xline;
+        *xline = line_number;
+        return tmp;
+    }
+    return 0;
+}
+
+void
+Preproc::reset(FileID fid, int apass, yasm::Object* object)
+{
+    int h;
+
+    yasm_object = object;
+    nasm_errors = 0;
     cstk = NULL;
     istk = (Include*)nasm_malloc(sizeof(Include));
     istk->next = NULL;
@@ -5042,8 +5276,8 @@ pp_reset(FileID fid, int apass, efunc errfunc, evalfunc eval, nasm_eval_setfuncs
     istk->cur_dir = NULL;
     istk->pos = 0;
     istk->fname = NULL;
-    nasm_free(nasm_src_set_fname(nasm_strdup(istk->in->getBufferIdentifier())));
-    nasm_src_set_linnum(0);
+    nasm_free(src_set_fname(nasm_strdup(istk->in->getBufferIdentifier())));
+    src_set_linnum(0);
     istk->lineinc = 1;
     defining = NULL;
     nested_mac_count = 0;
@@ -5053,11 +5287,11 @@ pp_reset(FileID fid, int apass, efunc errfunc, evalfunc eval, nasm_eval_setfuncs
         mmacros[h] = NULL;
         smacros[h] = NULL;
     }
+    smacro_gen++;
     unique = 0;
     if (tasm_compatible_mode) {
-        pp_extra_stdmac(tasm_compat_macros);
+        extra_stdmac(tasm_compat_macros);
     }
-    evaluate = eval;
     pass = apass;
     first_line = 1;
 }
@@ -5068,8 +5302,8 @@ pp_reset(FileID fid, int apass, efunc errfunc, evalfunc eval, nasm_eval_setfuncs
  * most convenient way to implement the pre-include and
  * pre-define features.
  */
-static void
-poke_predef(Line *predef_lines)
+void
+Preproc::poke_predef(Line *predef_lines)
 {
     Line *pd, *l;
     Token *head, **tail, *t;
@@ -5091,8 +5325,8 @@ poke_predef(Line *predef_lines)
     }
 }
 
-static char *
-pp_getline(void)
+char *
+Preproc::getline(void)
 {
     char *line;
     Token *tline;
@@ -5239,8 +5473,8 @@ pp_getline(void)
                 /* only set line and file name if there's a next node */
                 if (i->next) 
                 {
-                    nasm_src_set_linnum(i->lineno);
-                    nasm_free(nasm_src_set_fname(nasm_strdup(i->fname)));
+                    src_set_linnum(i->lineno);
+                    nasm_free(src_set_fname(nasm_strdup(i->fname)));
                 }
                 istk = i->next;
                 //list->downlevel(LIST_INCLUDE);
@@ -5335,8 +5569,8 @@ pp_getline(void)
     return line;
 }
 
-static void
-pp_cleanup(int pass_)
+void
+Preproc::cleanup(int pass_)
 {
     int h;
 
@@ -5364,9 +5598,7 @@ pp_cleanup(int pass_)
         {
             SMacro *s = smacros[h];
             smacros[h] = smacros[h]->next;
-            nasm_free(s->name);
-            free_tlist(s->expansion);
-            nasm_free(s);
+            free_smacro(s);
         }
     }
     while (istk)
@@ -5394,7 +5626,7 @@ pp_cleanup(int pass_)
 }
 
 void
-pp_pre_include(const char *fname)
+Preproc::pre_include(const char *fname)
 {
     Token *inc, *space, *name;
     Line *l;
@@ -5411,7 +5643,7 @@ pp_pre_include(const char *fname)
 }
 
 void
-pp_pre_define(char *definition)
+Preproc::pre_define(char *definition)
 {
     Token *def, *space;
     Line *l;
@@ -5434,7 +5666,7 @@ pp_pre_define(char *definition)
 }
 
 void
-pp_pre_undefine(char *definition)
+Preproc::pre_undefine(char *definition)
 {
     Token *def, *space;
     Line *l;
@@ -5451,7 +5683,7 @@ pp_pre_undefine(char *definition)
 }
 
 void
-pp_builtin_define(char *definition)
+Preproc::builtin_define(char *definition)
 {
     Token *def, *space;
     Line *l;
@@ -5474,7 +5706,7 @@ pp_builtin_define(char *definition)
 }
 
 void
-pp_extra_stdmac(const char **macros)
+Preproc::extra_stdmac(const char **macros)
 {
     const char **lp;
 
@@ -5496,8 +5728,8 @@ pp_extra_stdmac(const char **macros)
     }
 }
 
-static void
-make_tok_num(Token * tok, const IntNum& val)
+void
+Preproc::make_tok_num(Token * tok, const IntNum& val)
 {
     llvm::SmallString<64> str;
     val.getStr(str);
@@ -5505,12 +5737,6 @@ make_tok_num(Token * tok, const IntNum& val)
     tok->type = TOK_NUMBER;
 }
 
-Preproc nasmpp = {
-    pp_reset,
-    pp_getline,
-    pp_cleanup
-};
-
 /*
  * This function processes the {%pp_dir} structure inside a
  * preprocessor expression. It is called by nasm-eval.cpp::expr6() 
@@ -5527,7 +5753,7 @@ Preproc nasmpp = {
  *      0/1: evaluated to false/true;
  *      -1: Error in expression
  */
-static int evaluate_curly_brackets(void *private_data)
+int Preproc::evaluate_curly_brackets(void *private_data)
 {
     //t1 is a Token** that points to the first token after '{'
     Token **t1 = (Token**)private_data;
@@ -5639,7 +5865,7 @@ static int evaluate_curly_brackets(void *private_data)
  *      0 or 1: evaluated to false/true;
  *      -1: Error in expression
  */
-static int ppdir_processor(void *private_data)
+int Preproc::ppdir_processor(void *private_data)
 {
     //points to the %ppdir token itself
     Token **t1 = (Token**)private_data;
@@ -9,18 +9,241 @@
 #ifndef YASM_NASM_PREPROC_H
 #define YASM_NASM_PREPROC_H
 
-namespace yasm { class Preprocessor; }
+#include <cstddef>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+#include "yasmx/Basic/SourceLocation.h"
+
+#include "nasm.h"
+
+namespace llvm { class MemoryBuffer; }
+namespace yasm { class DirectoryLookup; class Object; class Preprocessor; }
 
 namespace nasm {
 
-void pp_pre_include (const char *);
-void pp_pre_define (char *);
-void pp_pre_undefine (char *);
-void pp_builtin_define (char *);
-void pp_extra_stdmac (const char **);
+struct SMacro;
+struct MMacro;
+struct Context;
+struct Token;
+struct Line;
+struct Include;
+struct TMEndItem;
+struct TStruc;
+struct TSegmentAssume;
+
+/*
+ * The number of hash values we use for the macro lookup tables.
+ * FIXME: We should *really* be able to configure this at run time,
+ * or even have the hash table automatically expanding when necessary.
+ */
+#define NHASH 31
+
+/*
+ * Blocks of memory from which Tokens are allocated.
+ */
+struct Blocks {
+        Blocks *next;
+        void *chunk;
+};
+
+/*
+ * A single-line macro expansion in progress in expand_smacro(): the
+ * TOK_SMAC_END token that closes it, where its output starts, and
+ * where the macros it expands start in the dependency list.
+ */
+struct SMacroExpansion {
+    SMacro *mac;
+    Token *end;
+    Token **start;
+    size_t deps;
+    bool cacheable;
+};
+
+/*
+ * The preprocessor. All of its state lives in the instance, so
+ * independent instances may run concurrently.
+ */
+class Preproc : private EvalClient
+{
+public:
+    Preproc(yasm::Preprocessor &preproc);
+    ~Preproc();
+
+    /*
+     * Called at the start of a pass; given the main file, the
+     * number of the pass, and the object to look up symbols in.
+     */
+    void reset(yasm::FileID fid, int apass, yasm::Object *object);
+
+    /*
+     * Called to fetch a line of preprocessed source. The line
+     * returned has been malloc'ed, and so should be freed after
+     * use.
+     */
+    char *getline(void);
+
+    /*
+     * Called at the end of a pass.
+     */
+    void cleanup(int pass_);
+
+    void pre_include(const char *fname);
+    void pre_define(char *definition);
+    void pre_undefine(char *definition);
+    void builtin_define(char *definition);
+    void extra_stdmac(const char **macros);
+
+    /*
+     * src_get may be used if you simply want to know the source file
+     * and line. It is also used if you maintain private status about
+     * the source location. It returns 0 if the information was the
+     * same as the last time you checked, -1 if the name changed and
+     * (new-old) if just the line changed.
+     */
+    int src_get(long *xline, char **xname);
+
+    /* Number of non-fatal errors reported since reset(). */
+    unsigned int get_error_count() const { return nasm_errors; }
+
+private:
+    Preproc(const Preproc&);                    /* not implemented */
+    const Preproc& operator=(const Preproc&);   /* not implemented */
+
+    /* EvalClient */
+    int scan(void *private_data, struct tokenval *tokval);
+    void report(int severity, const char *fmt, ...);
+    int evaluate_curly_brackets(void *private_data);
+    int ppdir_processor(void *private_data);
+
+    yasm::Expr *evaluate(void *scprivate, struct tokenval *tv, int critical);
+    void error(int severity, const char *fmt, ...);
+
+    char *src_set_fname(char *newname);
+    char *src_get_fname(void) { return file_name; }
+    long src_set_linnum(long newline);
+    long src_get_linnum(void) { return line_number; }
+
+    const llvm::MemoryBuffer *yasm_fopen_include(
+        llvm::StringRef filename,
+        const yasm::DirectoryLookup *from_dir,
+        const yasm::DirectoryLookup *&cur_dir,
+        yasm::FileID from_file,
+        yasm::FileID &cur_file);
+    const llvm::MemoryBuffer *inc_fopen(
+        char *file,
+        const yasm::DirectoryLookup *from_dir,
+        const yasm::DirectoryLookup *&cur_dir,
+        yasm::FileID from_file,
+        yasm::FileID &cur_file);
+
+    const char *tasm_get_segment_register(const char *segment);
+    char *check_tasm_directive(char *line);
+    Token *tasm_join_tokens(Token *tline);
+    char *prepreproc(char *line);
+    void free_tlist(Token *list_);
+    void free_llist(Line *list_);
+    void free_mmacro(MMacro *m);
+    void free_smacro(SMacro *s);
+    void ctx_pop(void);
+    char *read_line(void);
+    Token *tokenise(char *line);
+    void *new_Block(size_t size);
+    void delete_Blocks(void);
+    Token *new_Token(Token *next, int type, const char *text,
+                     size_t txtlen);
+    Token *delete_Token(Token *t);
+    char *detoken(Token *tlist, int expand_locals);
+    Context *get_ctx(char *name, int all_contexts);
+    int smacro_defined(Context *ctx, char *name, int nparam,
+                       SMacro **defn, int nocase);
+    void count_mmac_params(Token *t, int *nparam, Token ***params);
+    int if_condition(Token *tline, int i);
+    void expand_macros_in_string(char **p);
+    void locate_directive(int &i, int &j, int &k, Token *tline);
+    int do_directive(Token *tline);
+    Token *expand_mmac_params(Token *tline);
+    Token *expand_smacro(Token *tline);
+    bool smacro_cached(SMacro *m);
+    void smacro_uncacheable(size_t from);
+    void smacro_blocked(SMacro *m);
+    void smacro_end_deleted(Token *end);
+    void smacro_finish(Token **tail);
+    Token *expand_id(Token *tline);
+    MMacro *is_mmacro(Token *tline, Token ***params_array);
+    int expand_mmacro(Token *tline);
+    void poke_predef(Line *predef_lines);
+    void make_tok_num(Token *tok, const yasm::IntNum &val);
+
+    yasm::Preprocessor *yasm_preproc;
+    yasm::Object *yasm_object;  /* for symbol lookup in expressions */
+
+    char *file_name;            /* current source file name */
+    long line_number;           /* current source line number */
+    unsigned int nasm_errors;   /* non-fatal errors reported */
+
+    int tasm_compatible_mode;
+    int tasm_locals;
+    const char *tasm_segment;
+
+    int StackSize;
+    const char *StackPointer;
+    int ArgOffset;
+    int LocalOffset;
+    int Level;
+
+    Context *cstk;
+    Include *istk;
+
+    int pass;                   /* HACK: pass 0 = generate dependencies only */
+
+    unsigned long unique;       /* unique identifier numbers */
+
+    Line *builtindef;
+    Line *stddef;
+    Line *predef;
+    int first_line;
+    int curly_opened;
+
+    /*
+     * The current set of multi-line macros we have defined.
+     */
+    MMacro *mmacros[NHASH];
+
+    /*
+     * The current set of single-line macros we have defined.
+     */
+    SMacro *smacros[NHASH];
+
+    /*
+     * Generation of the single-line macro tables, for validating
+     * cached expansions, and the expansions currently in progress.
+     */
+    unsigned long smacro_gen;
+    std::vector<SMacroExpansion> smacro_stack;
+    std::vector<SMacro*> smacro_deps;
+
+    /*
+     * The multi-line macro we are currently defining, or the %rep
+     * block we are currently reading, if any.
+     */
+    MMacro *defining;
+
+    int nested_mac_count, nested_rep_count;
+
+    /*
+     * Tokens are allocated in blocks to improve speed
+     */
+    Token *freeTokens;
+    Blocks blocks;
 
-extern Preproc nasmpp;
-extern yasm::Preprocessor* yasm_preproc;
+    /* TASM compatibility state */
+    TMEndItem *EndmStack, *EndsStack;
+    char **TMParameters;
+    TStruc *TStrucs;
+    int inTstruc;
+    TSegmentAssume *TAssumes;
+};
 
 void nasm_preproc_add_dep(char *);
 
@@ -148,10 +148,9 @@ typedef struct {
 } ListGen;
 
 /*
- * The expression evaluator must be passed a scanner function; a
- * standard scanner is provided as part of nasmlib.c. The
- * preprocessor will use a different one. Scanners, and the
- * token-value structures they return, look like this.
+ * The expression evaluator must be passed a scanner; the
+ * preprocessor provides one. Scanners, and the token-value
+ * structures they return, look like this.
  *
  * The return value from the scanner is always a copy of the
  * `t_type' field in the structure.
@@ -161,10 +160,22 @@ struct tokenval {
     yasm::IntNum *t_integer, *t_inttwo;
     char *t_charptr;
 };
-typedef int (*scanner) (void *private_data, struct tokenval *tv);
-typedef int (*curl_eval) (void *private_data);
-typedef int (*ppdir_eval) (void *private_data);
-typedef void (*nasm_eval_setfuncs)(scanner, efunc, curl_eval, ppdir_eval);
+
+/*
+ * The client of the expression evaluator: it supplies the scanner,
+ * reports errors, and evaluates the {%ppdir} structures and %ppdir
+ * tokens embedded in preprocessor expressions. All evaluator state
+ * lives either here or in the evaluation itself, so independent
+ * clients may evaluate concurrently.
+ */
+class EvalClient {
+public:
+    virtual ~EvalClient() {}
+    virtual int scan(void *private_data, struct tokenval *tv) = 0;
+    virtual void report(int severity, const char *fmt, ...) = 0;
+    virtual int evaluate_curly_brackets(void *private_data) = 0;
+    virtual int ppdir_processor(void *private_data) = 0;
+};
 
 /*
  * Token types returned by the scanner, in addition to ordinary
@@ -207,33 +218,6 @@ enum {                                 /* token types, other than chars */
  * &&, ^^ and ||.
  */
 #define CRITICAL 0x100
-typedef yasm::Expr *(*evalfunc) (void *scprivate, struct tokenval *tv,
-                           int critical);
-
-
-/*
- * Preprocessors ought to look like this:
- */
-typedef struct {
-    /*
-     * Called at the start of a pass; given a file name, the number
-     * of the pass, an error reporting function, an evaluator
-     * function, and a listing generator to talk to.
-     */
-    void (*reset) (yasm::FileID, int, efunc, evalfunc, nasm_eval_setfuncs);
-
-    /*
-     * Called to fetch a line of preprocessed source. The line
-     * returned has been malloc'ed, and so should be freed after
-     * use.
-     */
-    char *(*getline) (void);
-
-    /*
-     * Called at the end of a pass.
-     */
-    void (*cleanup) (int);
-} Preproc;
 
 /*
  * ----------------------------------------------------------------
@@ -285,11 +269,6 @@ enum {
 
 #define elements(x)     ( sizeof(x) / sizeof(*(x)) )
 
-extern int tasm_compatible_mode;
-extern int tasm_locals;
-extern const char *tasm_segment;
-const char *tasm_get_segment_register(const char *segment);
-
 } // namespace nasm
 
 #endif
@@ -195,51 +195,6 @@ IntNum nasm_readstrnum (char *str, size_t length, int *warn)
     return intn;
 }
 
-static char *file_name = NULL;
-static long line_number = 0;
-
-char *nasm_src_set_fname(char *newname) 
-{
-    char *oldname = file_name;
-    file_name = newname;
-    return oldname;
-}
-
-char *nasm_src_get_fname(void)
-{
-    return file_name;
-}
-
-long nasm_src_set_linnum(long newline) 
-{
-    long oldline = line_number;
-    line_number = newline;
-    return oldline;
-}
-
-long nasm_src_get_linnum(void) 
-{
-    return line_number;
-}
-
-int nasm_src_get(long *xline, char **xname) 
-{
-    if (!file_name || !*xname || strcmp(*xname, file_name)) 
-    {
-        nasm_free(*xname);
-        *xname = file_name ? nasm_strdup(file_name) : NULL;
-        *xline = line_number;
-        return -2;
-    }
-    if (*xline != line_number) 
-    {
-        long tmp = line_number - *xline;
-        *xline = line_number;
-        return tmp;
-    }
-    return 0;
-}
-
 void nasm_quote(char **str) 
 {
     size_t ln=strlen(*str);
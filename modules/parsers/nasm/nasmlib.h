@@ -46,18 +46,6 @@ yasm::IntNum nasm_readnum(char *str, int *error);
  */
 yasm::IntNum nasm_readstrnum(char *str, size_t length, int *warn);
 
-char *nasm_src_set_fname(char *newname);
-char *nasm_src_get_fname(void);
-long nasm_src_set_linnum(long newline);
-long nasm_src_get_linnum(void);
-/*
- * src_get may be used if you simply want to know the source file and line.
- * It is also used if you maintain private status about the source location
- * It return 0 if the information was the same as the last time you
- * checked, -1 if the name changed and (new-old) if just the line changed.
- */
-int nasm_src_get(long *xline, char **xname);
-
 void nasm_quote(char **str);
 char *nasm_strcat(const char *one, const char *two);
 
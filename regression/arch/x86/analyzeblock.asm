@@ -0,0 +1,14 @@
+; [yasm -f bin -p nasm --analyze=skylake]
+[bits 64]
+; A straight-line block is only analyzed when marked as a region.
+[analyze_begin kernel]
+    mov rax, [rdi]
+    mov rdx, [rdi+8]
+    add rax, rdx
+    imul rax, rcx
+    lea rdx, [rax+rax*2]
+    shl rdx, 3
+    mov [rsi], rax
+    mov [rsi+8], rdx
+[analyze_end]
+    ret
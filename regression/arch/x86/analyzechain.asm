@@ -0,0 +1,16 @@
+; [yasm -f bin -p nasm --analyze=zen]
+[bits 64]
+; The accumulator carries a dependency from one iteration to the next.
+sum:
+    vfmadd231ps ymm0, ymm1, [rdi]
+    vfmadd231ps ymm0, ymm2, [rdi+32]
+    add rdi, 64
+    dec ecx
+    jnz sum
+; Pointer chasing: each load address comes from the previous load.
+walk:
+    mov rax, [rax]
+    mov rax, [rax+8]
+    test rax, rax
+    jnz walk
+    ret
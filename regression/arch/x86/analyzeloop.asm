@@ -0,0 +1,27 @@
+; [yasm -f bin -p nasm --analyze=haswell]
+[bits 64]
+; Throughput-bound loop: the multiplies are independent across iterations.
+dot:
+    xorps xmm0, xmm0
+    xor eax, eax
+.loop:
+    movups xmm1, [rdi+rax*4]
+    mulps xmm1, [rsi+rax*4]
+    movups [rdx+rax*4], xmm1
+    add rax, 4
+    cmp rax, rcx
+    jb .loop
+    ret
+; Pushes and pops only update rsp, which the stack engine handles, so
+; this loop has no loop-carried dependency through rsp.
+spill:
+    push rbx
+    push rbp
+    mov rbx, [rdi]
+    add rbx, 1
+    mov [rdi], rbx
+    pop rbp
+    pop rbx
+    dec ecx
+    jnz spill
+    ret
@@ -0,0 +1,15 @@
+; [yasm -f bin -p nasm -Wcode-placement]
+[bits 64]
+times 58 db 0x90
+[analyze_begin hot]
+top:
+add rax, rbx
+imul rcx, rax
+sub rdx, 1
+jnz top
+[analyze_end]
+[analyze_begin cold]
+aligned:
+dec rcx
+jnz aligned
+[analyze_end]
@@ -0,0 +1,24 @@
+; [yasm -f elf64 --feature-report=-]
+; Base, SSE and AVX code in one section and across functions.
+section .text
+global scalar
+scalar:
+    lea rax, [rdi+rsi]
+    imul rax, rdx
+    ret
+global sse
+sse:
+    movaps xmm0, [rdi]
+    addps xmm0, [rsi]
+    pshufb xmm0, xmm1
+    ret
+global avx
+avx:
+    vmovaps ymm0, [rdi]
+    vfmadd231ps ymm0, ymm1, [rsi]
+    vzeroupper
+    ret
+section .text.cold progbits alloc exec
+cold:
+    popcnt eax, ecx
+    ret
@@ -0,0 +1,20 @@
+; [yasm -f bin -p nasm --layout-report]
+; The layout report flags the same region and label placements as
+; -Wcode-placement, without warning.
+[bits 64]
+times 58 db 0x90
+[analyze_begin hot]
+top:
+add rax, rbx
+inner:
+imul rcx, rax
+sub rdx, 1
+jnz inner
+dec rsi
+jnz top
+[analyze_end]
+[analyze_begin cold]
+aligned:
+dec rcx
+jnz aligned
+[analyze_end]
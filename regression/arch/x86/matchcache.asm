@@ -0,0 +1,32 @@
+; Instructions of the same shape reuse the matched form; anything that
+; affects matching must keep shapes apart.
+[bits 64]
+mov rax, [rbx+8]
+mov rcx, [rdx+8]
+mov eax, [rbx+8]
+shl eax, 1
+shl ecx, 1
+shl eax, 2
+shl ecx, 2
+in al, dx
+in al, 2
+mov al, [0x1000]
+mov al, [qword 0x1000]
+mov al, [rbx]
+add eax, 1
+add rax, byte 1
+add ax, 1
+vaddps ymm0, ymm1, ymm2
+vaddps ymm3, ymm4, ymm5
+vaddps xmm0, xmm1, xmm2
+[bits 32]
+mov eax, [ebx+8]
+mov ecx, [edx+8]
+push eax
+push ecx
+[bits 64]
+push rax
+push rcx
+[default rel]
+mov al, [0x1000]
+mov rax, [rbx+8]
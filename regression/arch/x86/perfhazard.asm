@@ -0,0 +1,19 @@
+; [yasm -f bin -p nasm -Wperformance]
+[bits 64]
+vaddps ymm0, ymm1, ymm2
+vaddps xmm3, xmm1, xmm2
+addps xmm4, xmm5
+vmulps ymm0, ymm0, ymm0
+ret
+vmulps ymm0, ymm0, ymm0
+vzeroupper
+addps xmm4, xmm5
+cvtsi2sd xmm0, rax
+xorps xmm1, xmm1
+cvtsi2sd xmm1, rax
+sqrtss xmm2, xmm3
+sqrtss xmm2, xmm2
+popcnt eax, ecx
+xor edx, edx
+popcnt edx, ecx
+vcvtsi2sd xmm0, xmm0, rax
@@ -0,0 +1,9 @@
+; [yasm -f bin -M -I${srcdir} -DONE='"${srcdir}/deps-1.dat"' -DTWO='"${srcdir}/deps-2.dat"' -o ${outfile} ${srcdir}/deps.asm]
+; -M prints a make rule and writes no object file.  The source comes
+; first, then includes sorted by name, then incbin files in the order
+; first used.  incbin opens files relative to the current directory, so
+; their paths are passed in.
+%include "deps-z.inc"
+incbin TWO
+incbin ONE
+incbin TWO
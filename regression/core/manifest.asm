@@ -0,0 +1,6 @@
+; [yasm -f bin -I${srcdir} -DONE='"${srcdir}/deps-1.dat"' -DTWO='"${srcdir}/deps-2.dat"' --manifest=- -o ${outfile} ${srcdir}/manifest.asm]
+; The manifest lists the object and every input with the MD5 of its
+; contents, in the same order as -M.
+%include "deps-z.inc"
+incbin TWO
+incbin ONE
@@ -0,0 +1,24 @@
+; [yasm -f bin -p nasm --profile=${srcdir}/profilealign.prof]
+; func.loop is aligned to 32 bytes.  func.skip and func.done may only be
+; padded by up to 6 bytes to reach 16, which is enough for func.skip but
+; not for func.done.  other is too cold to align at all.
+[bits 64]
+section .text
+func:
+    xor eax, eax
+    mov ecx, 100
+.loop:
+    add eax, ecx
+    dec ecx
+    jnz .loop
+    test eax, eax
+    jz .skip
+    inc eax
+.skip:
+    test ecx, ecx
+    jnz .done
+    ret
+.done:
+    ret
+other:
+    ret
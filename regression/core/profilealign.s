@@ -0,0 +1,22 @@
+# [yasm -f bin -p gas --profile=${srcdir}/profilealign.prof]
+# Same profile and code as profilealign.asm, with GAS label names.
+.code64
+.text
+func:
+    xorl %eax, %eax
+    movl $100, %ecx
+func.loop:
+    addl %ecx, %eax
+    decl %ecx
+    jnz func.loop
+    testl %eax, %eax
+    jz func.skip
+    incl %eax
+func.skip:
+    testl %ecx, %ecx
+    jnz func.done
+    ret
+func.done:
+    ret
+other:
+    ret
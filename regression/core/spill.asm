@@ -0,0 +1,10 @@
+; [yasm -f bin --spill-threshold=16]
+; Spilled data is read back in place; the output must be unchanged.
+db "0123456789abcdef"
+db "short"
+db "0123456789abcdef0123456789abcdef"
+jmp short label
+times 4 db 0x90
+label:
+dd label
+db "0123456789abcdef"
@@ -0,0 +1,7 @@
+; [yasm -f bin --synthesize-cfi]
+; The bin format's null debug format has no call frame information.
+[bits 64]
+f:
+    push rbx    ; out: 53
+    pop rbx     ; out: 5b
+    ret         ; out: c3
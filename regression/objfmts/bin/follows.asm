@@ -0,0 +1,15 @@
+; [yasm -f bin -o ${outfile} -]
+; Sections placed by follows= and vfollows= chains, declared out of order.
+; Alignment gaps between them are padded with zeros in the output.
+[map sections symbols]
+[org 0x100]
+section .c follows=.b align=16
+c1:	db 3
+	dw b1
+section .b follows=.text align=8
+b1:	db 2,2
+section .text
+start:	jmp short entry
+entry:	ret
+section .v follows=.c vfollows=.b valign=64
+v1:	dw v1, c1
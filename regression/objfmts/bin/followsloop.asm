@@ -0,0 +1,10 @@
+; [fail]
+; A three-section follows= loop is reported once, at its last member.
+section .text
+	db 0
+section .a follows=.c
+	db 1
+section .b follows=.a
+	db 2
+section .c follows=.b
+	db 3
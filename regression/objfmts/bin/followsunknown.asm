@@ -0,0 +1,7 @@
+; [fail]
+section .text
+	db 0
+section .a follows=.text
+	db 1
+section .b follows=.nosuch
+	db 2
@@ -0,0 +1,11 @@
+; [fail]
+; Sections are checked for overlap in LMA order, not source order; the
+; pair reported is the first overlapping pair found.
+section .text start=0x100
+	times 16 db 0
+section .b start=0x80
+	times 8 db 1
+section .c start=0x108
+	times 4 db 2
+section .d start=0x84
+	times 2 db 3
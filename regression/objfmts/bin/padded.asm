@@ -0,0 +1,10 @@
+; [oformat bin]
+; Sections are written in LMA order whatever their source order.  A short
+; gap is padded with zeros in the stream; one longer than 4096 bytes is
+; skipped with a seek and must read back as zeros too.
+section .text start=0
+	db 1,1,1
+section .hi start=0x1018
+	db 3
+section .mid start=0x10
+	db 2,2,2,2
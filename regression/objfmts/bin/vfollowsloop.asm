@@ -0,0 +1,6 @@
+; [fail]
+; A section may not vfollow itself.
+section .text
+	db 0
+section .a vfollows=.a
+	db 1
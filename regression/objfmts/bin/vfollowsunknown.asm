@@ -0,0 +1,5 @@
+; [fail]
+section .text
+	db 0
+section .a vfollows=.nosuch
+	db 1
@@ -0,0 +1,11 @@
+; [yasm -f elf64 --file-prefix-map=${srcdir}=. --archive=${outfile} ${srcdir}/archive.asm ${srcdir}/archivelongmember.inc]
+; Two inputs written into one archive.  The index lists the global and
+; common symbols of each member; the second member's name is too long
+; for the member header and goes into the long name table.
+global first
+common counter 8
+extern second
+section .text
+first:
+    call second
+    ret
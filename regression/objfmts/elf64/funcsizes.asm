@@ -0,0 +1,23 @@
+; [yasm -f elf64 --function-sizes]
+section .text
+global a, b, c, d, e
+global obj:data
+a:
+alias_a equ a
+    nop
+    nop
+.local:
+    ret
+b:
+    ret
+inner:
+    nop
+c:
+d:  ret
+    align 16
+e:  nop
+obj: dd 1
+[size e 1]
+section .data
+global dat
+dat: dd 0
@@ -0,0 +1,22 @@
+; [yasm -f elf64 --keep-pcrel-relocs]
+; PC-relative references to hidden and internal symbols in the same
+; section are resolved without relocations.
+global hf:function hidden
+global inf:function internal
+global pf:function
+global wf:function hidden
+[weak wf]
+section .text
+hf:	ret
+inf:	ret
+pf:	ret
+wf:	ret
+	call hf
+	call inf wrt ..plt
+	jmp hf
+	lea rax, [rel hf+2]
+	call pf
+	call wf
+	mov rax, [rel hf wrt ..gotpcrel]
+section .data
+	dq hf
@@ -0,0 +1,11 @@
+; [yasm -f elf64 -g dwarf2 --spill-threshold=1 --file-prefix-map=${outdir}=.]
+; Debug sections are generated after parsing and patch their own headers,
+; so they must not be spilled.
+[section .text]
+global func
+func:
+	nop
+	ret
+[section .data]
+msg:	db "0123456789abcdef"
+	dq func
@@ -0,0 +1,26 @@
+; [yasm -f elf64 -g elfcfi --synthesize-cfi]
+bits 64
+section .text
+global f, g, h
+f:
+    push rbp
+    mov rbp, rsp
+    push rbx
+    sub rsp, 24
+    test rdi, rdi
+    jz .out
+    add rsp, 24
+    pop rbx
+    pop rbp
+    ret
+.out:
+    mov eax, 1
+    leave
+    ret
+g:
+    sub rsp, 8
+    call f
+    add rsp, 8
+    ret
+h:
+    ret
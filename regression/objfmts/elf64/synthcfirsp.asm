@@ -0,0 +1,19 @@
+; [yasm -f elf64 -g elfcfi --synthesize-cfi]
+; Popping the stack pointer loads it from the stack.
+bits 64
+section .text
+global swap, nofp
+swap:
+    push rbp
+    mov rbp, rsp
+    push rdi
+    pop rsp         ; the CFA is based on rbp, so tracking continues
+    push rbx
+    pop rbx
+    mov rsp, rbp
+    pop rbp
+    ret
+nofp:
+    push rdi
+    pop rsp         ; nothing to recover the CFA from
+    ret
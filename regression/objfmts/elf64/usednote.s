@@ -0,0 +1,7 @@
+# [ygas -64 -mx86-used-note=yes]
+.text
+f:
+	popcnt %rbx, %rax
+	vaddps %ymm2, %ymm1, %ymm0
+	fldl (%rax)
+	ret
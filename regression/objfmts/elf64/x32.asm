@@ -0,0 +1,14 @@
+; [yasm -f elfx32]
+[bits 64]
+extern ext
+global func
+section .text
+func:
+	mov eax, [rel ext]
+	call ext
+	mov rax, ext
+	lea rax, [rel local]
+	ret
+section .data
+local: dd ext
+	dq func
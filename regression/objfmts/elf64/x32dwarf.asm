@@ -0,0 +1,11 @@
+; [yasm -f elfx32 -g dwarf2 --file-prefix-map=${outdir}=.]
+; x32 DWARF uses 4-byte addresses, as gas does.
+[section .text]
+global func
+func:
+	push rbp
+	mov rbp, rsp
+	mov eax, [rbp+16]
+	add eax, 1
+	pop rbp
+	ret
@@ -0,0 +1,12 @@
+; [yasm -f win64 -g cv8 --file-prefix-map=${outdir}=.]
+; S_COMPILE2 records the assembler version, which is pinned to 1.0.0 under
+; the test suite.
+[section .text]
+global func
+func:
+	push rbp
+	mov rbp, rsp
+	mov eax, [rbp+16]
+	add eax, 1
+	pop rbp
+	ret
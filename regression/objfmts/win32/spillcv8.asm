@@ -0,0 +1,11 @@
+; [yasm -f win64 -g cv8 --spill-threshold=1 --file-prefix-map=${outdir}=.]
+; CodeView sections are generated after optimization and must not be
+; spilled, as they are never length-calculated again.
+[section .text]
+global func
+func:
+	nop
+	ret
+[section .data]
+msg:	db "0123456789abcdef"
+	dq func
@@ -0,0 +1,51 @@
+; Nested logical and comparison operators in preprocessor conditions
+%if (2 >= ((7 && 7) && 63))
+db 1	; out: 01
+%else
+db 0
+%endif
+%if -(((63 && 3) != (3 || 0)))
+db 1
+%else
+db 0	; out: 00
+%endif
+%if (((1 || 0) == (0 ^^ 1)) == ((7 && 3) <= 1))
+db 1	; out: 01
+%else
+db 0
+%endif
+%if ((0x7fffffff ^^ 7) < (-7 || 0))
+db 1	; out: 01
+%else
+db 0
+%endif
+%if (((-1 & 1) <= (-1 < 1)) == ((2 || 1) >= (100 && -1)))
+db 1	; out: 01
+%else
+db 0
+%endif
+%if ((1 || 1) && ((100 ^ 7) > (0x7fffffff && -1)))
+db 1	; out: 01
+%else
+db 0
+%endif
+%if (1 - ((1 ^ 255) && 0x7fffffff))
+db 1
+%else
+db 0	; out: 00
+%endif
+%if !((-7 + (7 && 0x7fffffff)))
+db 1
+%else
+db 0	; out: 00
+%endif
+%if (-1 == -((7 * 7)))
+db 1
+%else
+db 0	; out: 00
+%endif
+%if -(-((-7 * 7)))
+db 1	; out: 01
+%else
+db 0
+%endif
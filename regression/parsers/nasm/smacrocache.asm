@@ -0,0 +1,52 @@
+; Parameterless single-line macro expansions are cached; every
+; re-expansion must still see the current definitions.  Names left
+; unexpanded get values at the end.
+
+; A chain, re-expanded after the inner macro changes and goes away:
+; 1+1*2, 5+1*2, C+1*2, 7+1*2.
+%define C 1
+%define B C+1
+%define A B*2
+dd A	; out: 00000003
+%define C 5
+dd A	; out: 00000007
+%undef C
+dd A	; out: 00000102
+%define C 7
+dd A	; out: 00000009
+
+; Self reference, and two macros that block each other.
+%define X X+1
+dd X	; out: 00000201
+dd X	; out: 00000201
+%define P Q
+%define Q P
+dd P	; out: 00000300
+dd Q	; out: 00000400
+dd P	; out: 00000300
+
+; Context-local macros resolve in the current context.
+%define W %$v
+%push one
+%define %$v 1
+dd W	; out: 00000001
+%push two
+%define %$v 2
+dd W	; out: 00000002
+%pop
+dd W	; out: 00000001
+%pop
+
+; __LINE__ is never cached.
+%define L __LINE__
+dd L	; out: 0000002a
+dd L	; out: 0000002b
+
+%undef C
+%undef X
+%undef P
+%undef Q
+C equ 0x100
+X equ 0x200
+P equ 0x300
+Q equ 0x400
@@ -64,6 +64,7 @@ class Test(object):
         self.basefn = os.path.splitext("_".join(path_splitall(self.name)))[0]
         self.outfn = self.basefn + ".out"
         self.ewfn = self.basefn + ".ew"
+        self.stdoutfn = self.basefn + ".stdout"
 
         # Read the input file in its entirety.  We use this for various things.
         f = open(self.fullpath)
@@ -112,6 +113,51 @@ class Test(object):
 
         return match
 
+    def normalize_stdout(self, data):
+        """Show paths under the test directory as "${srcdir}", and join
+        make rule continuation lines, as where those wrap depends on the
+        length of that path."""
+        return data.replace(self.srcdir, "${srcdir}").replace(" \\\n ", " ")
+
+    def compare_stdout(self, stdoutdata):
+        """Check standard output (reports written by the assembler)."""
+        # Only checked if there's a .stdout file.
+        try:
+            f = open(os.path.splitext(self.fullpath)[0] + ".stdout")
+            try:
+                golden = self.normalize_stdout(f.read()).splitlines()
+                golden = [l.rstrip() for l in golden]
+            finally:
+                f.close()
+        except IOError:
+            return True
+
+        result = [l.rstrip()
+                  for l in self.normalize_stdout(stdoutdata).splitlines()]
+
+        match = True
+        if len(golden) != len(result):
+            lprint("%s: standard output line count %d (expected %d)"
+                    % (self.stdoutfn, len(result), len(golden)))
+            match = False
+        for i, (o, g) in enumerate(zip(result, golden)):
+            if o != g:
+                lprint("%s:%d: mismatch on standard output"
+                        % (self.stdoutfn, i+1))
+                lprint(" Expected: %s" % g)
+                lprint(" Actual: %s" % o)
+                match = False
+                break
+
+        if not match:
+            f = open(os.path.join(outdir, self.stdoutfn), "w")
+            try:
+                f.write(stdoutdata)
+            finally:
+                f.close()
+
+        return match
+
     def compare_out(self):
         """Check output file."""
         # If there's a .hex file, use it; otherwise scan the input file
@@ -139,12 +185,16 @@ class Test(object):
 
         goldenfn = self.basefn + ".gold"
 
-        # check result file
-        f = open(os.path.join(outdir, self.outfn), "rb")
+        # check result file; a test that writes no output file (such as
+        # one that only generates dependencies) expects no output
         try:
-            result = f.read()
-        finally:
-            f.close()
+            f = open(os.path.join(outdir, self.outfn), "rb")
+            try:
+                result = f.read()
+            finally:
+                f.close()
+        except IOError:
+            result = ""
         match = True
         if len(golden) != len(result):
             lprint("%s: output length %d (expected %d)"
@@ -222,6 +272,12 @@ class Test(object):
             yasmargs = shlex.split("ygas "+ygasoverride)
             self.parser = "gas"
 
+        # Files next to the test (profiles, extra inputs) are named
+        # relative to "${srcdir}"; the output directory is "${outdir}".
+        self.srcdir = srcdir = os.path.dirname(self.fullpath)
+        yasmargs = [a.replace("${srcdir}", srcdir).replace("${outdir}", outdir)
+                    for a in yasmargs]
+
         # Set comment separator based on parser
         self.commentsep = (self.parser == "gas") and "#" or ";"
 
@@ -230,20 +286,34 @@ class Test(object):
                (self.name, yasmargs[0] == "ygas" and "ygas " or "",
                 " ".join(yasmargs[1:]), expectfail and "{fail}" or ""))
 
-        # Specify the output filename as we pipe the input.
-        yasmargs.extend(["-o", os.path.join(outdir, self.outfn)])
+        # A command line override that names the output with "${outfile}"
+        # also names every input itself (use "-" for this file).  The name
+        # is relative to "${outdir}", so output that records it (such as a
+        # bin map file) is the same everywhere.
+        outpath = os.path.join(outdir, self.outfn)
+        if [a for a in yasmargs if "${outfile}" in a]:
+            yasmargs = [a.replace("${outfile}", self.outfn) for a in yasmargs]
+        else:
+            # Specify the output filename as we pipe the input.
+            yasmargs.extend(["-o", outpath])
 
-        # We pipe the input, so append "-" to the command line for stdin input.
-        yasmargs.append("-")
+            # We pipe the input, so append "-" to the command line for stdin
+            # input.
+            yasmargs.append("-")
 
-        # Run yasm!
+        # Remove any output left by a previous run.
+        if os.path.exists(outpath):
+            os.remove(outpath)
+
+        # Run yasm!  It runs in "${outdir}", so that is the current
+        # directory recorded in debug information.
         start = time.time()
         env = os.environ.copy()
         env["YASM_TEST_SUITE"] = "1"
         proc = subprocess.Popen(yasmargs, bufsize=4096,
                                 executable=(ygasoverride and ygasexe or yasmexe),
                                 stdin=subprocess.PIPE, stdout=subprocess.PIPE,
-                                stderr=subprocess.PIPE, env=env)
+                                stderr=subprocess.PIPE, env=env, cwd=outdir)
         (stdoutdata, stderrdata) = proc.communicate(self.inputfile)
         end = time.time()
 
@@ -273,6 +343,10 @@ class Test(object):
                 if not match:
                     ok = False
 
+                match = self.compare_stdout(stdoutdata)
+                if not match:
+                    ok = False
+
         # Summarize test result
         if ok:
             result = "      OK"
@@ -326,10 +400,10 @@ if __name__ == "__main__":
         lprint("    <path to yasm executable>", file=sys.stderr)
         lprint("    <path to ygas executable>", file=sys.stderr)
         sys.exit(2)
-    outdir = sys.argv[2]
-    yasmexe = sys.argv[3]
-    ygasexe = sys.argv[4]
-    all_ok = run_all(sys.argv[1])
+    outdir = os.path.abspath(sys.argv[2])
+    yasmexe = os.path.abspath(sys.argv[3])
+    ygasexe = os.path.abspath(sys.argv[4])
+    all_ok = run_all(os.path.abspath(sys.argv[1]))
     if all_ok:
         sys.exit(0)
     else:
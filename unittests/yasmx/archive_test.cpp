@@ -0,0 +1,101 @@
+// Static archive writer unit test
+//
+//  Copyright (C) 2011  PathScale Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+
+#include "llvm/Support/raw_ostream.h"
+#include "yasmx/ArchiveWriter.h"
+#include "yasmx/Location.h"
+#include "yasmx/Object.h"
+#include "yasmx/Section.h"
+#include "yasmx/Symbol.h"
+
+using namespace yasm;
+
+// Build the expected 60-byte member header.
+static std::string
+Header(const char* name, const char* mode, const char* size)
+{
+    std::string hdr(60, ' ');
+    hdr.replace(0, std::strlen(name), name);
+    hdr[16] = '0';                          // date
+    hdr[28] = '0';                          // uid
+    hdr[34] = '0';                          // gid
+    hdr.replace(40, std::strlen(mode), mode);
+    hdr.replace(48, std::strlen(size), size);
+    hdr.replace(58, 2, "`\n");
+    return hdr;
+}
+
+TEST(ArchiveWriterTest, Empty)
+{
+    ArchiveWriter archive;
+    std::string out;
+    llvm::raw_string_ostream os(out);
+    archive.Write(os);
+    EXPECT_EQ("!<arch>\n", os.str());
+}
+
+TEST(ArchiveWriterTest, SymbolIndex)
+{
+    Object object("x", "y", 0);
+    Section* x = new Section("x", true, false, SourceLocation());
+    object.AppendSection(std::auto_ptr<Section>(x));
+    Location loc = {&x->FreshBytecode(), 0};
+
+    SymbolRef global = object.getSymbol("g");
+    global->Declare(Symbol::GLOBAL);
+    global->DefineLabel(loc);
+    object.getSymbol("local")->DefineLabel(loc);
+    object.getSymbol("ext")->Declare(Symbol::EXTERN);
+    object.getSymbol("undef")->Declare(Symbol::GLOBAL);
+
+    Object empty("z", "w", 0);
+
+    ArchiveWriter archive;
+    archive.AddMember("dir/a.o", "abc", object);
+    archive.AddMember("longer_than_15.o", "", empty);
+    EXPECT_EQ(2U, archive.getNumMembers());
+
+    std::string out;
+    llvm::raw_string_ostream os(out);
+    archive.Write(os);
+
+    // Index: one symbol, pointing to the first member after the index
+    // (8 + 60 + 10) and long name table (60 + 18).
+    std::string expect("!<arch>\n");
+    expect += Header("/", "0", "10");
+    expect += std::string("\0\0\0\1\0\0\0\x9c", 8);
+    expect += std::string("g\0", 2);
+    expect += Header("//", "0", "18");
+    expect += "longer_than_15.o/\n";
+    expect += Header("a.o/", "644", "3");
+    expect += "abc\n";
+    expect += Header("/0", "644", "0");
+    EXPECT_EQ(expect, os.str());
+}
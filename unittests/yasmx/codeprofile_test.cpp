@@ -0,0 +1,96 @@
+// Execution profile unit test
+//
+//  Copyright (C) 2011  PathScale Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include "yasmx/CodeProfile.h"
+
+TEST(CodeProfileTest, Parse)
+{
+    yasm::CodeProfile profile;
+    unsigned long line = 0;
+    EXPECT_TRUE(profile.empty());
+    EXPECT_TRUE(profile.Parse("# comment\n"
+                              "\n"
+                              "hot 1000\n"
+                              "  warm\t100  # trailing comment\r\n"
+                              "hot 600\n", &line));
+    EXPECT_FALSE(profile.empty());
+
+    EXPECT_FALSE(profile.Parse("ok 1\nmissing\n", &line));
+    EXPECT_EQ(2UL, line);
+    // Nothing from a malformed profile is kept, even earlier entries.
+    EXPECT_TRUE(profile.empty());
+    unsigned long boundary, maxskip;
+    EXPECT_FALSE(profile.getAlignment("ok", &boundary, &maxskip));
+    EXPECT_FALSE(profile.getAlignment("hot", &boundary, &maxskip));
+    EXPECT_FALSE(profile.Parse("bad 12x\n", &line));
+    EXPECT_EQ(1UL, line);
+    EXPECT_FALSE(profile.Parse("extra 1 2\n", &line));
+    EXPECT_EQ(1UL, line);
+}
+
+TEST(CodeProfileTest, Alignment)
+{
+    yasm::CodeProfile profile;
+    unsigned long line;
+    ASSERT_TRUE(profile.Parse("hot 1000\nwarm 100\nlukewarm 20\ncold 10\n",
+                              &line));
+
+    unsigned long boundary = 0, maxskip = 0;
+    EXPECT_TRUE(profile.getAlignment("hot", &boundary, &maxskip));
+    EXPECT_EQ(32UL, boundary);
+    EXPECT_EQ(31UL, maxskip);
+
+    EXPECT_TRUE(profile.getAlignment("warm", &boundary, &maxskip));
+    EXPECT_EQ(16UL, boundary);
+    EXPECT_EQ(6UL, maxskip);
+
+    EXPECT_TRUE(profile.getAlignment("lukewarm", &boundary, &maxskip));
+    EXPECT_EQ(16UL, boundary);
+    EXPECT_EQ(1UL, maxskip);
+
+    EXPECT_FALSE(profile.getAlignment("cold", &boundary, &maxskip));
+    EXPECT_FALSE(profile.getAlignment("unknown", &boundary, &maxskip));
+}
+
+TEST(CodeProfileTest, LargeCounts)
+{
+    // Counts beyond 32 bits must not be truncated.
+    yasm::CodeProfile profile;
+    unsigned long line;
+    ASSERT_TRUE(profile.Parse("hot 40000000000\n"
+                              "warm 8000000000\n"
+                              "cold 4294967296\n", &line));
+
+    unsigned long boundary = 0, maxskip = 0;
+    EXPECT_TRUE(profile.getAlignment("hot", &boundary, &maxskip));
+    EXPECT_EQ(32UL, boundary);
+    EXPECT_TRUE(profile.getAlignment("warm", &boundary, &maxskip));
+    EXPECT_EQ(16UL, boundary);
+    EXPECT_TRUE(profile.getAlignment("cold", &boundary, &maxskip));
+    EXPECT_EQ(16UL, boundary);
+    EXPECT_EQ(6UL, maxskip);
+}
@@ -140,3 +140,49 @@ TEST_F(LocationTest, SimplifyCalcDist)
     SimplifyCalcDist(e, diags);
     EXPECT_EQ("1950", String::Format(e));
 }
+
+static void
+IgnoreSubst(unsigned int subst, Location loc, Location loc2)
+{
+}
+
+TEST_F(LocationTest, Linearize)
+{
+    yasmunit::MockDiagnosticClient mock_client;
+    Diagnostic diags(&mock_client);
+    SourceManager smgr(diags);
+    diags.setSourceManager(&smgr);
+
+    Expr e;
+    long constant;
+    std::vector<long> coefs;
+
+    // 10 + 2*(loc3-loc1) - (loc2-loc1)
+    e = SUB(ADD(10, MUL(SUB(loc3, loc1), 2)), SUB(loc2, loc1));
+    ASSERT_EQ(2, SubstDist(e, diags, &IgnoreSubst));
+    ASSERT_TRUE(Linearize(e, 2, &constant, &coefs));
+    EXPECT_EQ(10, constant);
+    ASSERT_EQ(2U, coefs.size());
+
+    // The linear form must agree with the general evaluator.
+    ExprTerm subst[2] = {ExprTerm(7), ExprTerm(-3)};
+    ExprTerm result;
+    ASSERT_TRUE(Evaluate(e, diags, &result, subst, 2, false, false));
+    EXPECT_EQ(result.getIntNum()->getInt(),
+              constant + coefs[0]*7 + coefs[1]*-3);
+
+    // Product of two distances is not linear.
+    e = MUL(SUB(loc2, loc1), SUB(loc3, loc2));
+    ASSERT_EQ(2, SubstDist(e, diags, &IgnoreSubst));
+    EXPECT_FALSE(Linearize(e, 2, &constant, &coefs));
+
+    // Neither is division.
+    e = DIV(SUB(loc3, loc1), 2);
+    ASSERT_EQ(1, SubstDist(e, diags, &IgnoreSubst));
+    EXPECT_FALSE(Linearize(e, 1, &constant, &coefs));
+
+    // Constants too large for the linear form are left to the evaluator.
+    e = ADD(SUB(loc3, loc1), IntNum(0x100000000LL));
+    ASSERT_EQ(1, SubstDist(e, diags, &IgnoreSubst));
+    EXPECT_FALSE(Linearize(e, 1, &constant, &coefs));
+}
@@ -0,0 +1,116 @@
+// Object path remapping and timestamp unit test
+//
+//  Copyright (C) 2011  PathScale Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <string>
+
+#include "yasmx/Object.h"
+
+using namespace yasm;
+
+TEST(ObjectTest, RemapPath)
+{
+    Object object("x", "y", 0);
+    EXPECT_EQ("/build/src/a.asm", object.RemapPath("/build/src/a.asm"));
+
+    object.AddPathMap("/build", "/usr/src/pkg");
+    object.AddPathMap("/build/src", ".");
+    EXPECT_EQ("./a.asm", object.RemapPath("/build/src/a.asm"));
+    EXPECT_EQ("/usr/src/pkg/inc/b.inc",
+              object.RemapPath("/build/inc/b.inc"));
+    EXPECT_EQ("/other/a.asm", object.RemapPath("/other/a.asm"));
+    EXPECT_EQ("a.asm", object.RemapPath("a.asm"));
+}
+
+// Set an environment variable, or remove it if value is NULL.
+static void
+SetEnv(const char* name, const char* value)
+{
+#ifdef _WIN32
+    _putenv_s(name, value ? value : "");
+#else
+    if (value)
+        setenv(name, value, 1);
+    else
+        unsetenv(name);
+#endif
+}
+
+// Restores an environment variable on scope exit.
+class SavedEnv
+{
+public:
+    explicit SavedEnv(const char* name) : m_name(name), m_set(false)
+    {
+        if (const char* value = std::getenv(name))
+        {
+            m_value = value;
+            m_set = true;
+        }
+    }
+    ~SavedEnv() { SetEnv(m_name, m_set ? m_value.c_str() : 0); }
+
+private:
+    const char* m_name;
+    std::string m_value;
+    bool m_set;
+};
+
+TEST(ObjectTest, Timestamp)
+{
+    SavedEnv saved_epoch("SOURCE_DATE_EPOCH");
+    SavedEnv saved_suite("YASM_TEST_SUITE");
+    SetEnv("SOURCE_DATE_EPOCH", 0);
+    SetEnv("YASM_TEST_SUITE", 0);
+
+    Object object("x", "y", 0);
+    EXPECT_FALSE(object.hasFixedTimestamp());
+    EXPECT_NE(0UL, object.getTimestamp());
+
+    object.getConfig().Deterministic = true;
+    EXPECT_TRUE(object.hasFixedTimestamp());
+    EXPECT_EQ(0UL, object.getTimestamp());
+
+    // SOURCE_DATE_EPOCH takes precedence over deterministic mode.
+    SetEnv("SOURCE_DATE_EPOCH", "1234567890");
+    EXPECT_TRUE(object.hasFixedTimestamp());
+    EXPECT_EQ(1234567890UL, object.getTimestamp());
+
+    object.getConfig().Deterministic = false;
+    EXPECT_TRUE(object.hasFixedTimestamp());
+    EXPECT_EQ(1234567890UL, object.getTimestamp());
+
+    SetEnv("SOURCE_DATE_EPOCH", "0");
+    EXPECT_TRUE(object.hasFixedTimestamp());
+    EXPECT_EQ(0UL, object.getTimestamp());
+
+    // A malformed value is ignored (the frontend rejects it up front).
+    SetEnv("SOURCE_DATE_EPOCH", "12x");
+    EXPECT_FALSE(object.hasFixedTimestamp());
+    object.getConfig().Deterministic = true;
+    EXPECT_EQ(0UL, object.getTimestamp());
+}